@@ -0,0 +1,1053 @@
+/*-------------------------------------------------------------------------
+ *
+ * odbc_connection.c
+ *		  Connection management functions for odbc_fdw
+ *
+ * Connections are kept open for the life of the backend, so that short
+ * statements don't pay for a SQLDriverConnect every time.  They are looked
+ * up by the ODBC connection string odbcConnStr builds, so that any options
+ * affecting the connection end up in the key.
+ *
+ * While a local transaction uses a connection, the connection runs in
+ * manual-commit mode, and its remote transaction is committed or rolled
+ * back together with the local one.  Local subtransactions are mapped to
+ * remote savepoints where the data source supports them.
+ *
+ * Portions Copyright (c) 2012-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2017-2018, www.cstech.ltd
+ *
+ * IDENTIFICATION
+ *		  contrib/odbc_fdw/odbc_connection.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "odbc_fdw.h"
+
+#include "access/htup_details.h"
+#include "access/xact.h"
+#include "catalog/pg_foreign_server.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+#include "utils/tuplestore.h"
+
+/*
+ * Connection strings longer than this are not cached; the connection is
+ * made and dropped per statement as before.
+ */
+#define ODBC_CONNSTR_MAXLEN 1024
+
+/*
+ * Connection cache hash table entry
+ *
+ * A driver that can't run more than one statement per connection at a time
+ * (SQL_MAX_CONCURRENT_ACTIVITIES) would fail if, say, two scans of the same
+ * server were interleaved in one query.  So several connections may be kept
+ * for the same connection string, told apart by "slot"; a lookup hands out
+ * the first one with room for another statement.
+ */
+typedef struct ConnCacheKey
+{
+	char		connstr[ODBC_CONNSTR_MAXLEN];	/* ODBC connection string */
+	int			slot;			/* index among connections for connstr */
+} ConnCacheKey;
+
+typedef struct ConnCacheEntry
+{
+	ConnCacheKey key;			/* hash key (must be first) */
+	SQLHDBC		conn;			/* connection handle, or NULL */
+	List	   *leases;			/* nest level of each unreleased
+								 * odbc_GetConnection; their number is the
+								 * number of statements using conn */
+	List	   *stmts;			/* OpenStatements of odbc_AllocStatement */
+	SQLUSMALLINT max_active;	/* driver's limit on active statements, or
+								 * 0 if there is none */
+	bool		invalidated;	/* true if reconnect is pending */
+	bool		txn_capable;	/* does the data source support transactions? */
+	bool		autocommit_off; /* has autocommit been turned off? */
+	bool		no_savepoints;	/* did a SAVEPOINT command fail? */
+	int			xact_depth;		/* 0 = no xact open, 1 = main xact open, 2 =
+								 * one level of subxact open, etc */
+	bool		rollback_pending;	/* remote xact can only be rolled back */
+	Oid			serverid;		/* foreign server OID used to get conn */
+	uint32		server_hashvalue;	/* hash value of foreign server OID */
+	uint32		mapping_hashvalue;	/* hash value of user mapping OID */
+} ConnCacheEntry;
+
+/*
+ * A statement handle from odbc_AllocStatement, with the transaction nest
+ * level that opened it, so that an aborted subtransaction can close its own.
+ */
+typedef struct OpenStatement
+{
+	SQLHSTMT	stmt;
+	int			level;
+} OpenStatement;
+
+/*
+ * Connection cache (initialized on first use)
+ */
+static HTAB *ConnectionHash = NULL;
+
+/* ODBC environment shared by all connections */
+static SQLHENV odbc_env = NULL;
+
+/* prototypes of private functions */
+static SQLHDBC connect_odbc_server(const char *conn_str);
+static void disconnect_odbc_server(ConnCacheEntry *entry);
+static ConnCacheEntry *find_connection(SQLHDBC conn);
+static void close_open_statements(ConnCacheEntry *entry, int level);
+static void drop_leases(ConnCacheEntry *entry, int level);
+static void move_to_parent_level(ConnCacheEntry *entry, int level);
+static void begin_remote_xact(ConnCacheEntry *entry);
+static bool do_sql_command(SQLHDBC conn, const char *sql, bool throw_error);
+static bool end_remote_xact(ConnCacheEntry *entry, SQLSMALLINT completion,
+				bool throw_error);
+static void odbcfdw_xact_callback(XactEvent event, void *arg);
+static void odbcfdw_subxact_callback(SubXactEvent event,
+						 SubTransactionId mySubid,
+						 SubTransactionId parentSubid,
+						 void *arg);
+static void odbcfdw_inval_callback(Datum arg, int cacheid, uint32 hashvalue);
+static bool disconnect_cached_connections(Oid serverid);
+
+PG_FUNCTION_INFO_V1(odbc_fdw_get_connections);
+PG_FUNCTION_INFO_V1(odbc_fdw_disconnect);
+PG_FUNCTION_INFO_V1(odbc_fdw_disconnect_all);
+
+/*
+ * Get a connection which can be used to execute statements on the remote
+ * server with the given connection string.  serverid and umid identify the
+ * catalog entries conn_str was built from, for invalidation.
+ *
+ * Every successful call must be paired with odbc_ReleaseConnection once the
+ * caller has freed its statement handles.
+ */
+SQLHDBC
+odbc_GetConnection(const char *conn_str, Oid serverid, Oid umid)
+{
+	ConnCacheKey key;
+	ConnCacheEntry *entry;
+	MemoryContext oldcontext;
+	bool		found;
+
+	/* First time through, initialize connection cache hashtable */
+	if (ConnectionHash == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(ConnCacheKey);
+		ctl.entrysize = sizeof(ConnCacheEntry);
+		/* allocate ConnectionHash in the cache context */
+		ctl.hcxt = CacheMemoryContext;
+		ConnectionHash = hash_create("odbc_fdw connections", 8,
+									 &ctl,
+									 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+		/*
+		 * Register some callback functions that manage connection cleanup.
+		 * This should be done just once in each backend.
+		 */
+		RegisterXactCallback(odbcfdw_xact_callback, NULL);
+		RegisterSubXactCallback(odbcfdw_subxact_callback, NULL);
+		CacheRegisterSyscacheCallback(FOREIGNSERVEROID,
+									  odbcfdw_inval_callback, (Datum) 0);
+		CacheRegisterSyscacheCallback(USERMAPPINGOID,
+									  odbcfdw_inval_callback, (Datum) 0);
+	}
+
+	/*
+	 * Too long to be a key: don't cache it.  Such a connection stays in
+	 * autocommit mode, as we'd have nowhere to track its transaction.
+	 */
+	if (strlen(conn_str) >= ODBC_CONNSTR_MAXLEN)
+		return connect_odbc_server(conn_str);
+
+	/* Create hash key for the entry.  Assume no pad bytes in key struct */
+	MemSet(&key, 0, sizeof(key));
+	strcpy(key.connstr, conn_str);
+
+	for (key.slot = 0;; key.slot++)
+	{
+		entry = hash_search(ConnectionHash, &key, HASH_ENTER, &found);
+		if (!found)
+		{
+			/*
+			 * We need only clear "conn" here; remaining fields will be filled
+			 * later when "conn" is set.
+			 */
+			entry->conn = NULL;
+		}
+
+		/*
+		 * If the connection needs to be remade due to invalidation, disconnect
+		 * as soon as we're out of all transactions and nobody is using it.
+		 */
+		if (entry->conn != NULL && entry->invalidated &&
+			entry->xact_depth == 0 && entry->leases == NIL)
+		{
+			elog(DEBUG3, "closing odbc_fdw connection %p for option changes to take effect",
+				 entry->conn);
+			disconnect_odbc_server(entry);
+		}
+
+		if (entry->conn == NULL)
+		{
+			SQLUSMALLINT max_active;
+			SQLUSMALLINT txn_capable;
+			SQLRETURN	ret;
+
+			entry->leases = NIL;
+			entry->stmts = NIL;
+			entry->invalidated = false;
+			entry->serverid = serverid;
+			entry->server_hashvalue =
+				GetSysCacheHashValue1(FOREIGNSERVEROID,
+									  ObjectIdGetDatum(serverid));
+			entry->mapping_hashvalue =
+				GetSysCacheHashValue1(USERMAPPINGOID,
+									  ObjectIdGetDatum(umid));
+
+			entry->conn = connect_odbc_server(conn_str);
+
+			ret = SQLGetInfo(entry->conn, SQL_MAX_CONCURRENT_ACTIVITIES,
+							 &max_active, sizeof(max_active), NULL);
+			entry->max_active = SQL_SUCCEEDED(ret) ? max_active : 1;
+
+			ret = SQLGetInfo(entry->conn, SQL_TXN_CAPABLE,
+							 &txn_capable, sizeof(txn_capable), NULL);
+			entry->txn_capable = SQL_SUCCEEDED(ret) && txn_capable != SQL_TC_NONE;
+			entry->autocommit_off = false;
+			entry->no_savepoints = false;
+			entry->xact_depth = 0;
+			entry->rollback_pending = false;
+
+			elog(DEBUG3, "new odbc_fdw connection %p for server %u (slot %d)",
+				 entry->conn, serverid, key.slot);
+		}
+		else if ((entry->invalidated && entry->xact_depth == 0) ||
+				 (entry->max_active != 0 &&
+				  list_length(entry->leases) >= entry->max_active))
+		{
+			/*
+			 * Busy, or stale but still in use: try the next slot.  A stale
+			 * connection with an open remote transaction is kept in use until
+			 * the transaction ends, so the transaction sees its own changes.
+			 */
+			continue;
+		}
+
+		/* Start a new transaction or subtransaction if needed */
+		begin_remote_xact(entry);
+
+		oldcontext = MemoryContextSwitchTo(CacheMemoryContext);
+		entry->leases = lappend_int(entry->leases,
+									GetCurrentTransactionNestLevel());
+		MemoryContextSwitchTo(oldcontext);
+		return entry->conn;
+	}
+}
+
+/*
+ * Release connection reference count created by calling odbc_GetConnection.
+ * References are released in the reverse order they were taken.
+ */
+void
+odbc_ReleaseConnection(SQLHDBC conn)
+{
+	ConnCacheEntry *entry = find_connection(conn);
+
+	if (entry != NULL)
+	{
+		if (entry->leases != NIL)
+			entry->leases = list_truncate(entry->leases,
+										  list_length(entry->leases) - 1);
+		if (entry->invalidated && entry->leases == NIL &&
+			entry->xact_depth == 0)
+			disconnect_odbc_server(entry);
+		return;
+	}
+
+	/* Not cached, see odbc_GetConnection */
+	SQLDisconnect(conn);
+	SQLFreeHandle(SQL_HANDLE_DBC, conn);
+}
+
+/*
+ * Allocate a statement handle on a connection from odbc_GetConnection.
+ *
+ * Use this for statements that stay open across calls, like those of a
+ * scan, and free them with odbc_FreeStatement.  The connection keeps track
+ * of them, so that the ones an aborted transaction leaves open can be
+ * closed before its remote transaction is rolled back.
+ */
+SQLHSTMT
+odbc_AllocStatement(SQLHDBC conn)
+{
+	ConnCacheEntry *entry = find_connection(conn);
+	SQLHSTMT	stmt = SQL_NULL_HSTMT;
+	SQLRETURN	ret;
+
+	ret = SQLAllocHandle(SQL_HANDLE_STMT, conn, &stmt);
+	check_return(ret, "Allocating statement handle", conn, SQL_HANDLE_DBC);
+
+	if (entry != NULL)
+	{
+		OpenStatement *open;
+
+		open = (OpenStatement *) MemoryContextAlloc(CacheMemoryContext,
+													sizeof(OpenStatement));
+		open->stmt = stmt;
+		open->level = GetCurrentTransactionNestLevel();
+		entry->stmts = lappend(entry->stmts, open);
+	}
+
+	return stmt;
+}
+
+/*
+ * Free a statement handle allocated by odbc_AllocStatement.
+ */
+void
+odbc_FreeStatement(SQLHDBC conn, SQLHSTMT stmt)
+{
+	ConnCacheEntry *entry = find_connection(conn);
+
+	if (entry != NULL)
+	{
+		ListCell   *lc;
+
+		foreach(lc, entry->stmts)
+		{
+			OpenStatement *open = (OpenStatement *) lfirst(lc);
+
+			if (open->stmt == stmt)
+			{
+				entry->stmts = list_delete_ptr(entry->stmts, open);
+				pfree(open);
+				break;
+			}
+		}
+	}
+	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+}
+
+/*
+ * Find the cache entry of a connection handle, or NULL if it isn't cached.
+ */
+static ConnCacheEntry *
+find_connection(SQLHDBC conn)
+{
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+
+	if (ConnectionHash == NULL)
+		return NULL;
+
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+	{
+		if (entry->conn == conn)
+		{
+			hash_seq_term(&scan);
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Close and free the statements of a connection that are still open and
+ * were opened at the given transaction nest level or deeper, as after an
+ * error, so that nothing keeps its remote (sub)transaction from being
+ * ended.  Level 0 closes them all.
+ */
+static void
+close_open_statements(ConnCacheEntry *entry, int level)
+{
+	List	   *kept = NIL;
+	ListCell   *lc;
+
+	foreach(lc, entry->stmts)
+	{
+		OpenStatement *open = (OpenStatement *) lfirst(lc);
+
+		if (open->level < level)
+		{
+			kept = lappend(kept, open);
+			continue;
+		}
+		SQLCancel(open->stmt);
+		SQLFreeHandle(SQL_HANDLE_STMT, open->stmt);
+		pfree(open);
+	}
+	list_free(entry->stmts);
+	entry->stmts = kept;
+}
+
+/*
+ * Forget the references to a connection taken at the given transaction
+ * nest level or deeper, whose users were aborted without releasing them.
+ */
+static void
+drop_leases(ConnCacheEntry *entry, int level)
+{
+	List	   *kept = NIL;
+	ListCell   *lc;
+
+	foreach(lc, entry->leases)
+	{
+		if (lfirst_int(lc) < level)
+			kept = lappend_int(kept, lfirst_int(lc));
+	}
+	list_free(entry->leases);
+	entry->leases = kept;
+}
+
+/*
+ * Hand the statements and references of a committed subtransaction at the
+ * given level over to its parent, as a cursor may outlive it.
+ */
+static void
+move_to_parent_level(ConnCacheEntry *entry, int level)
+{
+	ListCell   *lc;
+
+	foreach(lc, entry->stmts)
+	{
+		OpenStatement *open = (OpenStatement *) lfirst(lc);
+
+		if (open->level >= level)
+			open->level = level - 1;
+	}
+	foreach(lc, entry->leases)
+	{
+		if (lfirst_int(lc) >= level)
+			lfirst_int(lc) = level - 1;
+	}
+}
+
+/*
+ * Allocate a connection handle and connect it with the given connection
+ * string.
+ */
+static SQLHDBC
+connect_odbc_server(const char *conn_str)
+{
+	SQLHDBC		dbc = SQL_NULL_HDBC;
+	SQLCHAR		OutConnStr[1024];
+	SQLSMALLINT OutConnStrLen;
+	SQLRETURN	ret;
+
+	if (odbc_env == NULL)
+	{
+		/* Allocate an environment handle */
+		SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &odbc_env);
+		/* We want ODBC 3 support */
+		SQLSetEnvAttr(odbc_env, SQL_ATTR_ODBC_VERSION, (void *) SQL_OV_ODBC3, 0);
+	}
+
+	/* Allocate a connection handle */
+	ret = SQLAllocHandle(SQL_HANDLE_DBC, odbc_env, &dbc);
+	check_return(ret, "Allocating connection handle", odbc_env, SQL_HANDLE_ENV);
+
+	/* Connect to the DSN */
+	ret = SQLDriverConnect(dbc, NULL, (SQLCHAR *) conn_str, SQL_NTS,
+						   OutConnStr, 1024, &OutConnStrLen, SQL_DRIVER_COMPLETE);
+	if (!SQL_SUCCEEDED(ret))
+	{
+		/* Report the driver's diagnostics before dropping the handle */
+		PG_TRY();
+		{
+			check_return(ret, "Connecting to driver", dbc, SQL_HANDLE_DBC);
+		}
+		PG_CATCH();
+		{
+			SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+	}
+
+	return dbc;
+}
+
+/*
+ * Disconnect the connection of a cache entry, and free its handle.  The
+ * entry itself is kept, with conn set to NULL.
+ *
+ * This must not throw, as it's used in abort cleanup.  A failure to
+ * disconnect, typically because the remote transaction could not be ended,
+ * is only reported; the handle is freed and forgotten all the same.
+ */
+static void
+disconnect_odbc_server(ConnCacheEntry *entry)
+{
+	if (entry->conn != NULL)
+	{
+		SQLHDBC		conn = entry->conn;
+		SQLRETURN	ret;
+
+		close_open_statements(entry, 0);
+		entry->conn = NULL;
+		ret = SQLDisconnect(conn);
+		if (!SQL_SUCCEEDED(ret))
+			ereport(WARNING,
+					(errmsg("could not disconnect odbc_fdw connection %p", conn)));
+		SQLFreeHandle(SQL_HANDLE_DBC, conn);
+	}
+}
+
+/*
+ * Start remote transaction or subtransaction, if needed.
+ *
+ * ODBC has no BEGIN: turning autocommit off makes the driver start a
+ * transaction implicitly with the next statement, and keep one open after
+ * each SQLEndTran.  So autocommit is turned off once per connection, and
+ * xact_depth only records whether the current local transaction has used
+ * the connection yet.
+ */
+static void
+begin_remote_xact(ConnCacheEntry *entry)
+{
+	int			curlevel = GetCurrentTransactionNestLevel();
+
+	if (!entry->txn_capable)
+		return;
+
+	/* Start main transaction if we haven't yet */
+	if (entry->xact_depth <= 0)
+	{
+		if (!entry->autocommit_off)
+		{
+			SQLRETURN	ret;
+
+			elog(DEBUG3, "starting remote transaction on connection %p",
+				 entry->conn);
+			ret = SQLSetConnectAttr(entry->conn, SQL_ATTR_AUTOCOMMIT,
+									(SQLPOINTER) SQL_AUTOCOMMIT_OFF,
+									SQL_IS_UINTEGER);
+			check_return(ret, "Turning off autocommit", entry->conn,
+						 SQL_HANDLE_DBC);
+			entry->autocommit_off = true;
+		}
+		entry->xact_depth = 1;
+		entry->rollback_pending = false;
+	}
+
+	/*
+	 * If we're in a subtransaction, stack up savepoints to match our level.
+	 * This ensures we can rollback just the desired effects when a
+	 * subtransaction aborts.
+	 */
+	while (entry->xact_depth < curlevel)
+	{
+		char		sql[64];
+
+		if (!entry->no_savepoints)
+		{
+			snprintf(sql, sizeof(sql), "SAVEPOINT s%d", entry->xact_depth + 1);
+			if (!do_sql_command(entry->conn, sql, false))
+			{
+				ereport(DEBUG1,
+						(errmsg("data source does not support savepoints; subtransactions will not be rolled back remotely")));
+				entry->no_savepoints = true;
+			}
+		}
+		entry->xact_depth++;
+	}
+}
+
+/*
+ * Execute a statement that returns no rows on the given connection.
+ *
+ * If throw_error is false, failures are only reported at DEBUG level, and
+ * false is returned; this is for use in abort cleanup, which must not throw.
+ */
+static bool
+do_sql_command(SQLHDBC conn, const char *sql, bool throw_error)
+{
+	SQLHSTMT	stmt = SQL_NULL_HSTMT;
+	SQLRETURN	ret;
+
+	ret = SQLAllocHandle(SQL_HANDLE_STMT, conn, &stmt);
+	if (SQL_SUCCEEDED(ret))
+		ret = SQLExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS);
+
+	if (!SQL_SUCCEEDED(ret))
+	{
+		elog(DEBUG1, "odbc_fdw could not execute \"%s\"", sql);
+		if (throw_error)
+		{
+			PG_TRY();
+			{
+				if (stmt != SQL_NULL_HSTMT)
+					check_return(ret, (char *) sql, stmt, SQL_HANDLE_STMT);
+				else
+					check_return(ret, (char *) sql, conn, SQL_HANDLE_DBC);
+			}
+			PG_CATCH();
+			{
+				if (stmt != SQL_NULL_HSTMT)
+					SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+				PG_RE_THROW();
+			}
+			PG_END_TRY();
+		}
+	}
+
+	if (stmt != SQL_NULL_HSTMT)
+		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+
+	return SQL_SUCCEEDED(ret);
+}
+
+/*
+ * Commit or roll back the remote transaction of a connection.
+ */
+static bool
+end_remote_xact(ConnCacheEntry *entry, SQLSMALLINT completion,
+				bool throw_error)
+{
+	SQLRETURN	ret;
+
+	elog(DEBUG3, "%s remote transaction on connection %p",
+		 completion == SQL_COMMIT ? "committing" : "rolling back",
+		 entry->conn);
+
+	ret = SQLEndTran(SQL_HANDLE_DBC, entry->conn, completion);
+	if (throw_error)
+		check_return(ret,
+					 completion == SQL_COMMIT ? "Committing remote transaction" :
+					 "Rolling back remote transaction",
+					 entry->conn, SQL_HANDLE_DBC);
+
+	return SQL_SUCCEEDED(ret);
+}
+
+/*
+ * odbcfdw_xact_callback --- cleanup at main-transaction end.
+ *
+ * The remote transactions are committed in the pre-commit phase, so that
+ * a remote failure can still abort the local transaction, and rolled back
+ * on abort.
+ *
+ * Statements never outlive the transaction that runs them, so no connection
+ * is in use once it ends.  After an abort, though, the End* callbacks have
+ * not run and the statements that were open are still allocated.  Those
+ * are closed and the remote transaction is rolled back in any case, as
+ * a connection can't be dropped while a transaction is open on it; then,
+ * since we can't tell what state the statements left behind, the
+ * connection is dropped.  Statements of an aborted subtransaction were
+ * already closed by odbcfdw_subxact_callback.
+ */
+static void
+odbcfdw_xact_callback(XactEvent event, void *arg)
+{
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+	{
+		/* Ignore cache entry if no open connection right now */
+		if (entry->conn == NULL)
+			continue;
+
+		switch (event)
+		{
+			case XACT_EVENT_PARALLEL_PRE_COMMIT:
+			case XACT_EVENT_PRE_COMMIT:
+				if (entry->xact_depth <= 0)
+					break;
+
+				/*
+				 * A subtransaction that used the connection was rolled back
+				 * locally but not remotely; committing would keep its effects.
+				 */
+				if (entry->rollback_pending)
+				{
+					end_remote_xact(entry, SQL_ROLLBACK, false);
+					entry->xact_depth = 0;
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("cannot commit remote transaction after rolling back a subtransaction that used it"),
+							 errdetail("The data source does not support savepoints.")));
+				}
+
+				/*
+				 * Commit all remote transactions during pre-commit.  If that
+				 * fails, xact_depth stays set and the abort rolls back.
+				 */
+				end_remote_xact(entry, SQL_COMMIT, true);
+				entry->xact_depth = 0;
+				break;
+			case XACT_EVENT_PRE_PREPARE:
+
+				/*
+				 * We disallow remote transactions that modified anything,
+				 * since it's not very reasonable to hold them open until the
+				 * prepared transaction is committed.  We can't tell whether
+				 * they did, so any remote transaction is refused.
+				 */
+				if (entry->xact_depth > 0)
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("cannot prepare a transaction that has operated on odbc_fdw foreign tables")));
+				break;
+			case XACT_EVENT_PARALLEL_COMMIT:
+			case XACT_EVENT_COMMIT:
+			case XACT_EVENT_PREPARE:
+				/* Pre-commit should have closed the open transaction */
+				if (entry->xact_depth > 0)
+					elog(ERROR, "missed cleaning up connection during pre-commit");
+				break;
+			case XACT_EVENT_PARALLEL_ABORT:
+			case XACT_EVENT_ABORT:
+				/*
+				 * Close what the aborted statements left open, then roll
+				 * back the remote transaction; don't throw.
+				 */
+				close_open_statements(entry, 0);
+				if (entry->xact_depth > 0 &&
+					!end_remote_xact(entry, SQL_ROLLBACK, false))
+					entry->invalidated = true;
+				entry->xact_depth = 0;
+				break;
+		}
+
+		if (event != XACT_EVENT_COMMIT && event != XACT_EVENT_PARALLEL_COMMIT &&
+			event != XACT_EVENT_ABORT && event != XACT_EVENT_PARALLEL_ABORT)
+			continue;
+
+		/*
+		 * Connections with statements left open by an aborted transaction
+		 * are dropped, and so are those whose remote transaction could not
+		 * be rolled back.
+		 */
+		if (entry->invalidated || entry->leases != NIL)
+		{
+			elog(DEBUG3, "discarding odbc_fdw connection %p", entry->conn);
+			disconnect_odbc_server(entry);
+		}
+		list_free(entry->leases);
+		entry->leases = NIL;
+	}
+}
+
+/*
+ * odbcfdw_subxact_callback --- cleanup at subtransaction end.
+ */
+static void
+odbcfdw_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+						 SubTransactionId parentSubid, void *arg)
+{
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+	int			curlevel;
+
+	/* Nothing to do at subxact start, nor after commit. */
+	if (!(event == SUBXACT_EVENT_PRE_COMMIT_SUB ||
+		  event == SUBXACT_EVENT_ABORT_SUB))
+		return;
+
+	/*
+	 * Our subxact callback is registered together with the cache, so
+	 * ConnectionHash exists.
+	 */
+	curlevel = GetCurrentTransactionNestLevel();
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+	{
+		char		sql[100];
+
+		if (entry->conn == NULL)
+			continue;
+
+		/*
+		 * Statements of an aborted subtransaction are never released by
+		 * their scans, so close them and drop their references now;
+		 * otherwise the connection would look busy and the next lookup
+		 * would get another slot outside this remote transaction.  Those of
+		 * a committed one now belong to the parent.
+		 */
+		if (event == SUBXACT_EVENT_ABORT_SUB)
+		{
+			close_open_statements(entry, curlevel);
+			drop_leases(entry, curlevel);
+		}
+		else
+			move_to_parent_level(entry, curlevel);
+
+		/*
+		 * Otherwise we only care about connections with open remote
+		 * subtransactions of the current level.
+		 */
+		if (entry->xact_depth < curlevel)
+			continue;
+
+		if (entry->xact_depth > curlevel)
+			elog(ERROR, "missed cleaning up remote subtransaction at level %d",
+				 entry->xact_depth);
+
+		if (event == SUBXACT_EVENT_PRE_COMMIT_SUB)
+		{
+			/*
+			 * Commit all remote subtransactions during pre-commit.  Not all
+			 * data sources know RELEASE SAVEPOINT, and leaving the savepoint
+			 * in place is harmless, so a failure is ignored.
+			 */
+			if (!entry->no_savepoints)
+			{
+				snprintf(sql, sizeof(sql), "RELEASE SAVEPOINT s%d", curlevel);
+				do_sql_command(entry->conn, sql, false);
+			}
+		}
+		else
+		{
+			bool		rolled_back = false;
+
+			/*
+			 * Rollback all remote subtransactions during abort.  If we can't,
+			 * because the data source has no savepoints or the command fails,
+			 * the only way left to undo the subtransaction's work is to roll
+			 * back the whole remote transaction.
+			 */
+			if (!entry->no_savepoints)
+			{
+				snprintf(sql, sizeof(sql), "ROLLBACK TO SAVEPOINT s%d", curlevel);
+				rolled_back = do_sql_command(entry->conn, sql, false);
+			}
+			if (!rolled_back)
+				entry->rollback_pending = true;
+		}
+
+		/* OK, we're outta that level of subtransaction */
+		entry->xact_depth--;
+	}
+}
+
+/*
+ * Connection invalidation callback function
+ *
+ * After a change to a pg_foreign_server or pg_user_mapping catalog entry,
+ * mark connections depending on that entry as needing to be remade.
+ * We can't immediately destroy them, since they might be in the midst of
+ * a statement, but we'll remake them at the next opportunity.
+ *
+ * Although most cache invalidation callbacks blow away all the related stuff
+ * regardless of the given hashvalue, connections are expensive enough that
+ * it's worth trying to avoid that.
+ *
+ * NB: We could avoid unnecessary disconnection more strictly by examining
+ * individual option values, but it seems too much effort for the gain.
+ */
+static void
+odbcfdw_inval_callback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+
+	Assert(cacheid == FOREIGNSERVEROID || cacheid == USERMAPPINGOID);
+
+	/* ConnectionHash must exist already, if we're registered */
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+	{
+		/* Ignore invalid entries */
+		if (entry->conn == NULL)
+			continue;
+
+		/* hashvalue == 0 means a cache reset, must clear all state */
+		if (hashvalue == 0 ||
+			(cacheid == FOREIGNSERVEROID &&
+			 entry->server_hashvalue == hashvalue) ||
+			(cacheid == USERMAPPINGOID &&
+			 entry->mapping_hashvalue == hashvalue))
+			entry->invalidated = true;
+	}
+}
+
+/*
+ * Workhorse to disconnect cached connections.
+ *
+ * Disconnects every idle connection made for the given server, or all idle
+ * connections if serverid is InvalidOid.  Connections used by the current
+ * transaction are left alone with a warning.  Returns true if any connection
+ * was closed.
+ */
+static bool
+disconnect_cached_connections(Oid serverid)
+{
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+	bool		result = false;
+
+	if (!ConnectionHash)
+		return false;
+
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+	{
+		if (entry->conn == NULL)
+			continue;
+
+		if (OidIsValid(serverid) && entry->serverid != serverid)
+			continue;
+
+		if (entry->leases != NIL || entry->xact_depth > 0)
+		{
+			HeapTuple	tup;
+
+			tup = SearchSysCache1(FOREIGNSERVEROID,
+								  ObjectIdGetDatum(entry->serverid));
+			if (HeapTupleIsValid(tup))
+			{
+				Form_pg_foreign_server server;
+
+				server = (Form_pg_foreign_server) GETSTRUCT(tup);
+				ereport(WARNING,
+						(errmsg("cannot close connection for server \"%s\" because it is still in use",
+								NameStr(server->srvname))));
+				ReleaseSysCache(tup);
+			}
+			continue;
+		}
+
+		elog(DEBUG3, "discarding odbc_fdw connection %p", entry->conn);
+		disconnect_odbc_server(entry);
+		result = true;
+	}
+
+	return result;
+}
+
+/*
+ * List the foreign servers with open cached connections.
+ *
+ * Returns one row per connection: the server name (NULL if the server has
+ * since been dropped) and whether the connection is still valid.  Connection
+ * strings are not shown, as they may carry passwords.
+ */
+Datum
+odbc_fdw_get_connections(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	/* Build tuplestore to hold the result rows */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* If cache doesn't exist, we return no records */
+	if (!ConnectionHash)
+	{
+		tuplestore_donestoring(tupstore);
+		PG_RETURN_VOID();
+	}
+
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+	{
+		Datum		values[2];
+		bool		nulls[2];
+		HeapTuple	tup;
+
+		/* We only look for open remote connections */
+		if (entry->conn == NULL)
+			continue;
+
+		MemSet(values, 0, sizeof(values));
+		MemSet(nulls, 0, sizeof(nulls));
+
+		tup = SearchSysCache1(FOREIGNSERVEROID,
+							  ObjectIdGetDatum(entry->serverid));
+		if (HeapTupleIsValid(tup))
+		{
+			Form_pg_foreign_server server;
+
+			server = (Form_pg_foreign_server) GETSTRUCT(tup);
+			values[0] = CStringGetTextDatum(NameStr(server->srvname));
+			ReleaseSysCache(tup);
+		}
+		else
+		{
+			/*
+			 * The server was dropped while its connection was in use; the
+			 * connection is already marked invalidated and will be closed
+			 * at the end of the transaction.
+			 */
+			nulls[0] = true;
+		}
+
+		values[1] = BoolGetDatum(!entry->invalidated);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Disconnect the cached connections to the given foreign server.
+ *
+ * Returns true if any connection was closed, false otherwise.  Connections
+ * in use by the current transaction are kept, with a warning.
+ */
+Datum
+odbc_fdw_disconnect(PG_FUNCTION_ARGS)
+{
+	ForeignServer *server;
+	char	   *servername;
+
+	servername = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	server = GetForeignServerByName(servername, false);
+
+	PG_RETURN_BOOL(disconnect_cached_connections(server->serverid));
+}
+
+/*
+ * Disconnect all the cached connections.
+ *
+ * Returns true if any connection was closed, false otherwise.
+ */
+Datum
+odbc_fdw_disconnect_all(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(disconnect_cached_connections(InvalidOid));
+}
@@ -53,10 +53,15 @@
 #include "optimizer/tlist.h"
 #include "optimizer/var.h"
 #include "parser/parsetree.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datetime.h"
 #include "utils/lsyscache.h"
+#include "utils/numeric.h"
 #include "utils/rel.h"
 #include "utils/syscache.h"
+#include "utils/timestamp.h"
 #include "utils/typcache.h"
 
 
@@ -103,6 +108,7 @@ typedef struct deparse_expr_cxt
 								 * a base relation. */
 	StringInfo	buf;			/* output buffer to append to */
 	List	  **params_list;	/* exprs that will become remote Params */
+	const OdbcDialect *dialect; /* SQL dialect of the remote server */
 } deparse_expr_cxt;
 
 #define REL_ALIAS_PREFIX	"r"
@@ -120,6 +126,12 @@ static bool foreign_expr_walker(Node *node,
 					foreign_glob_cxt *glob_cxt,
 					foreign_loc_cxt *outer_cxt);
 static char *deparse_type_name(Oid type_oid, int32 typemod);
+static bool is_portable_const(Const *node);
+static bool is_portable_operator(OpExpr *node, const OdbcDialect *dialect);
+static bool is_number_type(Oid type_oid, bool *is_integer);
+static bool is_predicate(Expr *node);
+static bool has_predicate_arg(List *args);
+static List *get_in_list(ScalarArrayOpExpr *node);
 
 /*
  * Functions to construct string representation of a node tree.
@@ -128,6 +140,7 @@ static void deparseTargetList(StringInfo buf,
 				  PlannerInfo *root,
 				  Index rtindex,
 				  Relation rel,
+				  const OdbcDialect *dialect,
 				  bool is_returning,
 				  Bitmapset *attrs_used,
 				  bool qualify_col,
@@ -137,18 +150,26 @@ static void deparseExplicitTargetList(List *tlist, List **retrieved_attrs,
 static void deparseSubqueryTargetList(deparse_expr_cxt *context);
 static void deparseReturningList(StringInfo buf, PlannerInfo *root,
 					 Index rtindex, Relation rel,
+					 const OdbcDialect *dialect,
 					 bool trig_after_row,
 					 List *returningList,
 					 List **retrieved_attrs);
 static void deparseColumnRef(StringInfo buf, int varno, int varattno,
-				 PlannerInfo *root, bool qualify_col);
-static void deparseRelation(StringInfo buf, Relation rel);
+				 PlannerInfo *root, bool qualify_col,
+				 const OdbcDialect *dialect);
+static void deparseRelation(StringInfo buf, Relation rel,
+				const OdbcDialect *dialect);
 static void deparseExpr(Expr *expr, deparse_expr_cxt *context);
+static void deparsePredicate(Expr *expr, deparse_expr_cxt *context);
+static void deparseValue(Expr *expr, deparse_expr_cxt *context);
 static void deparseVar(Var *node, deparse_expr_cxt *context);
 static void deparseConst(Const *node, deparse_expr_cxt *context, int showtype);
+static void deparseDatetimeConst(Const *node, deparse_expr_cxt *context);
 static void deparseParam(Param *node, deparse_expr_cxt *context);
 static void deparseArrayRef(ArrayRef *node, deparse_expr_cxt *context);
 static void deparseFuncExpr(FuncExpr *node, deparse_expr_cxt *context);
+static bool deparseRemoteTemplate(Oid objectId, Oid classId, List *args,
+					  deparse_expr_cxt *context);
 static void deparseOpExpr(OpExpr *node, deparse_expr_cxt *context);
 static void deparseOperatorName(StringInfo buf, Form_pg_operator opform);
 static void deparseDistinctExpr(DistinctExpr *node, deparse_expr_cxt *context);
@@ -158,14 +179,14 @@ static void deparseRelabelType(RelabelType *node, deparse_expr_cxt *context);
 static void deparseBoolExpr(BoolExpr *node, deparse_expr_cxt *context);
 static void deparseNullTest(NullTest *node, deparse_expr_cxt *context);
 static void deparseArrayExpr(ArrayExpr *node, deparse_expr_cxt *context);
-static void printRemoteParam(int paramindex, Oid paramtype, int32 paramtypmod,
-				 deparse_expr_cxt *context);
+static void printRemoteParam(Node *node, deparse_expr_cxt *context);
 static void printRemotePlaceholder(Oid paramtype, int32 paramtypmod,
 					   deparse_expr_cxt *context);
-static void deparseSelectSql(List *tlist, bool is_subquery, List **retrieved_attrs,
-				 deparse_expr_cxt *context);
+static void deparseSelectSql(List *tlist, bool has_limit, bool is_subquery,
+				 List **retrieved_attrs, deparse_expr_cxt *context);
 static void deparseLockingClause(deparse_expr_cxt *context);
 static void appendOrderByClause(List *pathkeys, deparse_expr_cxt *context);
+static void appendLimitClause(deparse_expr_cxt *context);
 static void appendConditions(List *exprs, deparse_expr_cxt *context);
 static void deparseFromExprForRel(StringInfo buf, PlannerInfo *root,
 					  RelOptInfo *joinrel, bool use_alias, List **params_list);
@@ -174,7 +195,10 @@ static void deparseRangeTblRef(StringInfo buf, PlannerInfo *root,
 				   RelOptInfo *foreignrel, bool make_subquery,
 				   List **params_list);
 static void deparseAggref(Aggref *node, deparse_expr_cxt *context);
+static void deparseGroupingFunc(GroupingFunc *node, deparse_expr_cxt *context);
 static void appendGroupByClause(List *tlist, deparse_expr_cxt *context);
+static void deparseGroupingSet(GroupingSet *gset, List *tlist,
+				   deparse_expr_cxt *context);
 static void appendAggOrderBy(List *orderList, List *targetList,
 				 deparse_expr_cxt *context);
 static void appendFunctionName(Oid funcid, deparse_expr_cxt *context);
@@ -242,9 +266,17 @@ odbc_is_foreign_expr(PlannerInfo *root,
 	 * For an upper relation, use relids from its underneath scan relation,
 	 * because the upperrel's own relids currently aren't set to anything
 	 * meaningful by the core code.  For other relation, use their own relids.
+	 * A DISTINCT relation may sit on top of a grouping relation, whose scan
+	 * relation is the one to use then.
 	 */
 	if (IS_UPPER_REL(baserel))
-		glob_cxt.relids = fpinfo->outerrel->relids;
+	{
+		RelOptInfo *scanrel = fpinfo->outerrel;
+
+		if (IS_UPPER_REL(scanrel))
+			scanrel = ((PgFdwRelationInfo *) scanrel->fdw_private)->outerrel;
+		glob_cxt.relids = scanrel->relids;
+	}
 	else
 		glob_cxt.relids = baserel->relids;
 	loc_cxt.collation = InvalidOid;
@@ -369,6 +401,10 @@ foreign_expr_walker(Node *node,
 			{
 				Const	   *c = (Const *) node;
 
+				/* Other servers only get values they can read back alike. */
+				if (!fpinfo->dialect.postgres_syntax && !is_portable_const(c))
+					return false;
+
 				/*
 				 * If the constant has nondefault collation, either it's of a
 				 * non-builtin type, or it reflects folding of a CollateExpr.
@@ -406,6 +442,10 @@ foreign_expr_walker(Node *node,
 				if (ar->refassgnexpr != NULL)
 					return false;
 
+				/* Arrays are a PostgreSQL matter. */
+				if (!fpinfo->dialect.postgres_syntax)
+					return false;
+
 				/*
 				 * Recurse to remaining subexpressions.  Since the array
 				 * subscripts must yield (noncollatable) integers, they won't
@@ -444,9 +484,35 @@ foreign_expr_walker(Node *node,
 				/*
 				 * If function used by the expression is not shippable, it
 				 * can't be sent to remote because it might have incompatible
-				 * semantics on remote side.
+				 * semantics on remote side.  Implicit casts are not sent at
+				 * all, only their argument is.
+				 */
+				if (fe->funcformat != COERCE_IMPLICIT_CAST &&
+					!odbc_is_shippable(fe->funcid, ProcedureRelationId, fpinfo, ProcedureObj))
+					return false;
+
+				/*
+				 * Other servers are sent built-in functions as the ODBC
+				 * function standing for them, which may not take every
+				 * argument.
+				 */
+				if (!fpinfo->dialect.postgres_syntax &&
+					fe->funcformat != COERCE_IMPLICIT_CAST &&
+					odbc_is_builtin(fe->funcid) &&
+					odbc_remote_template(fe->funcid, ProcedureRelationId,
+										 fe->args, fpinfo) == NULL)
+					return false;
+
+				/* VARIADIC calls are PostgreSQL syntax. */
+				if (!fpinfo->dialect.postgres_syntax && fe->funcvariadic)
+					return false;
+
+				/*
+				 * A server without a boolean type has no functions taking or
+				 * returning one.
 				 */
-				if (!odbc_is_shippable(fe->funcid, ProcedureRelationId, fpinfo, ProcedureObj))
+				if (!fpinfo->dialect.has_boolean &&
+					(fe->funcresulttype == BOOLOID || has_predicate_arg(fe->args)))
 					return false;
 
 				/*
@@ -497,6 +563,28 @@ foreign_expr_walker(Node *node,
 				if (!odbc_is_shippable(oe->opno, OperatorRelationId, fpinfo, OperatorObj))
 					return false;
 
+				/*
+				 * Other servers only share the comparison, LIKE and
+				 * arithmetic operators, and take others as the ODBC function
+				 * standing for them.  IS DISTINCT FROM is not standard
+				 * everywhere.
+				 */
+				if (!fpinfo->dialect.postgres_syntax)
+				{
+					if (!is_portable_operator(oe, &fpinfo->dialect) &&
+						odbc_remote_template(oe->opno, OperatorRelationId,
+											 oe->args, fpinfo) == NULL)
+						return false;
+					if (IsA(node, DistinctExpr) &&
+						!fpinfo->dialect.distinct_from &&
+						fpinfo->dialect.kind != ODBC_DIALECT_MYSQL)
+						return false;
+				}
+
+				/* Without a boolean type, conditions can't be operands. */
+				if (!fpinfo->dialect.has_boolean && has_predicate_arg(oe->args))
+					return false;
+
 				/*
 				 * Recurse to input subexpressions.
 				 */
@@ -530,6 +618,7 @@ foreign_expr_walker(Node *node,
 		case T_ScalarArrayOpExpr:
 			{
 				ScalarArrayOpExpr *oe = (ScalarArrayOpExpr *) node;
+				List	   *in_list;
 
 				/*
 				 * Again, only shippable operators can be sent to remote.
@@ -537,12 +626,38 @@ foreign_expr_walker(Node *node,
 				if (!odbc_is_shippable(oe->opno, OperatorRelationId, fpinfo, OperatorObj))
 					return false;
 
+				if (!fpinfo->dialect.has_boolean &&
+					is_predicate((Expr *) linitial(oe->args)))
+					return false;
+
 				/*
-				 * Recurse to input subexpressions.
+				 * A constant array compared by = ANY or <> ALL is sent as an
+				 * IN or NOT IN list, which every server takes, so its
+				 * elements are checked rather than the array.  Other arrays
+				 * are only understood by PostgreSQL.
 				 */
-				if (!foreign_expr_walker((Node *) oe->args,
-										 glob_cxt, &inner_cxt))
-					return false;
+				in_list = get_in_list(oe);
+				if (in_list != NIL)
+				{
+					if (!foreign_expr_walker((Node *) linitial(oe->args),
+											 glob_cxt, &inner_cxt))
+						return false;
+					if (!foreign_expr_walker((Node *) in_list,
+											 glob_cxt, &inner_cxt))
+						return false;
+				}
+				else
+				{
+					if (!fpinfo->dialect.postgres_syntax)
+						return false;
+
+					/*
+					 * Recurse to input subexpressions.
+					 */
+					if (!foreign_expr_walker((Node *) oe->args,
+											 glob_cxt, &inner_cxt))
+						return false;
+				}
 
 				/*
 				 * If operator's input collation is not derived from a foreign
@@ -606,6 +721,10 @@ foreign_expr_walker(Node *node,
 			{
 				NullTest   *nt = (NullTest *) node;
 
+				if (!fpinfo->dialect.has_boolean &&
+					is_predicate(nt->arg))
+					return false;
+
 				/*
 				 * Recurse to input subexpressions.
 				 */
@@ -622,6 +741,9 @@ foreign_expr_walker(Node *node,
 			{
 				ArrayExpr  *a = (ArrayExpr *) node;
 
+				if (!fpinfo->dialect.postgres_syntax)
+					return false;
+
 				/*
 				 * Recurse to input subexpressions.
 				 */
@@ -688,6 +810,25 @@ foreign_expr_walker(Node *node,
 				if (!odbc_is_shippable(agg->aggfnoid, ProcedureRelationId, fpinfo, AggObj))
 					return false;
 
+				/*
+				 * Ordered, filtered and variadic aggregates are written in
+				 * PostgreSQL syntax.
+				 */
+				if (!fpinfo->dialect.postgres_syntax &&
+					(agg->aggorder != NIL || agg->aggfilter != NULL ||
+					 agg->aggvariadic || AGGKIND_IS_ORDERED_SET(agg->aggkind)))
+					return false;
+
+				/* Nor do all drivers take DISTINCT in aggregates. */
+				if (!fpinfo->dialect.postgres_syntax &&
+					agg->aggdistinct != NIL &&
+					!(fpinfo->dialect.aggregate_functions & SQL_AF_DISTINCT))
+					return false;
+
+				if (!fpinfo->dialect.has_boolean &&
+					(agg->aggtype == BOOLOID || has_predicate_arg(agg->args)))
+					return false;
+
 				/*
 				 * Recurse to input args. aggdirectargs, aggorder and
 				 * aggdistinct are all present in args, so no need to check
@@ -771,6 +912,30 @@ foreign_expr_walker(Node *node,
 					state = FDW_COLLATE_UNSAFE;
 			}
 			break;
+		case T_GroupingFunc:
+			{
+				GroupingFunc *gfunc = (GroupingFunc *) node;
+
+				/*
+				 * Not safe to pushdown when not in grouping context, or when
+				 * it refers to an outer query level.  Grouping sets are only
+				 * pushed down if the server supports them, so there is no
+				 * further check needed here.
+				 */
+				if (!IS_UPPER_REL(glob_cxt->foreignrel) ||
+					gfunc->agglevelsup != 0)
+					return false;
+
+				/* The arguments are grouping expressions; check them too */
+				if (!foreign_expr_walker((Node *) gfunc->args,
+										 glob_cxt, &inner_cxt))
+					return false;
+
+				/* GROUPING() yields an integer, which is noncollatable */
+				collation = InvalidOid;
+				state = FDW_COLLATE_NONE;
+			}
+			break;
 		default:
 
 			/*
@@ -856,6 +1021,231 @@ deparse_type_name(Oid type_oid, int32 typemod)
 		return format_type_with_typemod_qualified(type_oid, typemod);
 }
 
+/*
+ * Is the constant written the same way, and read back as the same value, by
+ * servers other than PostgreSQL?  NaN, infinities and BC dates have no
+ * portable spelling, and binary strings and arrays none at all.
+ */
+static bool
+is_portable_const(Const *node)
+{
+	if (node->constisnull)
+		return true;
+
+	switch (node->consttype)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case OIDOID:
+		case BOOLOID:
+		case CHAROID:
+		case TEXTOID:
+		case BPCHAROID:
+		case VARCHAROID:
+		case TIMEOID:
+		case UUIDOID:
+			return true;
+		case FLOAT4OID:
+			{
+				float4		val = DatumGetFloat4(node->constvalue);
+
+				return !isnan(val) && !isinf(val);
+			}
+		case FLOAT8OID:
+			{
+				float8		val = DatumGetFloat8(node->constvalue);
+
+				return !isnan(val) && !isinf(val);
+			}
+		case NUMERICOID:
+			return !numeric_is_nan(DatumGetNumeric(node->constvalue));
+		case DATEOID:
+			{
+				DateADT		date = DatumGetDateADT(node->constvalue);
+				int			year,
+							month,
+							day;
+
+				if (DATE_NOT_FINITE(date))
+					return false;
+				j2date(date + POSTGRES_EPOCH_JDATE, &year, &month, &day);
+				return year > 0;
+			}
+		case TIMESTAMPOID:
+			{
+				Timestamp	ts = DatumGetTimestamp(node->constvalue);
+				struct pg_tm tm;
+				fsec_t		fsec;
+
+				if (TIMESTAMP_NOT_FINITE(ts) ||
+					timestamp2tm(ts, NULL, &tm, &fsec, NULL, NULL) != 0)
+					return false;
+				return tm.tm_year > 0;
+			}
+		default:
+			return false;
+	}
+}
+
+/*
+ * Is the operator one that servers other than PostgreSQL have too?  Those
+ * are the comparisons, LIKE and NOT LIKE, and the arithmetic of numbers.
+ * Division of integers truncates in PostgreSQL, so it is only sent to
+ * servers that do the same.
+ */
+static bool
+is_portable_operator(OpExpr *node, const OdbcDialect *dialect)
+{
+	static const char *const portable_operators[] =
+	{"=", "<>", "<", ">", "<=", ">=", "~~", "!~~", NULL};
+	HeapTuple	tuple;
+	Form_pg_operator form;
+	const char *name;
+	bool		result = false;
+	bool		is_integer;
+	int			i;
+
+	tuple = SearchSysCache1(OPEROID, ObjectIdGetDatum(node->opno));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for operator %u", node->opno);
+	form = (Form_pg_operator) GETSTRUCT(tuple);
+	name = NameStr(form->oprname);
+
+	if (form->oprnamespace == PG_CATALOG_NAMESPACE)
+	{
+		for (i = 0; portable_operators[i] != NULL; i++)
+		{
+			if (strcmp(name, portable_operators[i]) == 0)
+				result = true;
+		}
+
+		if (strlen(name) == 1 && strchr("+-*/", name[0]) != NULL &&
+			is_number_type(form->oprright, &is_integer) &&
+			(form->oprleft == InvalidOid ||
+			 is_number_type(form->oprleft, &is_integer)) &&
+			is_number_type(form->oprresult, &is_integer))
+			result = (name[0] != '/' || !is_integer ||
+					  dialect->integer_division);
+	}
+
+	ReleaseSysCache(tuple);
+
+	return result;
+}
+
+/*
+ * Is the type a number type, and if so, an integer one?
+ */
+static bool
+is_number_type(Oid type_oid, bool *is_integer)
+{
+	switch (type_oid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+			*is_integer = true;
+			return true;
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case NUMERICOID:
+			*is_integer = false;
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Is the expression a condition rather than a value?  Servers without a
+ * boolean type take conditions only where PostgreSQL takes a boolean value,
+ * and values everywhere else.
+ */
+static bool
+is_predicate(Expr *node)
+{
+	switch (nodeTag(node))
+	{
+		case T_OpExpr:
+			return ((OpExpr *) node)->opresulttype == BOOLOID;
+		case T_DistinctExpr:
+		case T_ScalarArrayOpExpr:
+		case T_BoolExpr:
+		case T_NullTest:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Is any of the arguments, or of the aggregate arguments, a condition?
+ */
+static bool
+has_predicate_arg(List *args)
+{
+	ListCell   *lc;
+
+	foreach(lc, args)
+	{
+		Expr	   *arg = (Expr *) lfirst(lc);
+
+		if (IsA(arg, TargetEntry))
+			arg = ((TargetEntry *) arg)->expr;
+		if (is_predicate(arg))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * If the ScalarArrayOpExpr compares with a constant array by = ANY or by
+ * <> ALL, which means IN or NOT IN the list of its elements, return the
+ * elements as a list of Consts.  Otherwise, return NIL.
+ */
+static List *
+get_in_list(ScalarArrayOpExpr *node)
+{
+	Const	   *arrayconst = (Const *) lsecond(node->args);
+	ArrayType  *array;
+	Oid			elemtype;
+	int16		elmlen;
+	bool		elmbyval;
+	char		elmalign;
+	Datum	   *elems;
+	bool	   *nulls;
+	int			nelems;
+	char	   *opname;
+	List	   *result = NIL;
+	int			i;
+
+	if (!IsA(arrayconst, Const) || arrayconst->constisnull)
+		return NIL;
+
+	opname = get_opname(node->opno);
+	if (opname == NULL || strcmp(opname, node->useOr ? "=" : "<>") != 0)
+		return NIL;
+
+	array = DatumGetArrayTypeP(arrayconst->constvalue);
+	if (ARR_NDIM(array) != 1)
+		return NIL;
+
+	elemtype = ARR_ELEMTYPE(array);
+	get_typlenbyvalalign(elemtype, &elmlen, &elmbyval, &elmalign);
+	deconstruct_array(array, elemtype, elmlen, elmbyval, elmalign,
+					  &elems, &nulls, &nelems);
+
+	for (i = 0; i < nelems; i++)
+		result = lappend(result, makeConst(elemtype, -1,
+										   arrayconst->constcollid,
+										   elmlen, elems[i], nulls[i],
+										   elmbyval));
+
+	return result;
+}
+
 /*
  * Build the targetlist for given relation to be deparsed as SELECT clause.
  *
@@ -908,14 +1298,18 @@ odbc_build_tlist_to_deparse(RelOptInfo *foreignrel)
  * (or, in the case of upper relations, into the HAVING clause).
  *
  * If params_list is not NULL, it receives a list of Params and other-relation
- * Vars used in the clauses; these values must be transmitted to the remote
- * server as parameter values.
+ * Vars used in the clauses, one for each "?" marker in the order the markers
+ * appear; these values must be transmitted to the remote server as parameter
+ * values.
  *
  * If params_list is NULL, we're generating the query for EXPLAIN purposes,
  * so Params and other-relation Vars should be replaced by dummy values.
  *
  * pathkeys is the list of pathkeys to order the result by.
  *
+ * has_limit is the flag to indicate whether the query's LIMIT and OFFSET are
+ * to be applied remotely, in the syntax the server takes.
+ *
  * is_subquery is the flag to indicate whether to deparse the specified
  * relation as a subquery.
  *
@@ -924,11 +1318,12 @@ odbc_build_tlist_to_deparse(RelOptInfo *foreignrel)
 extern void
 odbc_deparseSelectStmtForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *rel,
 						List *tlist, List *remote_conds, List *pathkeys,
-						bool is_subquery, List **retrieved_attrs,
-						List **params_list)
+						bool has_limit, bool is_subquery,
+						List **retrieved_attrs, List **params_list)
 {
 	deparse_expr_cxt context;
 	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) rel->fdw_private;
+	RelOptInfo *grouped_rel = NULL;
 	List	   *quals;
 
 	/*
@@ -943,9 +1338,27 @@ odbc_deparseSelectStmtForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *rel,
 	context.foreignrel = rel;
 	context.scanrel = IS_UPPER_REL(rel) ? fpinfo->outerrel : rel;
 	context.params_list = params_list;
+	context.dialect = &fpinfo->dialect;
+
+	/*
+	 * A DISTINCT may be computed on top of a grouping relation, whose GROUP
+	 * BY and HAVING go into the same query.  The scan relation is then the
+	 * one below the grouping.
+	 */
+	if (IS_UPPER_REL(rel))
+	{
+		if (fpinfo->stage == UPPERREL_GROUP_AGG)
+			grouped_rel = rel;
+		else if (IS_UPPER_REL(fpinfo->outerrel))
+		{
+			grouped_rel = fpinfo->outerrel;
+			context.scanrel =
+				((PgFdwRelationInfo *) grouped_rel->fdw_private)->outerrel;
+		}
+	}
 
 	/* Construct SELECT clause */
-	deparseSelectSql(tlist, is_subquery, retrieved_attrs, &context);
+	deparseSelectSql(tlist, has_limit, is_subquery, retrieved_attrs, &context);
 
 	/*
 	 * For upper relations, the WHERE clause is built from the remote
@@ -956,7 +1369,7 @@ odbc_deparseSelectStmtForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *rel,
 	{
 		PgFdwRelationInfo *ofpinfo;
 
-		ofpinfo = (PgFdwRelationInfo *) fpinfo->outerrel->fdw_private;
+		ofpinfo = (PgFdwRelationInfo *) context.scanrel->fdw_private;
 		quals = ofpinfo->remote_conds;
 	}
 	else
@@ -965,16 +1378,22 @@ odbc_deparseSelectStmtForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *rel,
 	/* Construct FROM and WHERE clauses */
 	deparseFromExpr(quals, &context);
 
-	if (IS_UPPER_REL(rel))
+	if (grouped_rel)
 	{
+		PgFdwRelationInfo *gfpinfo;
+		List	   *having;
+
+		gfpinfo = (PgFdwRelationInfo *) grouped_rel->fdw_private;
+		having = (grouped_rel == rel) ? remote_conds : gfpinfo->remote_conds;
+
 		/* Append GROUP BY clause */
-		appendGroupByClause(tlist, &context);
+		appendGroupByClause(gfpinfo->grouped_tlist, &context);
 
 		/* Append HAVING clause */
-		if (remote_conds)
+		if (having)
 		{
 			appendStringInfo(buf, " HAVING ");
-			appendConditions(remote_conds, &context);
+			appendConditions(having, &context);
 		}
 	}
 
@@ -982,6 +1401,10 @@ odbc_deparseSelectStmtForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *rel,
 	if (pathkeys)
 		appendOrderByClause(pathkeys, &context);
 
+	/* Add LIMIT clause if necessary */
+	if (has_limit)
+		appendLimitClause(&context);
+
 	/* Add any necessary FOR UPDATE/SHARE. */
 	deparseLockingClause(&context);
 }
@@ -995,13 +1418,14 @@ odbc_deparseSelectStmtForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *rel,
  * returned to *retrieved_attrs, unless we deparse the specified relation
  * as a subquery.
  *
- * tlist is the list of desired columns.  is_subquery is the flag to
- * indicate whether to deparse the specified relation as a subquery.
- * Read prologue of deparseSelectStmtForRel() for details.
+ * tlist is the list of desired columns.  has_limit and is_subquery are the
+ * flags to indicate whether a LIMIT is pushed down and whether to deparse the
+ * specified relation as a subquery.  Read prologue of
+ * deparseSelectStmtForRel() for details.
  */
 static void
-deparseSelectSql(List *tlist, bool is_subquery, List **retrieved_attrs,
-				 deparse_expr_cxt *context)
+deparseSelectSql(List *tlist, bool has_limit, bool is_subquery,
+				 List **retrieved_attrs, deparse_expr_cxt *context)
 {
 	StringInfo	buf = context->buf;
 	RelOptInfo *foreignrel = context->foreignrel;
@@ -1013,6 +1437,20 @@ deparseSelectSql(List *tlist, bool is_subquery, List **retrieved_attrs,
 	 */
 	appendStringInfoString(buf, "SELECT ");
 
+	if (IS_UPPER_REL(foreignrel) && fpinfo->stage == UPPERREL_DISTINCT)
+		appendStringInfoString(buf, "DISTINCT ");
+
+	/* A TOP row limit goes before the SELECT list */
+	if (has_limit && fpinfo->limit_syntax == ODBC_LIMIT_TOP)
+	{
+		int64		count;
+		int64		offset;
+
+		if (!odbc_get_limit_values(root->parse, &count, &offset))
+			elog(ERROR, "LIMIT of a pushed-down query is not a constant");
+		appendStringInfo(buf, "TOP " INT64_FORMAT " ", count);
+	}
+
 	if (is_subquery)
 	{
 		/*
@@ -1044,8 +1482,8 @@ deparseSelectSql(List *tlist, bool is_subquery, List **retrieved_attrs,
 		 */
 		Relation	rel = heap_open(rte->relid, NoLock);
 
-		deparseTargetList(buf, root, foreignrel->relid, rel, false,
-						  fpinfo->attrs_used, false, retrieved_attrs);
+		deparseTargetList(buf, root, foreignrel->relid, rel, context->dialect,
+						  false, fpinfo->attrs_used, false, retrieved_attrs);
 		heap_close(rel, NoLock);
 	}
 }
@@ -1096,6 +1534,7 @@ deparseTargetList(StringInfo buf,
 				  PlannerInfo *root,
 				  Index rtindex,
 				  Relation rel,
+				  const OdbcDialect *dialect,
 				  bool is_returning,
 				  Bitmapset *attrs_used,
 				  bool qualify_col,
@@ -1134,7 +1573,7 @@ deparseTargetList(StringInfo buf,
 
 			first = false;
 
-			deparseColumnRef(buf, rtindex, i, root, qualify_col);
+			deparseColumnRef(buf, rtindex, i, root, qualify_col, dialect);
 
 			*retrieved_attrs = lappend_int(*retrieved_attrs, i);
 		}
@@ -1176,6 +1615,7 @@ deparseLockingClause(deparse_expr_cxt *context)
 	RelOptInfo *rel = context->scanrel;
 	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) rel->fdw_private;
 	int			relid = -1;
+	bool		for_update = false;
 
 	while ((relid = bms_next_member(rel->relids, relid)) >= 0)
 	{
@@ -1186,6 +1626,24 @@ deparseLockingClause(deparse_expr_cxt *context)
 		if (bms_is_member(relid, fpinfo->lower_subquery_rels))
 			continue;
 
+		/*
+		 * Servers other than PostgreSQL take at most one FOR UPDATE at the
+		 * end of the query, locking the rows of all its tables.  It is used
+		 * for FOR SHARE too, as locking too much is safer than locking
+		 * nothing.  Servers without row locks get no clause at all.
+		 */
+		if (context->dialect->lock_syntax != ODBC_LOCK_POSTGRESQL)
+		{
+			PlanRowMark *rc = get_plan_rowmark(root->rowMarks, relid);
+
+			if ((relid == root->parse->resultRelation &&
+				 (root->parse->commandType == CMD_UPDATE ||
+				  root->parse->commandType == CMD_DELETE)) ||
+				(rc && rc->strength != LCS_NONE))
+				for_update = true;
+			continue;
+		}
+
 		/*
 		 * Add FOR UPDATE/SHARE if appropriate.  We apply locking during the
 		 * initial row fetch, rather than later on as is done for local
@@ -1247,6 +1705,9 @@ deparseLockingClause(deparse_expr_cxt *context)
 			}
 		}
 	}
+
+	if (for_update && context->dialect->lock_syntax == ODBC_LOCK_FOR_UPDATE)
+		appendStringInfoString(buf, " FOR UPDATE");
 }
 
 /*
@@ -1282,7 +1743,7 @@ appendConditions(List *exprs, deparse_expr_cxt *context)
 			appendStringInfoString(buf, " AND ");
 
 		appendStringInfoChar(buf, '(');
-		deparseExpr(expr, context);
+		deparsePredicate(expr, context);
 		appendStringInfoChar(buf, ')');
 
 		is_first = false;
@@ -1342,7 +1803,7 @@ deparseExplicitTargetList(List *tlist, List **retrieved_attrs,
 
 		if (i > 0)
 			appendStringInfoString(buf, ", ");
-		deparseExpr((Expr *) tle->expr, context);
+		deparseValue((Expr *) tle->expr, context);
 
 		*retrieved_attrs = lappend_int(*retrieved_attrs, i + 1);
 		i++;
@@ -1364,6 +1825,7 @@ deparseSubqueryTargetList(deparse_expr_cxt *context)
 	RelOptInfo *foreignrel = context->foreignrel;
 	bool		first;
 	ListCell   *lc;
+	int			i = 0;
 
 	/* Should only be called in these cases. */
 	Assert(IS_SIMPLE_REL(foreignrel) || IS_JOIN_REL(foreignrel));
@@ -1377,7 +1839,14 @@ deparseSubqueryTargetList(deparse_expr_cxt *context)
 			appendStringInfoString(buf, ", ");
 		first = false;
 
-		deparseExpr((Expr *) node, context);
+		deparseValue((Expr *) node, context);
+
+		/*
+		 * Only PostgreSQL takes column aliases after the subquery alias, so
+		 * others get them here (see deparseRangeTblRef).
+		 */
+		if (!context->dialect->postgres_syntax)
+			appendStringInfo(buf, " AS %s%d", SUBQUERY_COL_ALIAS_PREFIX, ++i);
 	}
 
 	/* Don't generate bad syntax if no expressions */
@@ -1421,7 +1890,7 @@ deparseFromExprForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
 		appendStringInfo(buf, "(%s %s JOIN %s ON ", join_sql_o.data,
 						 odbc_get_jointype_name(fpinfo->jointype), join_sql_i.data);
 
-		/* Append join clause; (TRUE) if no join clause */
+		/* Append join clause; (1 = 1) if no join clause */
 		if (fpinfo->joinclauses)
 		{
 			deparse_expr_cxt context;
@@ -1431,13 +1900,14 @@ deparseFromExprForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
 			context.scanrel = foreignrel;
 			context.root = root;
 			context.params_list = params_list;
+			context.dialect = &fpinfo->dialect;
 
 			appendStringInfo(buf, "(");
 			appendConditions(fpinfo->joinclauses, &context);
 			appendStringInfo(buf, ")");
 		}
 		else
-			appendStringInfoString(buf, "(TRUE)");
+			appendStringInfoString(buf, "(1 = 1)");
 
 		/* End the FROM clause entry. */
 		appendStringInfo(buf, ")");
@@ -1452,7 +1922,7 @@ deparseFromExprForRel(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
 		 */
 		Relation	rel = heap_open(rte->relid, NoLock);
 
-		deparseRelation(buf, rel);
+		deparseRelation(buf, rel, &fpinfo->dialect);
 
 		/*
 		 * Add a unique alias to avoid any conflict in relation names due to
@@ -1489,7 +1959,7 @@ deparseRangeTblRef(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
 		/* Deparse the subquery representing the relation. */
 		appendStringInfoChar(buf, '(');
 		odbc_deparseSelectStmtForRel(buf, root, foreignrel, NIL,
-								fpinfo->remote_conds, NIL, true,
+								fpinfo->remote_conds, NIL, false, true,
 								&retrieved_attrs, params_list);
 		appendStringInfoChar(buf, ')');
 
@@ -1503,7 +1973,7 @@ deparseRangeTblRef(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
 		 * deparseSubqueryTargetList).
 		 */
 		ncols = list_length(foreignrel->reltarget->exprs);
-		if (ncols > 0)
+		if (ncols > 0 && fpinfo->dialect.postgres_syntax)
 		{
 			int			i;
 
@@ -1531,7 +2001,7 @@ deparseRangeTblRef(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
  */
 void
 odbc_deparseInsertSql(StringInfo buf, PlannerInfo *root,
-				 Index rtindex, Relation rel,
+				 Index rtindex, Relation rel, const OdbcDialect *dialect,
 				 List *targetAttrs, bool doNothing,
 				 List *returningList, List **retrieved_attrs)
 {
@@ -1539,8 +2009,15 @@ odbc_deparseInsertSql(StringInfo buf, PlannerInfo *root,
 	bool		first;
 	ListCell   *lc;
 
+	/* ON CONFLICT has no counterpart on other servers */
+	if (doNothing && !dialect->postgres_syntax)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("ON CONFLICT DO NOTHING is not supported by the %s dialect",
+						dialect->name)));
+
 	appendStringInfoString(buf, "INSERT INTO ");
-	deparseRelation(buf, rel);
+	deparseRelation(buf, rel, dialect);
 
 	if (targetAttrs)
 	{
@@ -1555,7 +2032,7 @@ odbc_deparseInsertSql(StringInfo buf, PlannerInfo *root,
 				appendStringInfoString(buf, ", ");
 			first = false;
 
-			deparseColumnRef(buf, rtindex, attnum, root, false);
+			deparseColumnRef(buf, rtindex, attnum, root, false, dialect);
 		}
 
 		appendStringInfoString(buf, ") VALUES ");
@@ -1583,7 +2060,7 @@ odbc_deparseInsertSql(StringInfo buf, PlannerInfo *root,
 	if (doNothing)
 		appendStringInfoString(buf, " ON CONFLICT DO NOTHING");
 
-	deparseReturningList(buf, root, rtindex, rel,
+	deparseReturningList(buf, root, rtindex, rel, dialect,
 						 rel->trigdesc && rel->trigdesc->trig_insert_after_row,
 						 returningList, retrieved_attrs);
 }
@@ -1606,6 +2083,7 @@ odbc_deparseDirectUpdateSql(StringInfo buf, PlannerInfo *root,
 					   List **retrieved_attrs)
 {
 	RelOptInfo *baserel = root->simple_rel_array[rtindex];
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) baserel->fdw_private;
 	deparse_expr_cxt context;
 	int			nestlevel;
 	bool		first;
@@ -1617,9 +2095,10 @@ odbc_deparseDirectUpdateSql(StringInfo buf, PlannerInfo *root,
 	context.scanrel = baserel;
 	context.buf = buf;
 	context.params_list = params_list;
+	context.dialect = &fpinfo->dialect;
 
 	appendStringInfoString(buf, "UPDATE ");
-	deparseRelation(buf, rel);
+	deparseRelation(buf, rel, context.dialect);
 	appendStringInfoString(buf, " SET ");
 
 	/* Make sure any constants in the exprs are printed portably */
@@ -1639,9 +2118,9 @@ odbc_deparseDirectUpdateSql(StringInfo buf, PlannerInfo *root,
 			appendStringInfoString(buf, ", ");
 		first = false;
 
-		deparseColumnRef(buf, rtindex, attnum, root, false);
+		deparseColumnRef(buf, rtindex, attnum, root, false, context.dialect);
 		appendStringInfoString(buf, " = ");
-		deparseExpr((Expr *) tle->expr, &context);
+		deparseValue((Expr *) tle->expr, &context);
 	}
 
 	odbc_reset_transmission_modes(nestlevel);
@@ -1652,7 +2131,7 @@ odbc_deparseDirectUpdateSql(StringInfo buf, PlannerInfo *root,
 		appendConditions(remote_conds, &context);
 	}
 
-	deparseReturningList(buf, root, rtindex, rel, false,
+	deparseReturningList(buf, root, rtindex, rel, context.dialect, false,
 						 returningList, retrieved_attrs);
 }
 
@@ -1666,14 +2145,15 @@ odbc_deparseDirectUpdateSql(StringInfo buf, PlannerInfo *root,
 void
 deparseDeleteSql(StringInfo buf, PlannerInfo *root,
 				 Index rtindex, Relation rel,
+				 const OdbcDialect *dialect,
 				 List *returningList,
 				 List **retrieved_attrs)
 {
 	appendStringInfoString(buf, "DELETE FROM ");
-	deparseRelation(buf, rel);
+	deparseRelation(buf, rel, dialect);
 	//appendStringInfoString(buf, " WHERE ctid = $1");
 
-	deparseReturningList(buf, root, rtindex, rel,
+	deparseReturningList(buf, root, rtindex, rel, dialect,
 						 rel->trigdesc && rel->trigdesc->trig_delete_after_row,
 						 returningList, retrieved_attrs);
 }
@@ -1694,6 +2174,7 @@ odbc_deparseDirectDeleteSql(StringInfo buf, PlannerInfo *root,
 					   List **retrieved_attrs)
 {
 	RelOptInfo *baserel = root->simple_rel_array[rtindex];
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) baserel->fdw_private;
 	deparse_expr_cxt context;
 
 	/* Set up context struct for recursion */
@@ -1702,9 +2183,10 @@ odbc_deparseDirectDeleteSql(StringInfo buf, PlannerInfo *root,
 	context.scanrel = baserel;
 	context.buf = buf;
 	context.params_list = params_list;
+	context.dialect = &fpinfo->dialect;
 
 	appendStringInfoString(buf, "DELETE FROM ");
-	deparseRelation(buf, rel);
+	deparseRelation(buf, rel, context.dialect);
 
 	if (remote_conds)
 	{
@@ -1712,7 +2194,7 @@ odbc_deparseDirectDeleteSql(StringInfo buf, PlannerInfo *root,
 		appendConditions(remote_conds, &context);
 	}
 
-	deparseReturningList(buf, root, rtindex, rel, false,
+	deparseReturningList(buf, root, rtindex, rel, context.dialect, false,
 						 returningList, retrieved_attrs);
 }
 
@@ -1722,6 +2204,7 @@ odbc_deparseDirectDeleteSql(StringInfo buf, PlannerInfo *root,
 static void
 deparseReturningList(StringInfo buf, PlannerInfo *root,
 					 Index rtindex, Relation rel,
+					 const OdbcDialect *dialect,
 					 bool trig_after_row,
 					 List *returningList,
 					 List **retrieved_attrs)
@@ -1746,31 +2229,129 @@ deparseReturningList(StringInfo buf, PlannerInfo *root,
 	}
 
 	if (attrs_used != NULL)
-		deparseTargetList(buf, root, rtindex, rel, true, attrs_used, false,
-						  retrieved_attrs);
+		deparseTargetList(buf, root, rtindex, rel, dialect, true, attrs_used,
+						  false, retrieved_attrs);
 	else
 		*retrieved_attrs = NIL;
 }
 
 /*
- * Construct name to use for given column, and emit it into buf.
- * If it has a column_name FDW option, use that instead of attribute name.
+ * Construct SELECT statement to count the rows of the remote table, for
+ * sampling it.
+ */
+void
+odbc_deparseAnalyzeSizeSql(StringInfo buf, Relation rel,
+						   const OdbcDialect *dialect)
+{
+	appendStringInfoString(buf, "SELECT COUNT(*) FROM ");
+	deparseRelation(buf, rel, dialect);
+}
+
+/*
+ * Construct SELECT statement to acquire sample rows of given relation.
  *
- * If qualify_col is true, qualify column name with the alias of relation.
+ * SELECT command is appended to buf, and list of columns retrieved
+ * is returned to *retrieved_attrs.
+ *
+ * Unless method is ODBC_SAMPLE_OFF, the remote server is asked to return
+ * roughly sample_frac of the rows.
  */
-static void
-deparseColumnRef(StringInfo buf, int varno, int varattno, PlannerInfo *root,
-				 bool qualify_col)
+void
+odbc_deparseAnalyzeSql(StringInfo buf, Relation rel,
+					   const OdbcDialect *dialect, OdbcSampleMethod method,
+					   double sample_frac, List **retrieved_attrs)
 {
-	RangeTblEntry *rte;
+	Oid			relid = RelationGetRelid(rel);
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	int			i;
+	char	   *colname;
+	List	   *options;
+	ListCell   *lc;
+	bool		first = true;
 
-	/* We support fetching the remote side's CTID and OID. */
-	if (varattno == SelfItemPointerAttributeNumber)
+	*retrieved_attrs = NIL;
+
+	appendStringInfoString(buf, "SELECT ");
+	for (i = 0; i < tupdesc->natts; i++)
 	{
-		if (qualify_col)
-			ADD_REL_QUALIFIER(buf, varno);
-		appendStringInfoString(buf, "ctid");
-	}
+		/* Ignore dropped columns. */
+		if (tupdesc->attrs[i]->attisdropped)
+			continue;
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		/* Use attribute name or column_name option. */
+		colname = NameStr(tupdesc->attrs[i]->attname);
+		options = GetForeignColumnOptions(relid, i + 1);
+
+		foreach(lc, options)
+		{
+			DefElem    *def = (DefElem *) lfirst(lc);
+
+			if (strcmp(def->defname, "column_name") == 0)
+			{
+				colname = defGetString(def);
+				break;
+			}
+		}
+
+		appendStringInfoString(buf, odbc_quote_identifier(colname, dialect));
+
+		*retrieved_attrs = lappend_int(*retrieved_attrs, i + 1);
+	}
+
+	/* Don't generate bad syntax for zero-column relation. */
+	if (first)
+		appendStringInfoString(buf, "NULL");
+
+	/*
+	 * Construct FROM clause, and the sampling clause of the method.
+	 */
+	appendStringInfoString(buf, " FROM ");
+	deparseRelation(buf, rel, dialect);
+
+	switch (method)
+	{
+		case ODBC_SAMPLE_OFF:
+			break;
+		case ODBC_SAMPLE_TABLESAMPLE:
+			appendStringInfo(buf, " TABLESAMPLE BERNOULLI (%f)",
+							 100.0 * sample_frac);
+			break;
+		case ODBC_SAMPLE_SAMPLE:
+			appendStringInfo(buf, " SAMPLE (%f)", 100.0 * sample_frac);
+			break;
+		case ODBC_SAMPLE_RANDOM:
+			appendStringInfo(buf, " WHERE RAND() < %.8f", sample_frac);
+			break;
+		case ODBC_SAMPLE_AUTO:
+			/* should have been resolved into an actual method */
+			elog(ERROR, "unexpected sampling method");
+			break;
+	}
+}
+
+/*
+ * Construct name to use for given column, and emit it into buf.
+ * If it has a column_name FDW option, use that instead of attribute name.
+ *
+ * If qualify_col is true, qualify column name with the alias of relation.
+ */
+static void
+deparseColumnRef(StringInfo buf, int varno, int varattno, PlannerInfo *root,
+				 bool qualify_col, const OdbcDialect *dialect)
+{
+	RangeTblEntry *rte;
+
+	/* We support fetching the remote side's CTID and OID. */
+	if (varattno == SelfItemPointerAttributeNumber)
+	{
+		if (qualify_col)
+			ADD_REL_QUALIFIER(buf, varno);
+		appendStringInfoString(buf, "ctid");
+	}
 	else if (varattno == ObjectIdAttributeNumber)
 	{
 		if (qualify_col)
@@ -1845,8 +2426,8 @@ deparseColumnRef(StringInfo buf, int varno, int varattno, PlannerInfo *root,
 		}
 
 		appendStringInfoString(buf, "ROW(");
-		deparseTargetList(buf, root, varno, rel, false, attrs_used, qualify_col,
-						  &retrieved_attrs);
+		deparseTargetList(buf, root, varno, rel, dialect, false, attrs_used,
+						  qualify_col, &retrieved_attrs);
 		appendStringInfoString(buf, ")");
 
 		/* Complete the CASE WHEN statement started above. */
@@ -1894,7 +2475,7 @@ deparseColumnRef(StringInfo buf, int varno, int varattno, PlannerInfo *root,
 		if (qualify_col)
 			ADD_REL_QUALIFIER(buf, varno);
 
-		appendStringInfoString(buf, quote_identifier(colname));
+		appendStringInfoString(buf, odbc_quote_identifier(colname, dialect));
 	}
 }
 
@@ -1904,7 +2485,7 @@ deparseColumnRef(StringInfo buf, int varno, int varattno, PlannerInfo *root,
  * Similarly, schema_name FDW option overrides schema name.
  */
 static void
-deparseRelation(StringInfo buf, Relation rel)
+deparseRelation(StringInfo buf, Relation rel, const OdbcDialect *dialect)
 {
 	ForeignTable *table;
 	const char *nspname = NULL;
@@ -1936,32 +2517,40 @@ deparseRelation(StringInfo buf, Relation rel)
 	if (relname == NULL)
 		relname = RelationGetRelationName(rel);
 
-	appendStringInfo(buf, "%s.%s",
-					 quote_identifier(nspname), quote_identifier(relname));
+	appendStringInfo(buf, "%s%c%s",
+					 odbc_quote_identifier(nspname, dialect),
+					 dialect->name_separator,
+					 odbc_quote_identifier(relname, dialect));
 }
 
 /*
- * Append a SQL string literal representing "val" to buf.
+ * Append a SQL string literal representing "val" to buf, escaped the way
+ * the dialect reads string literals.
  */
 void
-odbc_deparseStringLiteral(StringInfo buf, const char *val)
+odbc_deparseStringLiteral(StringInfo buf, const char *val,
+						  const OdbcDialect *dialect)
 {
 	const char *valptr;
+	bool		escape_backslash;
 
 	/*
 	 * Rather than making assumptions about the remote server's value of
 	 * standard_conforming_strings, always use E'foo' syntax if there are any
 	 * backslashes.  This will fail on remote servers before 8.1, but those
-	 * are long out of support.
+	 * are long out of support.  Other servers either always or never take a
+	 * backslash as an escape.
 	 */
-	if (strchr(val, '\\') != NULL)
+	escape_backslash = (dialect->string_escape != ODBC_ESCAPE_STANDARD);
+	if (dialect->string_escape == ODBC_ESCAPE_POSTGRESQL &&
+		strchr(val, '\\') != NULL)
 		appendStringInfoChar(buf, ESCAPE_STRING_SYNTAX);
 	appendStringInfoChar(buf, '\'');
 	for (valptr = val; *valptr; valptr++)
 	{
 		char		ch = *valptr;
 
-		if (SQL_STR_DOUBLE(ch, true))
+		if (SQL_STR_DOUBLE(ch, escape_backslash))
 			appendStringInfoChar(buf, ch);
 		appendStringInfoChar(buf, ch);
 	}
@@ -2025,6 +2614,9 @@ deparseExpr(Expr *node, deparse_expr_cxt *context)
 		case T_Aggref:
 			deparseAggref((Aggref *) node, context);
 			break;
+		case T_GroupingFunc:
+			deparseGroupingFunc((GroupingFunc *) node, context);
+			break;
 		default:
 			elog(ERROR, "unsupported expression type for deparse: %d",
 				 (int) nodeTag(node));
@@ -2032,6 +2624,48 @@ deparseExpr(Expr *node, deparse_expr_cxt *context)
 	}
 }
 
+/*
+ * Deparse an expression used as a condition, such as a WHERE clause or an
+ * argument of AND.  A server without a boolean type takes only predicates
+ * there, so other expressions are compared with 1, the true of such servers.
+ */
+static void
+deparsePredicate(Expr *node, deparse_expr_cxt *context)
+{
+	if (context->dialect->has_boolean || is_predicate(node))
+	{
+		deparseExpr(node, context);
+		return;
+	}
+
+	appendStringInfoChar(context->buf, '(');
+	deparseExpr(node, context);
+	appendStringInfoString(context->buf, " = 1)");
+}
+
+/*
+ * Deparse an expression used as a value, such as an entry of a SELECT list.
+ * A server without a boolean type can't take a predicate there, so it is
+ * turned into 1 or 0, or NULL when the predicate is unknown.
+ */
+static void
+deparseValue(Expr *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+
+	if (context->dialect->has_boolean || !is_predicate(node))
+	{
+		deparseExpr(node, context);
+		return;
+	}
+
+	appendStringInfoString(buf, "(CASE WHEN ");
+	deparseExpr(node, context);
+	appendStringInfoString(buf, " THEN 1 WHEN NOT ");
+	deparseExpr(node, context);
+	appendStringInfoString(buf, " THEN 0 END)");
+}
+
 /*
  * Deparse given Var node into context->buf.
  *
@@ -2065,31 +2699,12 @@ deparseVar(Var *node, deparse_expr_cxt *context)
 
 	if (bms_is_member(node->varno, relids) && node->varlevelsup == 0)
 		deparseColumnRef(context->buf, node->varno, node->varattno,
-						 context->root, qualify_col);
+						 context->root, qualify_col, context->dialect);
 	else
 	{
 		/* Treat like a Param */
 		if (context->params_list)
-		{
-			int			pindex = 0;
-			ListCell   *lc;
-
-			/* find its index in params_list */
-			foreach(lc, *context->params_list)
-			{
-				pindex++;
-				if (equal(node, (Node *) lfirst(lc)))
-					break;
-			}
-			if (lc == NULL)
-			{
-				/* not in list, so add it */
-				pindex++;
-				*context->params_list = lappend(*context->params_list, node);
-			}
-
-			printRemoteParam(pindex, node->vartype, node->vartypmod, context);
-		}
+			printRemoteParam((Node *) node, context);
 		else
 		{
 			printRemotePlaceholder(node->vartype, node->vartypmod, context);
@@ -2118,13 +2733,22 @@ deparseConst(Const *node, deparse_expr_cxt *context, int showtype)
 	if (node->constisnull)
 	{
 		appendStringInfoString(buf, "NULL");
-		if (showtype >= 0)
+		if (showtype >= 0 && context->dialect->postgres_syntax)
 			appendStringInfo(buf, "::%s",
 							 deparse_type_name(node->consttype,
 											   node->consttypmod));
 		return;
 	}
 
+	if (context->dialect->datetime_escapes &&
+		(node->consttype == DATEOID ||
+		 node->consttype == TIMEOID ||
+		 node->consttype == TIMESTAMPOID))
+	{
+		deparseDatetimeConst(node, context);
+		return;
+	}
+
 	getTypeOutputInfo(node->consttype,
 					  &typoutput, &typIsVarlena);
 	extval = OidOutputFunctionCall(typoutput, node->constvalue);
@@ -2161,7 +2785,10 @@ deparseConst(Const *node, deparse_expr_cxt *context, int showtype)
 			appendStringInfo(buf, "B'%s'", extval);
 			break;
 		case BOOLOID:
-			if (strcmp(extval, "t") == 0)
+			if (!context->dialect->has_boolean)
+				appendStringInfoString(buf,
+									   strcmp(extval, "t") == 0 ? "1" : "0");
+			else if (strcmp(extval, "t") == 0)
 				appendStringInfoString(buf, "true");
 			else
 				appendStringInfoString(buf, "false");
@@ -2178,7 +2805,7 @@ deparseConst(Const *node, deparse_expr_cxt *context, int showtype)
 			appendStringInfo(buf, "%s", extval);
 			break;
 		default:
-			odbc_deparseStringLiteral(buf, extval);
+			odbc_deparseStringLiteral(buf, extval, context->dialect);
 			break;
 	}
 
@@ -2214,38 +2841,66 @@ deparseConst(Const *node, deparse_expr_cxt *context, int showtype)
 										   node->consttypmod));*/
 }
 
+/*
+ * Deparse a date, time or timestamp constant as an ODBC escape sequence,
+ * which the driver turns into a literal the server reads.  Dates are
+ * written in ISO style whatever DateStyle is, as the escapes require.
+ */
+static void
+deparseDatetimeConst(Const *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	struct pg_tm tm;
+	fsec_t		fsec;
+	char		str[MAXDATELEN + 1];
+
+	switch (node->consttype)
+	{
+		case DATEOID:
+			j2date(DatumGetDateADT(node->constvalue) + POSTGRES_EPOCH_JDATE,
+				   &tm.tm_year, &tm.tm_mon, &tm.tm_mday);
+			EncodeDateOnly(&tm, USE_ISO_DATES, str);
+			appendStringInfo(buf, "{d '%s'}", str);
+			break;
+		case TIMEOID:
+			{
+				Oid			typoutput;
+				bool		typIsVarlena;
+
+				/* Times are output alike in all styles */
+				getTypeOutputInfo(node->consttype, &typoutput, &typIsVarlena);
+				appendStringInfo(buf, "{t '%s'}",
+								 OidOutputFunctionCall(typoutput,
+													   node->constvalue));
+			}
+			break;
+		case TIMESTAMPOID:
+			if (timestamp2tm(DatumGetTimestamp(node->constvalue), NULL,
+							 &tm, &fsec, NULL, NULL) != 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+						 errmsg("timestamp out of range")));
+			EncodeDateTime(&tm, fsec, false, 0, NULL, USE_ISO_DATES, str);
+			appendStringInfo(buf, "{ts '%s'}", str);
+			break;
+		default:
+			elog(ERROR, "unexpected date/time type %u", node->consttype);
+			break;
+	}
+}
+
 /*
  * Deparse given Param node.
  *
- * If we're generating the query "for real", add the Param to
- * context->params_list if it's not already present, and then use its index
- * in that list as the remote parameter number.  During EXPLAIN, there's
- * no need to identify a parameter number.
+ * If we're generating the query "for real", print a parameter marker and
+ * add the Param to context->params_list.  During EXPLAIN, there's no value
+ * to bind, so print a placeholder instead.
  */
 static void
 deparseParam(Param *node, deparse_expr_cxt *context)
 {
 	if (context->params_list)
-	{
-		int			pindex = 0;
-		ListCell   *lc;
-
-		/* find its index in params_list */
-		foreach(lc, *context->params_list)
-		{
-			pindex++;
-			if (equal(node, (Node *) lfirst(lc)))
-				break;
-		}
-		if (lc == NULL)
-		{
-			/* not in list, so add it */
-			pindex++;
-			*context->params_list = lappend(*context->params_list, node);
-		}
-
-		printRemoteParam(pindex, node->paramtype, node->paramtypmod, context);
-	}
+		printRemoteParam((Node *) node, context);
 	else
 	{
 		printRemotePlaceholder(node->paramtype, node->paramtypmod, context);
@@ -2319,6 +2974,11 @@ deparseFuncExpr(FuncExpr *node, deparse_expr_cxt *context)
 		return;
 	}
 
+	/* Other servers are sent the ODBC function standing for it */
+	if (deparseRemoteTemplate(node->funcid, ProcedureRelationId, node->args,
+							  context))
+		return;
+
 	/*
 	 * If the function call came from a cast, then show the first argument
 	 * plus an explicit cast operation.
@@ -2360,6 +3020,41 @@ deparseFuncExpr(FuncExpr *node, deparse_expr_cxt *context)
 	appendStringInfoChar(buf, ')');
 }
 
+/*
+ * Deparse a call of a built-in function or operator as the ODBC function
+ * standing for it on servers other than PostgreSQL, %n in its template
+ * being replaced by the nth argument.  Returns false if there is none.
+ */
+static bool
+deparseRemoteTemplate(Oid objectId, Oid classId, List *args,
+					  deparse_expr_cxt *context)
+{
+	PgFdwRelationInfo *fpinfo;
+	const char *template;
+	const char *p;
+
+	if (context->dialect->postgres_syntax)
+		return false;
+
+	fpinfo = (PgFdwRelationInfo *) context->foreignrel->fdw_private;
+	template = odbc_remote_template(objectId, classId, args, fpinfo);
+	if (template == NULL)
+		return false;
+
+	for (p = template; *p; p++)
+	{
+		if (p[0] == '%' && p[1] >= '1' && p[1] <= '9')
+		{
+			deparseExpr((Expr *) list_nth(args, p[1] - '1'), context);
+			p++;
+		}
+		else
+			appendStringInfoChar(context->buf, *p);
+	}
+
+	return true;
+}
+
 /*
  * Deparse given operator expression.   To avoid problems around
  * priority of operations, we always parenthesize the arguments.
@@ -2373,6 +3068,11 @@ deparseOpExpr(OpExpr *node, deparse_expr_cxt *context)
 	char		oprkind;
 	ListCell   *arg;
 
+	/* Other servers may be sent an ODBC function standing for it */
+	if (deparseRemoteTemplate(node->opno, OperatorRelationId, node->args,
+							  context))
+		return;
+
 	/* Retrieve information about the operator from system catalog. */
 	tuple = SearchSysCache1(OPEROID, ObjectIdGetDatum(node->opno));
 	if (!HeapTupleIsValid(tuple))
@@ -2407,6 +3107,16 @@ deparseOpExpr(OpExpr *node, deparse_expr_cxt *context)
 		deparseExpr(lfirst(arg), context);
 	}
 
+	/*
+	 * Backslash is the escape of LIKE patterns, which servers taking no
+	 * escapes in string literals have to be told.
+	 */
+	if (context->dialect->string_escape == ODBC_ESCAPE_STANDARD &&
+		form->oprnamespace == PG_CATALOG_NAMESPACE &&
+		(strcmp(NameStr(form->oprname), "~~") == 0 ||
+		 strcmp(NameStr(form->oprname), "!~~") == 0))
+		appendStringInfoString(buf, " ESCAPE '\\'");
+
 	appendStringInfoChar(buf, ')');
 
 	ReleaseSysCache(tuple);
@@ -2454,6 +3164,17 @@ deparseDistinctExpr(DistinctExpr *node, deparse_expr_cxt *context)
 
 	Assert(list_length(node->args) == 2);
 
+	/* MySQL has only the negation, as its null-safe equality */
+	if (!context->dialect->distinct_from)
+	{
+		appendStringInfoString(buf, "(NOT (");
+		deparseExpr(linitial(node->args), context);
+		appendStringInfoString(buf, " <=> ");
+		deparseExpr(lsecond(node->args), context);
+		appendStringInfoString(buf, "))");
+		return;
+	}
+
 	appendStringInfoChar(buf, '(');
 	deparseExpr(linitial(node->args), context);
 	appendStringInfoString(buf, " IS DISTINCT FROM ");
@@ -2473,6 +3194,25 @@ deparseScalarArrayOpExpr(ScalarArrayOpExpr *node, deparse_expr_cxt *context)
 	Form_pg_operator form;
 	Expr	   *arg1;
 	Expr	   *arg2;
+	List	   *in_list;
+	ListCell   *lc;
+
+	/* A constant array is written as an IN or NOT IN list. */
+	in_list = get_in_list(node);
+	if (in_list != NIL)
+	{
+		appendStringInfoChar(buf, '(');
+		deparseExpr(linitial(node->args), context);
+		appendStringInfoString(buf, node->useOr ? " IN (" : " NOT IN (");
+		foreach(lc, in_list)
+		{
+			if (lc != list_head(in_list))
+				appendStringInfoString(buf, ", ");
+			deparseExpr((Expr *) lfirst(lc), context);
+		}
+		appendStringInfoString(buf, "))");
+		return;
+	}
 
 	/* Retrieve information about the operator from system catalog. */
 	tuple = SearchSysCache1(OPEROID, ObjectIdGetDatum(node->opno));
@@ -2556,7 +3296,8 @@ static void
 deparseRelabelType(RelabelType *node, deparse_expr_cxt *context)
 {
 	deparseExpr(node->arg, context);
-	if (node->relabelformat != COERCE_IMPLICIT_CAST)
+	if (node->relabelformat != COERCE_IMPLICIT_CAST &&
+		context->dialect->postgres_syntax)
 		appendStringInfo(context->buf, "::%s",
 						 deparse_type_name(node->resulttype,
 										   node->resulttypmod));
@@ -2583,7 +3324,7 @@ deparseBoolExpr(BoolExpr *node, deparse_expr_cxt *context)
 			break;
 		case NOT_EXPR:
 			appendStringInfoString(buf, "(NOT ");
-			deparseExpr(linitial(node->args), context);
+			deparsePredicate(linitial(node->args), context);
 			appendStringInfoChar(buf, ')');
 			return;
 	}
@@ -2594,7 +3335,7 @@ deparseBoolExpr(BoolExpr *node, deparse_expr_cxt *context)
 	{
 		if (!first)
 			appendStringInfo(buf, " %s ", op);
-		deparseExpr((Expr *) lfirst(lc), context);
+		deparsePredicate((Expr *) lfirst(lc), context);
 		first = false;
 	}
 	appendStringInfoChar(buf, ')');
@@ -2808,19 +3549,16 @@ appendAggOrderBy(List *orderList, List *targetList, deparse_expr_cxt *context)
 /*
  * Print the representation of a parameter to be sent to the remote side.
  *
- * Note: we always label the Param's type explicitly rather than relying on
- * transmitting a numeric type OID in PQexecParams().  This allows us to
- * avoid assuming that types have the same OIDs on the remote side as they
- * do locally --- they need only have the same names.
+ * ODBC parameter markers are positional, so node is appended to
+ * context->params_list once for every marker, even if it was seen before.
+ * The type of the value is given by the SQL type it is bound with, not
+ * written into the query, since type names differ between data sources.
  */
 static void
-printRemoteParam(int paramindex, Oid paramtype, int32 paramtypmod,
-				 deparse_expr_cxt *context)
+printRemoteParam(Node *node, deparse_expr_cxt *context)
 {
-	StringInfo	buf = context->buf;
-	char	   *ptypename = deparse_type_name(paramtype, paramtypmod);
-
-	appendStringInfo(buf, "$%d::%s", paramindex, ptypename);
+	*context->params_list = lappend(*context->params_list, node);
+	appendStringInfoChar(context->buf, '?');
 }
 
 /*
@@ -2838,17 +3576,50 @@ printRemoteParam(int paramindex, Oid paramtype, int32 paramtypmod,
  * apparently useless outer cast is to ensure that the representation as a
  * whole will be parsed as an a_expr and not a select_with_parens; the latter
  * would do the wrong thing in the context "x = ANY(...)".
+ *
+ * Other servers have neither the cast nor the type names, and get a plain
+ * NULL.
  */
 static void
 printRemotePlaceholder(Oid paramtype, int32 paramtypmod,
 					   deparse_expr_cxt *context)
 {
 	StringInfo	buf = context->buf;
-	char	   *ptypename = deparse_type_name(paramtype, paramtypmod);
+	char	   *ptypename;
+
+	if (!context->dialect->postgres_syntax)
+	{
+		appendStringInfoString(buf, "NULL");
+		return;
+	}
+
+	ptypename = deparse_type_name(paramtype, paramtypmod);
 
 	appendStringInfo(buf, "((SELECT null::%s)::%s)", ptypename, ptypename);
 }
 
+/*
+ * Deparse a GROUPING() function.
+ */
+static void
+deparseGroupingFunc(GroupingFunc *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	ListCell   *lc;
+	bool		first = true;
+
+	appendStringInfoString(buf, "GROUPING(");
+	foreach(lc, node->args)
+	{
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		deparseExpr((Expr *) lfirst(lc), context);
+	}
+	appendStringInfoChar(buf, ')');
+}
+
 /*
  * Deparse GROUP BY clause.
  */
@@ -2861,16 +3632,51 @@ appendGroupByClause(List *tlist, deparse_expr_cxt *context)
 	bool		first = true;
 
 	/* Nothing to be done, if there's no GROUP BY clause in the query. */
-	if (!query->groupClause)
+	if (!query->groupClause && !query->groupingSets)
 		return;
 
 	appendStringInfo(buf, " GROUP BY ");
 
 	/*
-	 * Queries with grouping sets are not pushed down, so we don't expect
-	 * grouping sets here.
+	 * Grouping sets are only pushed down to servers that support them.  The
+	 * top-level list holds the grouping sets, with any plain GROUP BY items
+	 * wrapped in simple sets.
 	 */
-	Assert(!query->groupingSets);
+	if (query->groupingSets)
+	{
+		foreach(lc, query->groupingSets)
+		{
+			GroupingSet *gset = (GroupingSet *) lfirst(lc);
+
+			if (!first)
+				appendStringInfoString(buf, ", ");
+			first = false;
+
+			/*
+			 * The items of a plain set are concatenated into the other sets
+			 * just like a parenthesized list would be, so list them one by
+			 * one; a parenthesized list might be taken for a row value.
+			 */
+			if (gset->kind == GROUPING_SET_SIMPLE)
+			{
+				ListCell   *lc2;
+				bool		first_item = true;
+
+				foreach(lc2, gset->content)
+				{
+					if (!first_item)
+						appendStringInfoString(buf, ", ");
+					first_item = false;
+
+					deparseSortGroupClause(lfirst_int(lc2), tlist, false,
+										   context);
+				}
+			}
+			else
+				deparseGroupingSet(gset, tlist, context);
+		}
+		return;
+	}
 
 	foreach(lc, query->groupClause)
 	{
@@ -2884,10 +3690,66 @@ appendGroupByClause(List *tlist, deparse_expr_cxt *context)
 	}
 }
 
+/*
+ * Deparse a grouping set: ROLLUP, CUBE or GROUPING SETS, or a parenthesized
+ * list of grouping expressions within one of them.
+ */
+static void
+deparseGroupingSet(GroupingSet *gset, List *tlist, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	ListCell   *lc;
+	bool		first = true;
+
+	switch (gset->kind)
+	{
+		case GROUPING_SET_EMPTY:
+			appendStringInfoString(buf, "()");
+			return;
+
+		case GROUPING_SET_SIMPLE:
+			appendStringInfoChar(buf, '(');
+			foreach(lc, gset->content)
+			{
+				if (!first)
+					appendStringInfoString(buf, ", ");
+				first = false;
+
+				deparseSortGroupClause(lfirst_int(lc), tlist, false, context);
+			}
+			appendStringInfoChar(buf, ')');
+			return;
+
+		case GROUPING_SET_ROLLUP:
+			appendStringInfoString(buf, "ROLLUP(");
+			break;
+
+		case GROUPING_SET_CUBE:
+			appendStringInfoString(buf, "CUBE(");
+			break;
+
+		case GROUPING_SET_SETS:
+			appendStringInfoString(buf, "GROUPING SETS(");
+			break;
+	}
+
+	foreach(lc, gset->content)
+	{
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		deparseGroupingSet((GroupingSet *) lfirst(lc), tlist, context);
+	}
+	appendStringInfoChar(buf, ')');
+}
+
 /*
  * Deparse ORDER BY clause according to the given pathkeys for given base
  * relation. From given pathkeys expressions belonging entirely to the given
- * base relation are obtained and deparsed.
+ * base relation are obtained and deparsed.  For an upper relation, the
+ * pathkeys are those of the query's final sort, and the expressions are
+ * taken from the grouping target.
  */
 static void
 appendOrderByClause(List *pathkeys, deparse_expr_cxt *context)
@@ -2907,11 +3769,17 @@ appendOrderByClause(List *pathkeys, deparse_expr_cxt *context)
 		PathKey    *pathkey = lfirst(lcell);
 		Expr	   *em_expr;
 
-		em_expr = odbc_find_em_expr_for_rel(pathkey->pk_eclass, baserel);
-		Assert(em_expr != NULL);
+		if (IS_UPPER_REL(context->foreignrel))
+			em_expr = odbc_find_em_expr_for_input_target(context->root,
+														 pathkey->pk_eclass,
+														 context->root->upper_targets[UPPERREL_GROUP_AGG]);
+		else
+			em_expr = odbc_find_em_expr_for_rel(pathkey->pk_eclass, baserel);
+		if (em_expr == NULL)
+			elog(ERROR, "could not find pathkey item to sort");
 
 		appendStringInfoString(buf, delim);
-		deparseExpr(em_expr, context);
+		deparseValue(em_expr, context);
 		if (pathkey->pk_strategy == BTLessStrategyNumber)
 			appendStringInfoString(buf, " ASC");
 		else
@@ -2927,6 +3795,88 @@ appendOrderByClause(List *pathkeys, deparse_expr_cxt *context)
 	odbc_reset_transmission_modes(nestlevel);
 }
 
+/*
+ * Deparse LIMIT/OFFSET clause, in the syntax of the remote server.
+ *
+ * TOP is emitted by deparseSelectSql(), and SQL_ATTR_MAX_ROWS is applied at
+ * execution, so there is nothing to append for those.
+ */
+static void
+appendLimitClause(deparse_expr_cxt *context)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) context->foreignrel->fdw_private;
+	StringInfo	buf = context->buf;
+	int64		count;
+	int64		offset;
+
+	if (!odbc_get_limit_values(context->root->parse, &count, &offset))
+		elog(ERROR, "LIMIT of a pushed-down query is not a constant");
+
+	switch (fpinfo->limit_syntax)
+	{
+		case ODBC_LIMIT_LIMIT:
+			appendStringInfo(buf, " LIMIT " INT64_FORMAT, count);
+			if (offset > 0)
+				appendStringInfo(buf, " OFFSET " INT64_FORMAT, offset);
+			break;
+
+		case ODBC_LIMIT_FETCH_FIRST:
+			if (offset > 0)
+				appendStringInfo(buf, " OFFSET " INT64_FORMAT " ROWS", offset);
+			appendStringInfo(buf, " FETCH FIRST " INT64_FORMAT " ROWS ONLY",
+							 count);
+			break;
+
+		case ODBC_LIMIT_TOP:
+		case ODBC_LIMIT_MAX_ROWS:
+			break;
+	}
+}
+
+/*
+ * Get the LIMIT and OFFSET values of the query.
+ *
+ * Returns false if either is not a constant, or is negative (which the
+ * executor would complain about).  A missing count, or LIMIT ALL, is returned
+ * as -1; a missing offset as 0.
+ */
+bool
+odbc_get_limit_values(Query *query, int64 *count, int64 *offset)
+{
+	*count = -1;
+	*offset = 0;
+
+	if (query->limitCount)
+	{
+		Const	   *limit = (Const *) query->limitCount;
+
+		if (!IsA(limit, Const))
+			return false;
+		if (!limit->constisnull)
+		{
+			*count = DatumGetInt64(limit->constvalue);
+			if (*count < 0)
+				return false;
+		}
+	}
+
+	if (query->limitOffset)
+	{
+		Const	   *limit = (Const *) query->limitOffset;
+
+		if (!IsA(limit, Const))
+			return false;
+		if (!limit->constisnull)
+		{
+			*offset = DatumGetInt64(limit->constvalue);
+			if (*offset < 0)
+				return false;
+		}
+	}
+
+	return true;
+}
+
 /*
  * appendFunctionName
  *		Deparses function name from given function oid.
@@ -2950,12 +3900,14 @@ appendFunctionName(Oid funcid, deparse_expr_cxt *context)
 		const char *schemaname;
 
 		schemaname = get_namespace_name(procform->pronamespace);
-		appendStringInfo(buf, "%s.", quote_identifier(schemaname));
+		appendStringInfo(buf, "%s%c",
+						 odbc_quote_identifier(schemaname, context->dialect),
+						 context->dialect->name_separator);
 	}
 
 	/* Always print the function name */
 	proname = NameStr(procform->proname);
-	appendStringInfo(buf, "%s", quote_identifier(proname));
+	appendStringInfo(buf, "%s", odbc_quote_identifier(proname, context->dialect));
 
 	ReleaseSysCache(proctup);
 }
@@ -2998,7 +3950,7 @@ deparseSortGroupClause(Index ref, List *tlist, bool force_colno,
 	{
 		/* Always parenthesize the expression. */
 		appendStringInfoString(buf, "(");
-		deparseExpr(expr, context);
+		deparseValue(expr, context);
 		appendStringInfoString(buf, ")");
 	}
 
@@ -0,0 +1,348 @@
+/*-------------------------------------------------------------------------
+ *
+ * odbc_dialect.c
+ *		  SQL dialects of the remote servers
+ *
+ * The deparser was written for PostgreSQL, but the server at the other end
+ * of a DSN may speak another SQL.  A dialect profile tells the deparser how
+ * to quote identifiers and write literals, which LIMIT and locking syntax
+ * the server takes, and which constructs must be evaluated locally.
+ *
+ * The profile is named by the dialect server option.  By default it is
+ * chosen from the DBMS name the driver reports, and the identifier quote
+ * and name separator the driver reports replace those of the profile.
+ * Either way the scalar and aggregate functions the driver supports are
+ * added to it, for odbc_shippable.c to decide which functions are sent.
+ * Dialects are cached per server for the life of the backend.
+ *
+ * Portions Copyright (c) 2012-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2017-2018, www.cstech.ltd
+ *
+ * IDENTIFICATION
+ *		  contrib/odbc_fdw/odbc_dialect.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "odbc_fdw.h"
+
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/syscache.h"
+
+/*
+ * The dialect profiles, in the order of OdbcDialectKind.  Servers not
+ * recognized get the generic one, which only uses SQL that every ODBC
+ * driver has to understand.
+ */
+static const OdbcDialect dialects[] =
+{
+	{ODBC_DIALECT_AUTO, "auto"},
+	{ODBC_DIALECT_POSTGRESQL, "postgresql", '"', '"', '.',
+		ODBC_ESCAPE_POSTGRESQL, true, true, true, false, true,
+		ODBC_LOCK_POSTGRESQL, ODBC_LIMIT_LIMIT,
+		ODBC_SAMPLE_TABLESAMPLE, ODBC_ESTIMATOR_POSTGRESQL},
+	{ODBC_DIALECT_MYSQL, "mysql", '`', '`', '.',
+		ODBC_ESCAPE_BACKSLASH, false, true, false, true, false,
+		ODBC_LOCK_FOR_UPDATE, ODBC_LIMIT_LIMIT,
+		ODBC_SAMPLE_RANDOM, ODBC_ESTIMATOR_MYSQL},
+	{ODBC_DIALECT_SQLSERVER, "sqlserver", '[', ']', '.',
+		ODBC_ESCAPE_STANDARD, false, false, true, true, false,
+		ODBC_LOCK_NONE, ODBC_LIMIT_TOP,
+		ODBC_SAMPLE_OFF, ODBC_ESTIMATOR_SQLSERVER},
+	{ODBC_DIALECT_ORACLE, "oracle", '"', '"', '.',
+		ODBC_ESCAPE_STANDARD, false, false, false, true, false,
+		ODBC_LOCK_FOR_UPDATE, ODBC_LIMIT_FETCH_FIRST,
+		ODBC_SAMPLE_SAMPLE, ODBC_ESTIMATOR_STATISTICS},
+	{ODBC_DIALECT_DB2, "db2", '"', '"', '.',
+		ODBC_ESCAPE_STANDARD, false, false, true, true, true,
+		ODBC_LOCK_FOR_UPDATE, ODBC_LIMIT_FETCH_FIRST,
+		ODBC_SAMPLE_TABLESAMPLE, ODBC_ESTIMATOR_STATISTICS},
+	{ODBC_DIALECT_HIVE, "hive", '`', '`', '.',
+		ODBC_ESCAPE_BACKSLASH, false, true, false, true, false,
+		ODBC_LOCK_NONE, ODBC_LIMIT_LIMIT,
+		ODBC_SAMPLE_OFF, ODBC_ESTIMATOR_STATISTICS},
+	{ODBC_DIALECT_GENERIC, "generic", '"', '"', '.',
+		ODBC_ESCAPE_STANDARD, false, false, false, true, false,
+		ODBC_LOCK_NONE, ODBC_LIMIT_MAX_ROWS,
+		ODBC_SAMPLE_OFF, ODBC_ESTIMATOR_STATISTICS}
+};
+
+/*
+ * DBMS names reported by drivers, with the dialect each stands for.  Names
+ * are matched by prefix.
+ */
+static const struct
+{
+	const char *prefix;
+	OdbcDialectKind kind;
+}			dbms_names[] =
+{
+	{"PostgreSQL", ODBC_DIALECT_POSTGRESQL},
+	{"MySQL", ODBC_DIALECT_MYSQL},
+	{"MariaDB", ODBC_DIALECT_MYSQL},
+	{"Microsoft SQL Server", ODBC_DIALECT_SQLSERVER},
+	{"Oracle", ODBC_DIALECT_ORACLE},
+	{"DB2", ODBC_DIALECT_DB2},
+	{"Apache Hive", ODBC_DIALECT_HIVE},
+	{"Hive", ODBC_DIALECT_HIVE},
+	{"Spark SQL", ODBC_DIALECT_HIVE},
+	{NULL, ODBC_DIALECT_GENERIC}
+};
+
+/* Hash table of the dialects detected, by server OID */
+static HTAB *DialectCacheHash = NULL;
+
+typedef struct
+{
+	Oid			serverid;		/* hash key - must be first */
+	OdbcDialect dialect;
+} DialectCacheEntry;
+
+/* prototypes of private functions */
+static void InvalidateDialectCacheCallback(Datum arg, int cacheid,
+							   uint32 hashvalue);
+static char get_info_char(SQLHDBC dbc, SQLUSMALLINT info_type);
+static SQLUINTEGER get_info_mask(SQLHDBC dbc, SQLUSMALLINT info_type,
+			  SQLUINTEGER missing);
+
+/*
+ * Flush cache entries when pg_foreign_server is updated, since the dialect
+ * or the DSN of a server may have changed.
+ */
+static void
+InvalidateDialectCacheCallback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS status;
+	DialectCacheEntry *entry;
+
+	hash_seq_init(&status, DialectCacheHash);
+	while ((entry = (DialectCacheEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (hash_search(DialectCacheHash,
+						(void *) &entry->serverid,
+						HASH_REMOVE,
+						NULL) == NULL)
+			elog(ERROR, "hash table corrupted");
+	}
+}
+
+/*
+ * odbc_dialect
+ *		Map the value of the dialect option to the profile it stands for.
+ *
+ * Returns NULL for auto, which is also the default, as the dialect must
+ * then be detected.
+ */
+const OdbcDialect *
+odbc_dialect(const char *name)
+{
+	int			i;
+
+	if (name == NULL || strcmp(name, "auto") == 0)
+		return NULL;
+
+	for (i = ODBC_DIALECT_POSTGRESQL; i <= ODBC_DIALECT_GENERIC; i++)
+	{
+		if (strcmp(name, dialects[i].name) == 0)
+			return &dialects[i];
+	}
+
+	ereport(ERROR,
+	        (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+	         errmsg("invalid value for option dialect: \"%s\"", name),
+	         errhint("Valid values are: auto, postgresql, mysql, sqlserver, oracle, db2, hive, generic")
+	        ));
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * odbc_cached_dialect
+ *		Look up the dialect detected earlier for a server.
+ *
+ * Returns false if it has not been detected yet.
+ */
+bool
+odbc_cached_dialect(Oid serverid, OdbcDialect *dialect)
+{
+	DialectCacheEntry *entry;
+
+	if (DialectCacheHash == NULL)
+		return false;
+
+	entry = (DialectCacheEntry *) hash_search(DialectCacheHash,
+											  (void *) &serverid,
+											  HASH_FIND, NULL);
+	if (entry == NULL)
+		return false;
+
+	*dialect = entry->dialect;
+	return true;
+}
+
+/*
+ * odbc_detect_dialect
+ *		Work out the dialect of the server at the other end of dbc, and
+ *		cache it for the foreign server.
+ *
+ * Unless a profile is given, it is chosen by the DBMS name.  Drivers know
+ * better than the profile how identifiers are quoted, so a quote character
+ * reported by the driver is used instead; a space means identifiers cannot
+ * be quoted.  SQL Server keeps its brackets, which work whatever
+ * QUOTED_IDENTIFIER is.  A server without schemas, such as MySQL, has the
+ * schema option name a catalog, qualified with the catalog separator.
+ *
+ * The functions the driver supports are recorded in either case.  Drivers
+ * that cannot tell which aggregates they have are taken to have those of
+ * SQL-92.
+ */
+void
+odbc_detect_dialect(SQLHDBC dbc, Oid serverid, const OdbcDialect *profile,
+					OdbcDialect *dialect)
+{
+	DialectCacheEntry *entry;
+
+	if (profile != NULL)
+		*dialect = *profile;
+	else
+	{
+		SQLCHAR		dbms_name[256];
+		SQLUINTEGER schema_usage = 0;
+		OdbcDialectKind kind = ODBC_DIALECT_GENERIC;
+		char		c;
+
+		if (SQL_SUCCEEDED(SQLGetInfo(dbc, SQL_DBMS_NAME, (SQLPOINTER) dbms_name,
+									 sizeof(dbms_name), NULL)))
+		{
+			const char *name = (const char *) dbms_name;
+			int			i;
+
+			for (i = 0; dbms_names[i].prefix != NULL; i++)
+			{
+				if (pg_strncasecmp(name, dbms_names[i].prefix,
+								   strlen(dbms_names[i].prefix)) == 0)
+				{
+					kind = dbms_names[i].kind;
+					break;
+				}
+			}
+			elog(DEBUG1, "odbc_fdw: DBMS \"%s\" uses dialect %s",
+				 name, dialects[kind].name);
+		}
+
+		*dialect = dialects[kind];
+
+		c = get_info_char(dbc, SQL_IDENTIFIER_QUOTE_CHAR);
+		if (c == ' ')
+			dialect->quote_open = dialect->quote_close = '\0';
+		else if (c != '\0' && !(c == '"' && dialect->quote_open == '['))
+			dialect->quote_open = dialect->quote_close = c;
+
+		if (SQL_SUCCEEDED(SQLGetInfo(dbc, SQL_SCHEMA_USAGE,
+									 (SQLPOINTER) &schema_usage,
+									 sizeof(schema_usage), NULL)) &&
+			schema_usage == 0)
+		{
+			c = get_info_char(dbc, SQL_CATALOG_NAME_SEPARATOR);
+			if (c != '\0' && c != ' ')
+				dialect->name_separator = c;
+		}
+	}
+
+	dialect->string_functions = get_info_mask(dbc, SQL_STRING_FUNCTIONS, 0);
+	dialect->numeric_functions = get_info_mask(dbc, SQL_NUMERIC_FUNCTIONS, 0);
+	dialect->timedate_functions = get_info_mask(dbc, SQL_TIMEDATE_FUNCTIONS, 0);
+	dialect->convert_functions = get_info_mask(dbc, SQL_CONVERT_FUNCTIONS, 0);
+	dialect->aggregate_functions =
+		get_info_mask(dbc, SQL_AGGREGATE_FUNCTIONS,
+					  SQL_AF_ALL | SQL_AF_AVG | SQL_AF_COUNT | SQL_AF_DISTINCT |
+					  SQL_AF_MAX | SQL_AF_MIN | SQL_AF_SUM);
+
+	/* Initialize cache if first time through. */
+	if (DialectCacheHash == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(DialectCacheEntry);
+		DialectCacheHash = hash_create("odbc_fdw dialects", 16, &ctl,
+									   HASH_ELEM | HASH_BLOBS);
+
+		/* Set up invalidation callback on pg_foreign_server. */
+		CacheRegisterSyscacheCallback(FOREIGNSERVEROID,
+									  InvalidateDialectCacheCallback,
+									  (Datum) 0);
+	}
+
+	entry = (DialectCacheEntry *) hash_search(DialectCacheHash,
+											  (void *) &serverid,
+											  HASH_ENTER, NULL);
+	entry->dialect = *dialect;
+}
+
+/*
+ * Get a single-character string from SQLGetInfo.  Returns '\0' if the
+ * driver reports nothing, or more than a single character.
+ */
+static char
+get_info_char(SQLHDBC dbc, SQLUSMALLINT info_type)
+{
+	SQLCHAR		value[8];
+	SQLSMALLINT len = 0;
+
+	if (!SQL_SUCCEEDED(SQLGetInfo(dbc, info_type, (SQLPOINTER) value,
+								  sizeof(value), &len)) ||
+		len != 1)
+		return '\0';
+
+	return (char) value[0];
+}
+
+/*
+ * Get a bitmask from SQLGetInfo, or missing if the driver reports nothing.
+ */
+static SQLUINTEGER
+get_info_mask(SQLHDBC dbc, SQLUSMALLINT info_type, SQLUINTEGER missing)
+{
+	SQLUINTEGER value = 0;
+
+	if (!SQL_SUCCEEDED(SQLGetInfo(dbc, info_type, (SQLPOINTER) &value,
+								  sizeof(value), NULL)))
+		return missing;
+
+	return value;
+}
+
+/*
+ * odbc_quote_identifier
+ *		Quote an identifier for the remote server, if it needs quoting.
+ *
+ * Names that PostgreSQL would leave bare are left bare for every server,
+ * so that servers folding unquoted names to upper case still find them.
+ * Others are quoted with the quotes of the dialect, doubling any closing
+ * quote within.  Returns ident itself if it is not quoted.
+ */
+const char *
+odbc_quote_identifier(const char *ident, const OdbcDialect *dialect)
+{
+	StringInfoData buf;
+	const char *ptr;
+
+	if (quote_identifier(ident) == ident || dialect->quote_open == '\0')
+		return ident;
+
+	initStringInfo(&buf);
+	appendStringInfoChar(&buf, dialect->quote_open);
+	for (ptr = ident; *ptr; ptr++)
+	{
+		if (*ptr == dialect->quote_close)
+			appendStringInfoChar(&buf, *ptr);
+		appendStringInfoChar(&buf, *ptr);
+	}
+	appendStringInfoChar(&buf, dialect->quote_close);
+
+	return buf.data;
+}
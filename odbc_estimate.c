@@ -0,0 +1,612 @@
+/*-------------------------------------------------------------------------
+ *
+ * odbc_estimate.c
+ *		  Row and cost estimates obtained from the remote server
+ *
+ * With the use_remote_estimate option the planner asks the remote server
+ * how many rows a query will return instead of guessing from local
+ * statistics.  How it asks depends on the kind of server, set by the
+ * remote_estimator server option or else taken from its SQL dialect:
+ *
+ * postgresql	EXPLAIN, giving rows, width and costs
+ * mysql		EXPLAIN, giving the rows examined per table
+ * sqlserver	SET SHOWPLAN_ALL, giving rows and width
+ * statistics	the table cardinality reported by SQLStatistics()
+ *
+ * The first three estimate whole queries, including joins and aggregates
+ * pushed down; the last one only gives the size of a table, from which the
+ * planner works on with local estimates.
+ *
+ * A round trip per estimate would make planning slow, all the more as the
+ * same queries are planned again and again.  Estimates are therefore kept
+ * for a while in a backend-local cache keyed by the remote SQL, normalized
+ * so that differences in white space do not matter.  Failed estimates are
+ * remembered as well, so that a server that cannot explain a query is not
+ * asked again each time.
+ *
+ * Portions Copyright (c) 2012-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2017-2018, www.cstech.ltd
+ *
+ * IDENTIFICATION
+ *		  contrib/odbc_fdw/odbc_estimate.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <ctype.h>
+
+#include "odbc_fdw.h"
+
+#include "access/hash.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+
+/* Seconds a cached estimate is used before the server is asked again */
+#define ODBC_ESTIMATE_CACHE_TTL 600
+
+/* Number of cached estimates above which the cache is emptied */
+#define ODBC_ESTIMATE_CACHE_SIZE 1024
+
+/* Size of the buffer a line of EXPLAIN output is read into */
+#define ODBC_EXPLAIN_LINE_SIZE 8192
+
+/*
+ * Hash key for cached estimates.  The SQL itself is not part of the key,
+ * only its hash; the entry keeps the SQL to tell collisions apart.
+ */
+typedef struct
+{
+	/* XXX we assume this struct contains no padding bytes */
+	Oid			serverid;		/* FDW server the estimate came from */
+	OdbcEstimator estimator;	/* how it was obtained */
+	uint32		sqlhash;		/* hash of the normalized SQL */
+} EstimateCacheKey;
+
+typedef struct
+{
+	EstimateCacheKey key;		/* hash key - must be first */
+	char	   *sql;			/* normalized SQL, in EstimateCacheContext */
+	bool		valid;			/* false if the server gave no estimate */
+	OdbcRemoteEstimate estimate;
+	TimestampTz fetched;		/* when the estimate was obtained */
+} EstimateCacheEntry;
+
+/* Function obtaining an estimate of a query from the remote server */
+typedef bool (*ExplainFunc) (SQLHDBC dbc, const char *sql,
+							 OdbcRemoteEstimate *est);
+
+static HTAB *EstimateCacheHash = NULL;
+static MemoryContext EstimateCacheContext = NULL;
+
+/* prototypes of private functions */
+static bool explain_postgresql(SQLHDBC dbc, const char *sql,
+				   OdbcRemoteEstimate *est);
+static bool explain_mysql(SQLHDBC dbc, const char *sql,
+			  OdbcRemoteEstimate *est);
+static bool explain_sqlserver(SQLHDBC dbc, const char *sql,
+				  OdbcRemoteEstimate *est);
+static SQLSMALLINT find_result_column(SQLHSTMT stmt, const char *name);
+static bool get_double(SQLHSTMT stmt, SQLSMALLINT column, double *value);
+static char *normalize_sql(const char *sql);
+static EstimateCacheEntry *lookup_estimate(Oid serverid,
+				OdbcEstimator estimator, const char *sql);
+static void store_estimate(Oid serverid, OdbcEstimator estimator,
+			   const char *sql, bool valid, const OdbcRemoteEstimate *est);
+static void make_cache_key(EstimateCacheKey *key, Oid serverid,
+			   OdbcEstimator estimator, const char *normalized);
+static void InvalidateEstimateCacheCallback(Datum arg, int cacheid,
+								uint32 hashvalue);
+
+/*
+ * The EXPLAIN function of each estimator, indexed by OdbcEstimator.  The
+ * statistics estimator does not estimate queries.
+ */
+static const ExplainFunc explain_functions[] =
+{
+	NULL,						/* ODBC_ESTIMATOR_AUTO */
+	explain_postgresql,			/* ODBC_ESTIMATOR_POSTGRESQL */
+	explain_mysql,				/* ODBC_ESTIMATOR_MYSQL */
+	explain_sqlserver,			/* ODBC_ESTIMATOR_SQLSERVER */
+	NULL						/* ODBC_ESTIMATOR_STATISTICS */
+};
+
+/*
+ * Map the value of the remote_estimator option to the OdbcEstimator it
+ * stands for.  Without the option the estimator depends on the server.
+ */
+OdbcEstimator
+odbc_estimator(const char *name)
+{
+	if (name == NULL || strcmp(name, "auto") == 0)
+		return ODBC_ESTIMATOR_AUTO;
+	if (strcmp(name, "postgresql") == 0)
+		return ODBC_ESTIMATOR_POSTGRESQL;
+	if (strcmp(name, "mysql") == 0)
+		return ODBC_ESTIMATOR_MYSQL;
+	if (strcmp(name, "sqlserver") == 0)
+		return ODBC_ESTIMATOR_SQLSERVER;
+	if (strcmp(name, "statistics") == 0)
+		return ODBC_ESTIMATOR_STATISTICS;
+
+	ereport(ERROR,
+	        (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+	         errmsg("invalid value for option remote_estimator: \"%s\"", name),
+	         errhint("Valid values are: auto, postgresql, mysql, sqlserver, statistics")
+	        ));
+	return ODBC_ESTIMATOR_STATISTICS;	/* keep compiler quiet */
+}
+
+/*
+ * odbc_get_remote_estimate
+ *		Have the server at the other end of dbc estimate the given query.
+ *
+ * A width of zero and negative costs in *est mean the estimator does not
+ * know them.  Returns false if the server gives no estimate.
+ */
+bool
+odbc_get_remote_estimate(SQLHDBC dbc, Oid serverid, OdbcEstimator estimator,
+						 const char *sql, OdbcRemoteEstimate *est)
+{
+	EstimateCacheEntry *entry;
+	OdbcRemoteEstimate remote;
+	bool		valid;
+
+	Assert(estimator >= ODBC_ESTIMATOR_AUTO &&
+		   estimator <= ODBC_ESTIMATOR_STATISTICS);
+	if (explain_functions[estimator] == NULL)
+		return false;
+
+	entry = lookup_estimate(serverid, estimator, sql);
+	if (entry != NULL)
+	{
+		*est = entry->estimate;
+		return entry->valid;
+	}
+
+	remote.rows = 0;
+	remote.width = 0;
+	remote.startup_cost = -1;
+	remote.total_cost = -1;
+	valid = explain_functions[estimator] (dbc, sql, &remote);
+	elog(DEBUG1, "remote estimate: %s rows=%.0f width=%d for %s",
+		 valid ? "found" : "none", remote.rows, remote.width, sql);
+
+	store_estimate(serverid, estimator, sql, valid, &remote);
+
+	*est = remote;
+	return valid;
+}
+
+/*
+ * odbc_get_remote_cardinality
+ *		Number of rows in the given remote table, as reported by
+ *		SQLStatistics().
+ *
+ * The driver is asked for accurate figures (SQL_ENSURE), though many return
+ * what they have anyway.  Returns -1 if the server gives no cardinality.
+ */
+double
+odbc_get_remote_cardinality(SQLHDBC dbc, Oid serverid, const char *schema,
+							const char *table)
+{
+	EstimateCacheEntry *entry;
+	OdbcRemoteEstimate remote;
+	StringInfoData name;
+	SQLHSTMT	stmt;
+	SQLRETURN	ret;
+	double		cardinality = -1;
+
+	/* The cache key is the qualified name of the table */
+	initStringInfo(&name);
+	appendStringInfo(&name, "%s.%s", schema ? schema : "", table);
+
+	entry = lookup_estimate(serverid, ODBC_ESTIMATOR_STATISTICS, name.data);
+	if (entry != NULL)
+	{
+		pfree(name.data);
+		return entry->valid ? entry->estimate.rows : -1;
+	}
+
+	if (SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt)))
+	{
+		ret = SQLStatistics(stmt, NULL, 0,
+							(SQLCHAR *) schema, schema ? SQL_NTS : 0,
+							(SQLCHAR *) table, SQL_NTS,
+							SQL_INDEX_ALL, SQL_ENSURE);
+
+		/* Look for the row describing the table itself */
+		while (SQL_SUCCEEDED(ret) && SQL_SUCCEEDED(ret = SQLFetch(stmt)))
+		{
+			SQLSMALLINT type;
+			SQLLEN		indicator;
+
+			if (SQL_SUCCEEDED(SQLGetData(stmt, 7, SQL_C_SSHORT, &type, 0,
+										 &indicator)) &&
+				indicator != SQL_NULL_DATA && type == SQL_TABLE_STAT)
+			{
+				if (!get_double(stmt, 11, &cardinality))
+					cardinality = -1;
+				break;
+			}
+		}
+		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+	}
+
+	elog(DEBUG1, "remote cardinality of %s: %.0f", name.data, cardinality);
+
+	remote.rows = cardinality;
+	remote.width = 0;
+	remote.startup_cost = -1;
+	remote.total_cost = -1;
+	store_estimate(serverid, ODBC_ESTIMATOR_STATISTICS, name.data,
+				   cardinality >= 0, &remote);
+	pfree(name.data);
+
+	return cardinality;
+}
+
+/*
+ * explain_postgresql
+ *		Estimate a query on PostgreSQL: the top line of its EXPLAIN output
+ *		gives rows, width and costs, as for postgres_fdw.
+ */
+static bool
+explain_postgresql(SQLHDBC dbc, const char *sql, OdbcRemoteEstimate *est)
+{
+	StringInfoData query;
+	SQLHSTMT	stmt;
+	SQLLEN		indicator;
+	char	   *line;
+	bool		found = false;
+
+	if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt)))
+		return false;
+
+	initStringInfo(&query);
+	appendStringInfo(&query, "EXPLAIN %s", sql);
+	line = palloc(ODBC_EXPLAIN_LINE_SIZE);
+
+	if (SQL_SUCCEEDED(SQLExecDirect(stmt, (SQLCHAR *) query.data, SQL_NTS)) &&
+		SQL_SUCCEEDED(SQLFetch(stmt)) &&
+		SQL_SUCCEEDED(SQLGetData(stmt, 1, SQL_C_CHAR, line,
+								 ODBC_EXPLAIN_LINE_SIZE, &indicator)) &&
+		indicator != SQL_NULL_DATA)
+	{
+		char	   *p = strrchr(line, '(');
+
+		found = (p != NULL &&
+				 sscanf(p, "(cost=%lf..%lf rows=%lf width=%d)",
+						&est->startup_cost, &est->total_cost,
+						&est->rows, &est->width) == 4);
+	}
+
+	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+	pfree(line);
+	pfree(query.data);
+
+	return found;
+}
+
+/*
+ * explain_mysql
+ *		Estimate a query on MySQL or MariaDB.
+ *
+ * EXPLAIN gives a row per table read, with the number of rows examined and,
+ * in the filtered column, the percentage of them expected to be kept.  The
+ * tables of the outermost SELECT are joined by nested loops, so the rows
+ * returned are the product of the rows kept from each of them.  The costs
+ * are not shown.
+ */
+static bool
+explain_mysql(SQLHDBC dbc, const char *sql, OdbcRemoteEstimate *est)
+{
+	StringInfoData query;
+	SQLHSTMT	stmt;
+	SQLSMALLINT id_col;
+	SQLSMALLINT rows_col;
+	SQLSMALLINT filtered_col;
+	double		first_id = -1;
+	double		rows = 1;
+	bool		found = false;
+
+	if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt)))
+		return false;
+
+	initStringInfo(&query);
+	appendStringInfo(&query, "EXPLAIN %s", sql);
+
+	if (SQL_SUCCEEDED(SQLExecDirect(stmt, (SQLCHAR *) query.data, SQL_NTS)) &&
+		(id_col = find_result_column(stmt, "id")) > 0 &&
+		(rows_col = find_result_column(stmt, "rows")) > id_col)
+	{
+		/* Servers before MySQL 5.7 show no filtered column by default */
+		filtered_col = find_result_column(stmt, "filtered");
+
+		/* Columns are read in the order the result has them */
+		while (SQL_SUCCEEDED(SQLFetch(stmt)))
+		{
+			double		id;
+			double		examined;
+			double		filtered;
+
+			if (!get_double(stmt, id_col, &id))
+				continue;
+			if (first_id < 0)
+				first_id = id;
+			else if (id != first_id)
+				continue;
+
+			if (!get_double(stmt, rows_col, &examined))
+				continue;
+			if (filtered_col <= rows_col ||
+				!get_double(stmt, filtered_col, &filtered))
+				filtered = 100;
+
+			rows *= examined * filtered / 100;
+			found = true;
+		}
+	}
+
+	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+	pfree(query.data);
+
+	if (found)
+		est->rows = rows;
+	return found;
+}
+
+/*
+ * explain_sqlserver
+ *		Estimate a query on Microsoft SQL Server.
+ *
+ * With SHOWPLAN_ALL on, the server returns the plan of a query instead of
+ * running it, a row per plan node with the statement first.  The costs in
+ * it are in units of their own, so only the rows and the width are used.
+ */
+static bool
+explain_sqlserver(SQLHDBC dbc, const char *sql, OdbcRemoteEstimate *est)
+{
+	SQLHSTMT	stmt;
+	SQLSMALLINT rows_col;
+	SQLSMALLINT width_col;
+	double		rows = -1;
+	double		width = -1;
+
+	if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt)))
+		return false;
+
+	if (!SQL_SUCCEEDED(SQLExecDirect(stmt, (SQLCHAR *) "SET SHOWPLAN_ALL ON",
+									 SQL_NTS)))
+	{
+		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+		return false;
+	}
+	SQLCloseCursor(stmt);
+
+	if (SQL_SUCCEEDED(SQLExecDirect(stmt, (SQLCHAR *) sql, SQL_NTS)) &&
+		(rows_col = find_result_column(stmt, "EstimateRows")) > 0 &&
+		(width_col = find_result_column(stmt, "AvgRowSize")) > rows_col)
+	{
+		/* Take the first node that has each figure */
+		while ((rows < 0 || width < 0) && SQL_SUCCEEDED(SQLFetch(stmt)))
+		{
+			double		value;
+
+			if (rows < 0 && get_double(stmt, rows_col, &value))
+				rows = value;
+			if (width < 0 && get_double(stmt, width_col, &value))
+				width = value;
+		}
+	}
+	SQLCloseCursor(stmt);
+
+	/* The connection is cached, so it must be left as it was found */
+	SQLExecDirect(stmt, (SQLCHAR *) "SET SHOWPLAN_ALL OFF", SQL_NTS);
+	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+
+	if (rows < 0)
+		return false;
+	est->rows = rows;
+	est->width = (width > 0) ? (int) width : 0;
+	return true;
+}
+
+/*
+ * Position of the result column of the given name, or 0 if there is none.
+ */
+static SQLSMALLINT
+find_result_column(SQLHSTMT stmt, const char *name)
+{
+	SQLSMALLINT ncols;
+	SQLSMALLINT i;
+
+	if (!SQL_SUCCEEDED(SQLNumResultCols(stmt, &ncols)))
+		return 0;
+
+	for (i = 1; i <= ncols; i++)
+	{
+		SQLCHAR		label[128];
+		SQLSMALLINT len;
+
+		if (SQL_SUCCEEDED(SQLColAttribute(stmt, i, SQL_DESC_LABEL,
+										  label, sizeof(label), &len, NULL)) &&
+			pg_strcasecmp((char *) label, name) == 0)
+			return i;
+	}
+	return 0;
+}
+
+/*
+ * Read a column of the current row as a double.  Returns false if it is
+ * NULL or cannot be read.
+ */
+static bool
+get_double(SQLHSTMT stmt, SQLSMALLINT column, double *value)
+{
+	SQLLEN		indicator;
+
+	return SQL_SUCCEEDED(SQLGetData(stmt, column, SQL_C_DOUBLE, value, 0,
+									&indicator)) &&
+		indicator != SQL_NULL_DATA;
+}
+
+/*
+ * Copy of sql with runs of white space outside quotes made into a single
+ * space, and none at either end.
+ */
+static char *
+normalize_sql(const char *sql)
+{
+	StringInfoData buf;
+	const char *p;
+	char		quote = '\0';
+	bool		space = false;
+
+	initStringInfo(&buf);
+	for (p = sql; *p; p++)
+	{
+		if (quote == '\0' && isspace((unsigned char) *p))
+		{
+			space = true;
+			continue;
+		}
+
+		if (space && buf.len > 0)
+			appendStringInfoChar(&buf, ' ');
+		space = false;
+
+		if (quote != '\0')
+		{
+			if (*p == quote)
+				quote = '\0';
+		}
+		else if (*p == '\'' || *p == '"')
+			quote = *p;
+
+		appendStringInfoChar(&buf, *p);
+	}
+
+	return buf.data;
+}
+
+/*
+ * lookup_estimate
+ *		Find the cached estimate of sql, or NULL if there is none that is
+ *		recent enough.
+ */
+static EstimateCacheEntry *
+lookup_estimate(Oid serverid, OdbcEstimator estimator, const char *sql)
+{
+	EstimateCacheKey key;
+	EstimateCacheEntry *entry;
+	char	   *normalized;
+
+	if (EstimateCacheHash == NULL)
+		return NULL;
+
+	normalized = normalize_sql(sql);
+	make_cache_key(&key, serverid, estimator, normalized);
+
+	entry = (EstimateCacheEntry *) hash_search(EstimateCacheHash, &key,
+											   HASH_FIND, NULL);
+	if (entry != NULL &&
+		(strcmp(entry->sql, normalized) != 0 ||
+		 TimestampDifferenceExceeds(entry->fetched, GetCurrentTimestamp(),
+									ODBC_ESTIMATE_CACHE_TTL * 1000)))
+		entry = NULL;
+
+	pfree(normalized);
+	return entry;
+}
+
+/*
+ * store_estimate
+ *		Cache the estimate of sql; valid is false if there is none.
+ */
+static void
+store_estimate(Oid serverid, OdbcEstimator estimator, const char *sql,
+			   bool valid, const OdbcRemoteEstimate *est)
+{
+	EstimateCacheKey key;
+	EstimateCacheEntry *entry;
+	char	   *normalized;
+	bool		exists;
+
+	/* Initialize cache if first time through. */
+	if (EstimateCacheContext == NULL)
+	{
+		EstimateCacheContext =
+			AllocSetContextCreate(CacheMemoryContext,
+								  "odbc_fdw remote estimates",
+								  ALLOCSET_DEFAULT_SIZES);
+
+		/* Set up invalidation callback on pg_foreign_server. */
+		CacheRegisterSyscacheCallback(FOREIGNSERVEROID,
+									  InvalidateEstimateCacheCallback,
+									  (Datum) 0);
+	}
+
+	/* Estimates of many different queries are not kept forever */
+	if (EstimateCacheHash != NULL &&
+		hash_get_num_entries(EstimateCacheHash) >= ODBC_ESTIMATE_CACHE_SIZE)
+		InvalidateEstimateCacheCallback((Datum) 0, FOREIGNSERVEROID, 0);
+
+	if (EstimateCacheHash == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(EstimateCacheKey);
+		ctl.entrysize = sizeof(EstimateCacheEntry);
+		ctl.hcxt = EstimateCacheContext;
+		EstimateCacheHash = hash_create("odbc_fdw remote estimates", 256, &ctl,
+										HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	normalized = normalize_sql(sql);
+	make_cache_key(&key, serverid, estimator, normalized);
+
+	entry = (EstimateCacheEntry *) hash_search(EstimateCacheHash, &key,
+											   HASH_ENTER, &exists);
+	if (exists)
+		pfree(entry->sql);
+	entry->sql = MemoryContextStrdup(EstimateCacheContext, normalized);
+	entry->valid = valid;
+	entry->estimate = *est;
+	entry->fetched = GetCurrentTimestamp();
+
+	pfree(normalized);
+}
+
+/*
+ * Fill in the cache key of a normalized SQL string.
+ */
+static void
+make_cache_key(EstimateCacheKey *key, Oid serverid, OdbcEstimator estimator,
+			   const char *normalized)
+{
+	key->serverid = serverid;
+	key->estimator = estimator;
+	key->sqlhash = DatumGetUInt32(hash_any((const unsigned char *) normalized,
+										   strlen(normalized)));
+}
+
+/*
+ * Flush all cached estimates when pg_foreign_server is updated, since
+ * ALTER SERVER may have pointed the server somewhere else or changed its
+ * remote_estimator.  Also used to empty the cache when it grows too big.
+ */
+static void
+InvalidateEstimateCacheCallback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	if (EstimateCacheHash == NULL)
+		return;
+
+	/* The hash table lives in EstimateCacheContext as well */
+	EstimateCacheHash = NULL;
+	MemoryContextReset(EstimateCacheContext);
+}
@@ -0,0 +1,48 @@
+/*-------------------------------------------------------------------------
+ *
+ *                foreign-data wrapper for ODBC
+ *
+ * Copyright (c) 2011, PostgreSQL Global Development Group
+ * Copyright (c) 2016, 2017, 2018, CARTO
+ *
+ * This software is released under the PostgreSQL Licence
+ *
+ * Original author: Zheng Yang <zhengyang4k@gmail.com>
+ *
+ * IDENTIFICATION
+ *                odbc_fdw/odbc_fdw--0.3.0--0.4.0.sql
+ *
+ *-------------------------------------------------------------------------
+ */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION odbc_fdw UPDATE TO '0.4.0'" to load this file. \quit
+
+CREATE FUNCTION odbc_fdw_get_connections (OUT server_name text,
+    OUT valid boolean)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT PARALLEL RESTRICTED;
+
+CREATE FUNCTION odbc_fdw_disconnect (text)
+RETURNS bool
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT PARALLEL RESTRICTED;
+
+CREATE FUNCTION odbc_fdw_disconnect_all ()
+RETURNS bool
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT PARALLEL RESTRICTED;
+
+CREATE TABLE odbc_fdw_stats (
+    ftrelid oid PRIMARY KEY,
+    row_count float8 NOT NULL,
+    avg_width integer NOT NULL,
+    refreshed_at timestamptz NOT NULL
+);
+GRANT SELECT ON odbc_fdw_stats TO PUBLIC;
+
+CREATE FUNCTION odbc_fdw_refresh_stats (regclass)
+RETURNS bigint
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
@@ -0,0 +1,73 @@
+/*-------------------------------------------------------------------------
+ *
+ *                foreign-data wrapper for ODBC
+ *
+ * Copyright (c) 2011, PostgreSQL Global Development Group
+ * Copyright (c) 2016, 2017, 2018, CARTO
+ *
+ * This software is released under the PostgreSQL Licence
+ *
+ * Original author: Zheng Yang <zhengyang4k@gmail.com>
+ *
+ * IDENTIFICATION
+ *                odbc_fdw/odbc_fdw--0.4.0.sql
+ *
+ *-------------------------------------------------------------------------
+ */
+
+CREATE FUNCTION odbc_fdw_handler()
+RETURNS fdw_handler
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_fdw_validator(text[], oid)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FOREIGN DATA WRAPPER odbc_fdw
+  HANDLER odbc_fdw_handler
+  VALIDATOR odbc_fdw_validator;
+
+CREATE TYPE __tabledata AS (schema text, name text);
+
+CREATE FUNCTION ODBCTablesList(text, integer DEFAULT 0) RETURNS SETOF __tabledata
+AS 'MODULE_PATHNAME', 'odbc_tables_list'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION ODBCTableSize(text, text) RETURNS INTEGER
+AS 'MODULE_PATHNAME', 'odbc_table_size'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION ODBCQuerySize(text, text) RETURNS INTEGER
+AS 'MODULE_PATHNAME', 'odbc_query_size'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION odbc_fdw_get_connections (OUT server_name text,
+    OUT valid boolean)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT PARALLEL RESTRICTED;
+
+CREATE FUNCTION odbc_fdw_disconnect (text)
+RETURNS bool
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT PARALLEL RESTRICTED;
+
+CREATE FUNCTION odbc_fdw_disconnect_all ()
+RETURNS bool
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT PARALLEL RESTRICTED;
+
+CREATE TABLE odbc_fdw_stats (
+    ftrelid oid PRIMARY KEY,
+    row_count float8 NOT NULL,
+    avg_width integer NOT NULL,
+    refreshed_at timestamptz NOT NULL
+);
+GRANT SELECT ON odbc_fdw_stats TO PUBLIC;
+
+CREATE FUNCTION odbc_fdw_refresh_stats (regclass)
+RETURNS bigint
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
@@ -20,6 +20,7 @@
 
 #include <string.h>
 #include "funcapi.h"
+#include "access/hash.h"
 #include "access/htup_details.h"
 #include "access/sysattr.h"
 #include "access/reloptions.h"
@@ -29,6 +30,7 @@
 #include "catalog/pg_type.h"
 #include "commands/defrem.h"
 #include "commands/explain.h"
+#include "commands/vacuum.h"
 #include "foreign/fdwapi.h"
 #include "foreign/foreign.h"
 #include "utils/memutils.h"
@@ -45,8 +47,15 @@
 #include "utils/guc.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/sampling.h"
 #include "utils/selfuncs.h"
+#include "utils/tuplestore.h"
+#include "utils/date.h"
+#include "utils/datetime.h"
+#include "utils/timestamp.h"
+#include "utils/uuid.h"
 #include "nodes/nodes.h"
+#include "nodes/nodeFuncs.h"
 #include "nodes/makefuncs.h"
 #include "nodes/pg_list.h"
 #include "nodes/relation.h"
@@ -55,13 +64,17 @@
 #include "optimizer/clauses.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
+#include "optimizer/plancat.h"
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
 #include "optimizer/var.h"
 #include "optimizer/tlist.h"
+#include "parser/parse_agg.h"
+#include "executor/executor.h"
 #include "executor/spi.h"
 
 #include <stdio.h>
+#include <math.h>
 #include <sql.h>
 #include <sqlext.h>
 
@@ -98,6 +111,15 @@ PG_MODULE_MAGIC;
 /* Default remote table size */
 #define DEFAULT_TABLE_SIZE 1000000
 
+/* Default number of rows fetched from the remote server per round trip */
+#define DEFAULT_FETCH_SIZE 100
+
+/*
+ * Upper bound on the length of a batched INSERT statement, for drivers that
+ * report no limit of their own (SQL_MAX_STATEMENT_LEN).
+ */
+#define ODBC_MAX_BATCH_SQL_LEN (16 * 1024 * 1024)
+
 /*
  * Numbers of the columns returned by SQLTables:
  * 1: TABLE_CAT (ODBC 3.0) TABLE_QUALIFIER (ODBC 2.0) -- database name
@@ -110,6 +132,12 @@ PG_MODULE_MAGIC;
 #define SQLTABLES_NAME_COLUMN 3
 
 #define ODBC_SQLSTATE_FRACTIONAL_TRUNCATION "01S07"
+
+/*
+ * Upper bound of bytes per character in SQL_C_CHAR data; used to size
+ * bound buffers of character columns, whose size is given in characters.
+ */
+#define ODBC_MAX_BYTES_PER_CHAR 4
 typedef struct odbcFdwOptions
 {
 	char  *schema;     /* Foreign schema name */
@@ -119,11 +147,96 @@ typedef struct odbcFdwOptions
 	char  *sql_count;  /* SQL query for counting results */
 	char  *encoding;   /* Character encoding name */
 	bool  updatable;   /* table can be update */
+	int   fetch_size;  /* Rows per SQLFetch (0 if not set) */
+	int   batch_size;  /* Rows per INSERT statement (0 if not set) */
+	char  *limit_syntax; /* How the server takes a LIMIT (NULL if not set) */
+	bool  grouping_sets; /* server supports GROUPING SETS, ROLLUP, CUBE */
+	char  *analyze_sampling; /* How ANALYZE samples (NULL if not set) */
+	int   stats_ttl;   /* Seconds a cached row count is used (-1 if not set) */
+	int   use_remote_estimate; /* Ask the server for estimates (-1 if not set) */
+	char  *remote_estimator; /* How to ask it (NULL if not set) */
+	char  *dialect;    /* SQL dialect of the server (NULL if not set) */
+	Oid   serverid;    /* Foreign server the options came from */
+	Oid   umid;        /* User mapping the options came from */
 	List *connection_list; /* ODBC connection attributes */
 
 	List  *mapping_list; /* Column name mapping */
 } odbcFdwOptions;
 
+struct odbcFdwExecutionState;
+struct odbcScanColumn;
+
+/*
+ * Builds the Datum of a non-null column value.  value points to the
+ * value in the rowset buffer (or to the SQLGetData result): the raw C
+ * value for native types, a zero-terminated string otherwise.
+ */
+typedef Datum (*odbcColumnDecoder) (struct odbcFdwExecutionState *festate,
+									struct odbcScanColumn *col,
+									char *value);
+
+/*
+ * Retrieval information of a result column of a foreign scan, set up once
+ * in odbcBeginForeignScan.
+ */
+typedef struct odbcScanColumn
+{
+	SQLUSMALLINT    ordinal;        /* ODBC column number (1-based) */
+	int             attnum;         /* target attribute number */
+	SQLSMALLINT     ctype;          /* C type the column is retrieved as */
+	bool            bound;          /* bound with SQLBindCol, else SQLGetData */
+	size_t          offset;         /* start of the values in rowset_buffer */
+	int             length;         /* bytes per value (buffer length) */
+	odbcColumnDecoder decode;       /* builds the Datum of a value */
+
+	/* input function of the target attribute, for text values */
+	FmgrInfo        *infunc;
+	Oid             ioparam;
+	int32           typmod;
+} odbcScanColumn;
+
+/*
+ * One parameter of a remote statement: a target column of a prepared INSERT,
+ * or a runtime parameter of a remote query.  It is bound once to a
+ * column-wise array holding its value for each row of a batch.  Values are
+ * stored in their native ODBC C type where there is one; other types are
+ * sent as text.  Variable-length values are kept in fixed-width slots, which
+ * are widened (and the parameter rebound) when a longer value comes along.
+ */
+typedef struct odbcParamColumn
+{
+	SQLUSMALLINT number;		/* parameter number (1-based) */
+	Oid			atttypid;		/* type of the local value */
+	SQLSMALLINT ctype;			/* C type of the buffered values */
+	SQLSMALLINT sqltype;		/* SQL type of the parameter */
+	bool		fixed;			/* fixed-width value, never widened */
+	SQLULEN		column_size;	/* of a fixed-width parameter */
+	SQLSMALLINT decimal_digits; /* of a fixed-width parameter */
+	Datum		scale_factor;	/* numeric: 10^decimal_digits */
+	SQLLEN		width;			/* bytes per row in values */
+	char	   *values;			/* batch_size * width bytes */
+	SQLLEN	   *indicators;		/* length or SQL_NULL_DATA, per row */
+	int			nrows;			/* rows values and indicators hold */
+	FmgrInfo   *flinfo;			/* output function, for values sent as text */
+} odbcParamColumn;
+
+/*
+ * The rows a parameterized scan returned for one set of parameter values.
+ * The key is the values as bound to the statement, indicators included.
+ */
+typedef struct odbcKeyCacheKey
+{
+	char		   *data;
+	int				len;
+} odbcKeyCacheKey;
+
+typedef struct odbcKeyCacheEntry
+{
+	odbcKeyCacheKey key;		/* hash key - must be first */
+	List		   *rows;		/* MinimalTuples, in the order returned */
+	bool			complete;	/* rows holds the whole result */
+} odbcKeyCacheEntry;
+
 /**
  * ODBC Execution state of a foreign scan 
  */
@@ -138,12 +251,54 @@ typedef struct odbcFdwExecutionState
 	SQLHSTMT        stmt;
 	SQLHDBC			conn;
 	int             num_of_result_cols;
-	bool            first_iteration;
-	List            *col_position_mask;
-	List            *col_size_array;
-	List            *col_conversion_array;
 	char            *sql_count;
 	int             encoding;
+
+	/* rowset (block cursor) state */
+	SQLUINTEGER     getdata_ext;    /* SQL_GETDATA_EXTENSIONS of the driver */
+	SQLULEN         rowset_size;    /* rows requested per SQLFetch */
+	SQLULEN         rows_fetched;   /* rows delivered by the last SQLFetch */
+	SQLULEN         next_row;       /* index of next row to return */
+	SQLULEN         current_row;    /* index of the row being returned */
+	SQLUSMALLINT    *row_status;    /* per-row status array of the rowset */
+	bool            eof_reached;    /* true if the last fetch hit the end */
+	int64           max_rows;       /* pushed-down LIMIT, or 0 */
+	int64           rows_returned;  /* rows returned from this execution */
+
+	/* retrieved columns and their column-wise bound buffers */
+	odbcScanColumn  *columns;
+	int             num_columns;
+	bool            has_unbound_cols;
+	char            *rowset_buffer; /* values of all bound columns */
+	SQLLEN          *indicators;    /* rowset_size indicators per column */
+
+	/* per-row work space, allocated once per scan */
+	StringInfoData  col_data;       /* text of hex converted values */
+	MemoryContext   temp_cxt;       /* context for per-tuple temporary data */
+
+	/* parameters of the remote query */
+	char            *query;         /* remote query, for re-execution */
+	int             numParams;      /* number of parameters of the query */
+	List            *param_exprs;   /* executable expressions for them */
+	odbcParamColumn *params;        /* their bound values */
+	bool            has_text_params;    /* any parameter sent as text? */
+	bool            query_sent;     /* query executed for the current scan? */
+
+	/* rescan support */
+	MemoryContext   query_cxt;      /* context the spool lives in */
+	Tuplestorestate *spool;         /* rows of the current execution */
+	bool            spool_complete; /* spool holds the whole result */
+	bool            spool_disabled; /* result too big to spool */
+	bool            replaying;      /* rows come from the spool */
+
+	/* results of a parameterized scan, by parameter values */
+	HTAB            *key_cache;     /* odbcKeyCacheEntry's, or NULL */
+	MemoryContext   key_cache_cxt;  /* holds key_cache and its rows */
+	Size            key_cache_size; /* bytes of cached keys and rows */
+	StringInfoData  key_buf;        /* key of the current parameters */
+	odbcKeyCacheEntry *key_entry;   /* entry filled by this execution */
+	ListCell        *key_next;      /* next cached row to return */
+	bool            key_replaying;  /* rows come from key_cache */
 } odbcFdwExecutionState;
 
 /*
@@ -158,6 +313,7 @@ typedef struct odbcFdwModifyState
 	odbcFdwOptions  options;
 	SQLHSTMT        stmt;
 	SQLHDBC			conn;
+	OdbcDialect		dialect;	/* SQL dialect of the server */
 
 	bool			prepared; 
 	/* extracted fdw_private data */
@@ -166,6 +322,22 @@ typedef struct odbcFdwModifyState
 	bool		has_returning;	/* is there a RETURNING clause? */
 	List	   *retrieved_attrs;	/* attr numbers retrieved by RETURNING */
 
+	/* batched INSERT */
+	int			batch_size;		/* rows per INSERT statement */
+	int			num_buffered;	/* rows in batch_sql not yet sent */
+	StringInfoData batch_sql;	/* query, followed by the buffered rows */
+	int			query_len;		/* length of the query in batch_sql */
+	SQLULEN		max_sql_len;	/* flush before batch_sql exceeds this */
+	StringInfoData row_sql;		/* VALUES list of the current row */
+
+	/* parameter arrays of the prepared INSERT */
+	odbcParamColumn *params;	/* one per target column */
+	SQLULEN		paramset_size;	/* current SQL_ATTR_PARAMSET_SIZE */
+	SQLULEN		params_processed;	/* rows processed by SQLExecute */
+	SQLUSMALLINT *param_status; /* per-row status of the last SQLExecute */
+	int			failed_row;		/* first failed row, for error context */
+	bool		has_text_params;	/* any parameter sent as text? */
+
 	/* info about parameters for prepared statement */
 	int			p_nums;			/* number of parameters to transmit */
 	FmgrInfo   *p_flinfo;		/* output conversion functions for them */
@@ -195,9 +367,9 @@ typedef struct odbcFdwDirectModifyState
 	/* for remote query execution */
 	SQLHSTMT    stmt;			/* connection for the update */
 	int			numParams;		/* number of parameters passed to query */
-	FmgrInfo   *param_flinfo;	/* output conversion functions for them */
 	List	   *param_exprs;	/* executable expressions for param values */
-	const char **param_values;	/* textual values of query parameters */
+	odbcParamColumn *params;	/* their bound values */
+	bool		has_text_params;	/* any parameter sent as text? */
 
 	/* for storing result tuples */
 	int			num_tuples;		/* # of result tuples */
@@ -230,6 +402,15 @@ static struct odbcFdwOption valid_options[] =
 	{ "driver",     ForeignServerRelationId },
 	{ "encoding",   ForeignServerRelationId },
 	{ "updatable", 	ForeignServerRelationId },
+	{ "fetch_size", ForeignServerRelationId },
+	{ "batch_size", ForeignServerRelationId },
+	{ "limit_syntax", ForeignServerRelationId },
+	{ "grouping_sets", ForeignServerRelationId },
+	{ "analyze_sampling", ForeignServerRelationId },
+	{ "stats_ttl",  ForeignServerRelationId },
+	{ "use_remote_estimate", ForeignServerRelationId },
+	{ "remote_estimator", ForeignServerRelationId },
+	{ "dialect",    ForeignServerRelationId },
 
 	/* Foreign table options */
 	{ "schema",     ForeignTableRelationId },
@@ -238,11 +419,18 @@ static struct odbcFdwOption valid_options[] =
 	{ "sql_query",  ForeignTableRelationId },
 	{ "sql_count",  ForeignTableRelationId },
 	{ "updatable", 	ForeignTableRelationId },
+	{ "fetch_size", ForeignTableRelationId },
+	{ "batch_size", ForeignTableRelationId },
+	{ "analyze_sampling", ForeignTableRelationId },
+	{ "stats_ttl",  ForeignTableRelationId },
+	{ "use_remote_estimate", ForeignTableRelationId },
+
+	/* Foreign table column options */
+	{ "indexed",    AttributeRelationId },
 
 	/* Sentinel */
 	{ NULL,       InvalidOid}
 };
-static SQLHENV odbc_env = NULL;
 
 enum FdwScanPrivateIndex
 {
@@ -252,6 +440,8 @@ enum FdwScanPrivateIndex
 	FdwScanPrivateRetrievedAttrs,
 	/* Integer representing the desired fetch_size */
 	FdwScanPrivateFetchSize,
+	/* Integer row limit to set as SQL_ATTR_MAX_ROWS, or 0 */
+	FdwScanPrivateMaxRows,
 
 	/*
 	 * String describing join i.e. names of relations being joined and types
@@ -260,6 +450,16 @@ enum FdwScanPrivateIndex
 	FdwScanPrivateRelations
 };
 
+/*
+ * This enum describes what's kept in the fdw_private list for a ForeignPath
+ * that performs the query's LIMIT remotely.
+ */
+enum FdwPathPrivateIndex
+{
+	/* has-limit flag (as an integer Value node) */
+	FdwPathPrivateHasLimit
+};
+
 enum FdwModifyPrivateIndex
 {
 	/* SQL statement to execute remotely (as a String node) */
@@ -269,7 +469,9 @@ enum FdwModifyPrivateIndex
 	/* has-returning flag (as an integer Value node) */
 	FdwModifyPrivateHasReturning,
 	/* Integer list of attribute numbers retrieved by RETURNING */
-	FdwModifyPrivateRetrievedAttrs
+	FdwModifyPrivateRetrievedAttrs,
+	/* Number of rows to send per INSERT statement (as an integer Value node) */
+	FdwModifyPrivateBatchSize
 };
 
 enum FdwDirectModifyPrivateIndex
@@ -284,14 +486,6 @@ enum FdwDirectModifyPrivateIndex
 	FdwDirectModifyPrivateSetProcessed
 };
 
-typedef enum 
-{ 
-	TEXT_CONVERSION, 
-	HEX_CONVERSION,
-	BIN_CONVERSION, 
-	BOOL_CONVERSION 
-} ColumnConversion;
-
 /*
  * SQL functions
  */
@@ -322,6 +516,9 @@ static void odbcGetForeignRelSize(PlannerInfo *root,
 static void odbcGetForeignPaths(PlannerInfo *root,
 								RelOptInfo *baserel,
 								Oid foreigntableid);
+static bool odbcAnalyzeForeignTable(Relation relation,
+									AcquireSampleRowsFunc *func,
+									BlockNumber *totalpages);
 
 static ForeignScan* odbcGetForeignPlan(PlannerInfo *root,
 										RelOptInfo *baserel,
@@ -382,10 +579,16 @@ static void odbcGetForeignUpperPaths(PlannerInfo *root,
  * helper functions
  */
 static bool odbcIsValidOption(const char *option, Oid context);
-static void check_return(SQLRETURN ret, 
-						 char *msg,
-						 SQLHANDLE handle,
-						 SQLSMALLINT type);
+static OdbcLimitSyntax odbc_limit_syntax(const char *name);
+static OdbcSampleMethod odbc_sample_method(const char *name);
+static int odbcAcquireSampleRows(Relation relation, int elevel,
+					  HeapTuple *rows, int targrows,
+					  double *totalrows,
+					  double *totaldeadrows);
+static void odbc_get_dialect(odbcFdwOptions *options, SQLHDBC dbc,
+				 OdbcDialect *dialect);
+static double odbc_count_remote_rows(SQLHDBC dbc, Relation relation,
+					   odbcFdwOptions *options);
 static const char* empty_string_if_null(char *string);
 static void extract_odbcFdwOptions(List *options_list, 
 								   odbcFdwOptions *extracted_options);
@@ -403,13 +606,82 @@ static void odbcGetOptions(Oid server_oid, List *add_options,
 
 static void odbcGetTableOptions(Oid foreigntableid, odbcFdwOptions *extracted_options);
 static void odbcGetTableSize(odbcFdwOptions* options, unsigned int *size);
-static void check_return(SQLRETURN ret, char *msg, SQLHANDLE handle, SQLSMALLINT type);
 static void odbcConnStr(StringInfoData *conn_str, odbcFdwOptions* options);
 static char* get_schema_name(odbcFdwOptions *options);
 static inline bool is_blank_string(const char *s);
 static Oid oid_from_server_name(char *serverName);
 static void odbc_prepare_foreign_modify(odbcFdwModifyState *fmstate);
-static void odbc_Bind_Prepared(odbcFdwModifyState *fmstate, char** p_value);
+static bool odbc_set_param_type(odbcParamColumn *param, Oid typid,
+								int32 typmod);
+static void odbc_bind_param(SQLHSTMT stmt, odbcParamColumn *param);
+static void odbc_store_param(SQLHSTMT stmt, odbcParamColumn *param, int row,
+							 const char *value, SQLLEN len);
+static void odbc_store_datum(SQLHSTMT stmt, odbcParamColumn *param, int row,
+							 Datum value, bool isnull);
+static odbcParamColumn *odbc_prepare_query_params(SQLHSTMT stmt,
+												  const char *query,
+												  List *fdw_exprs,
+												  PlanState *node,
+												  bool has_boolean,
+												  List **param_exprs,
+												  bool *has_text_params);
+static void odbc_store_query_params(SQLHSTMT stmt, odbcParamColumn *params,
+									List *param_exprs, bool has_text_params,
+									ExprContext *econtext);
+#ifndef DIRECT_INSERT
+static void odbc_init_param_arrays(odbcFdwModifyState *fmstate);
+static void odbc_flush_param_batch(odbcFdwModifyState *fmstate);
+static void param_batch_error_callback(void *arg);
+#endif
+static void odbc_describe_columns(odbcFdwExecutionState *festate);
+static void odbc_set_rowset_size(odbcFdwExecutionState *festate, int fetch_size);
+static void odbc_bind_columns(odbcFdwExecutionState *festate);
+static SQLRETURN odbc_fetch_next_row(odbcFdwExecutionState *festate);
+static void odbc_execute_scan(odbcFdwExecutionState *festate);
+static void odbc_send_scan_query(ForeignScanState *node,
+					 odbcFdwExecutionState *festate);
+static bool odbc_lookup_key_cache(odbcFdwExecutionState *festate);
+static void odbc_cache_row(odbcFdwExecutionState *festate, TupleTableSlot *slot);
+static void odbc_reset_key_cache(odbcFdwExecutionState *festate);
+static uint32 key_cache_hash(const void *key, Size keysize);
+static int	key_cache_match(const void *key1, const void *key2, Size keysize);
+static void odbc_start_spool(odbcFdwExecutionState *festate);
+static void odbc_spool_row(odbcFdwExecutionState *festate, TupleTableSlot *slot);
+static void odbc_decode_row(odbcFdwExecutionState *festate, TupleDesc tupdesc,
+				Datum *values, bool *nulls);
+static bool odbc_can_get_bound_data(odbcFdwExecutionState *festate);
+static char *odbc_get_column_data(odbcFdwExecutionState *festate,
+								  SQLUSMALLINT column, int col_size);
+static SQLSMALLINT odbc_native_ctype(SQLSMALLINT odbc_data_type,
+									 SQLSMALLINT decimal_digits,
+									 Oid pgtype, int32 pgtypmod);
+static odbcColumnDecoder odbc_native_decoder(SQLSMALLINT ctype, int *length);
+static Datum odbc_decode_text(odbcFdwExecutionState *festate,
+							  odbcScanColumn *col, char *value);
+static Datum odbc_decode_hex(odbcFdwExecutionState *festate,
+							 odbcScanColumn *col, char *value);
+static Datum odbc_decode_bit_text(odbcFdwExecutionState *festate,
+								  odbcScanColumn *col, char *value);
+static Datum odbc_decode_int2(odbcFdwExecutionState *festate,
+							  odbcScanColumn *col, char *value);
+static Datum odbc_decode_int4(odbcFdwExecutionState *festate,
+							  odbcScanColumn *col, char *value);
+static Datum odbc_decode_int8(odbcFdwExecutionState *festate,
+							  odbcScanColumn *col, char *value);
+static Datum odbc_decode_float4(odbcFdwExecutionState *festate,
+								odbcScanColumn *col, char *value);
+static Datum odbc_decode_float8(odbcFdwExecutionState *festate,
+								odbcScanColumn *col, char *value);
+static Datum odbc_decode_date(odbcFdwExecutionState *festate,
+							  odbcScanColumn *col, char *value);
+static Datum odbc_decode_time(odbcFdwExecutionState *festate,
+							  odbcScanColumn *col, char *value);
+static Datum odbc_decode_timestamp(odbcFdwExecutionState *festate,
+								   odbcScanColumn *col, char *value);
+static Datum odbc_decode_bool(odbcFdwExecutionState *festate,
+							  odbcScanColumn *col, char *value);
+static Datum odbc_decode_uuid(odbcFdwExecutionState *festate,
+							  odbcScanColumn *col, char *value);
 
 static const char** odbc_convert_prep_stmt_params(odbcFdwModifyState *fmstate,
 						 						  ItemPointer tupleid,
@@ -420,6 +692,8 @@ static bool ec_member_matches_foreign(PlannerInfo *root,
 									  EquivalenceClass *ec,
 									  EquivalenceMember *em,
 									  void *arg);
+static Bitmapset *get_indexed_attrs(Oid foreigntableid, AttrNumber max_attr);
+static bool is_indexed_key_clause(RestrictInfo *rinfo, RelOptInfo *baserel);
 
 static void add_paths_with_pathkeys_for_rel(PlannerInfo *root,
                                             RelOptInfo *rel,
@@ -436,20 +710,48 @@ static void estimate_path_cost_size(PlannerInfo *root,
 									List *pathkeys,
 									double *p_rows, int *p_width,
 									Cost *p_startup_cost, Cost *p_total_cost);
+static bool get_remote_estimate(PlannerInfo *root,
+					RelOptInfo *foreignrel,
+					List *param_join_conds,
+					List *pathkeys,
+					List **local_param_join_conds,
+					OdbcRemoteEstimate *est);
 #if PG_VERSION_NUM >= 100000
 static void add_foreign_grouping_paths(PlannerInfo *root,
 					RelOptInfo *input_rel,
 					RelOptInfo *grouped_rel);
 
 static bool foreign_grouping_ok(PlannerInfo *root, RelOptInfo *grouped_rel);
+static void add_foreign_distinct_paths(PlannerInfo *root,
+						   RelOptInfo *input_rel,
+						   RelOptInfo *distinct_rel);
+static void add_foreign_ordered_paths(PlannerInfo *root,
+						  RelOptInfo *input_rel,
+						  RelOptInfo *ordered_rel);
+static void add_foreign_final_paths(PlannerInfo *root,
+						RelOptInfo *input_rel,
+						RelOptInfo *final_rel);
+static void adjust_limit_rows_costs(double *rows, Cost *startup_cost,
+						Cost *total_cost, int64 offset, int64 count);
 #endif
 
 static void merge_fdw_options(PgFdwRelationInfo *fpinfo,
 				  const PgFdwRelationInfo *fpinfo_o,
 				  const PgFdwRelationInfo *fpinfo_i);
+static void odbcGetForeignJoinPaths(PlannerInfo *root,
+							RelOptInfo *joinrel,
+							RelOptInfo *outerrel,
+							RelOptInfo *innerrel,
+							JoinType jointype,
+							JoinPathExtraData *extra);
+static bool foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel,
+				JoinType jointype, RelOptInfo *outerrel, RelOptInfo *innerrel,
+				JoinPathExtraData *extra);
 
 #ifdef DIRECT_INSERT
-char *build_insert_sql(odbcFdwModifyState *fmstate, char** p_value);
+static void build_insert_values(odbcFdwModifyState *fmstate, char **p_value,
+								StringInfo buf);
+static void odbc_flush_insert_batch(odbcFdwModifyState *fmstate);
 #endif
 
 /* Callback argument for ec_member_matches_foreign */
@@ -474,7 +776,7 @@ odbc_fdw_handler(PG_FUNCTION_ARGS)
 	/* FIXME */
 	fdwroutine->GetForeignRelSize = odbcGetForeignRelSize;
 	fdwroutine->GetForeignPaths = odbcGetForeignPaths;
-	fdwroutine->AnalyzeForeignTable = NULL;
+	fdwroutine->AnalyzeForeignTable = odbcAnalyzeForeignTable;
 	fdwroutine->GetForeignPlan = odbcGetForeignPlan;
 	fdwroutine->ExplainForeignScan = odbcExplainForeignScan;
 	fdwroutine->BeginForeignScan = odbcBeginForeignScan;
@@ -482,6 +784,9 @@ odbc_fdw_handler(PG_FUNCTION_ARGS)
 	fdwroutine->ReScanForeignScan = odbcReScanForeignScan;
 	fdwroutine->EndForeignScan = odbcEndForeignScan;
 
+	/* Support functions for join push-down */
+	fdwroutine->GetForeignJoinPaths = odbcGetForeignJoinPaths;
+
 	fdwroutine->PlanDirectModify = odbcPlanDirectModify;
 	fdwroutine->BeginDirectModify = odbcBeginDirectModify;
 	fdwroutine->IterateDirectModify = odbcIterateDirectModify;
@@ -510,6 +815,8 @@ static void
 init_odbcFdwOptions(odbcFdwOptions* options)
 {
 	memset(options, 0, sizeof(odbcFdwOptions));
+	options->stats_ttl = -1;
+	options->use_remote_estimate = -1;
 }
 
 static void
@@ -636,6 +943,74 @@ extract_odbcFdwOptions(List *options_list, odbcFdwOptions *extracted_options)
 			continue;
 		}
 
+		if (strcmp(def->defname, "fetch_size") == 0)
+		{
+			/*
+			 * Table options precede server options in the list, so keep
+			 * the first value seen: a per-table setting overrides the
+			 * per-server one.
+			 */
+			if (extracted_options->fetch_size == 0)
+				extracted_options->fetch_size = strtol(defGetString(def), NULL, 10);
+			continue;
+		}
+
+		if (strcmp(def->defname, "batch_size") == 0)
+		{
+			/* Table setting overrides server setting, as for fetch_size */
+			if (extracted_options->batch_size == 0)
+				extracted_options->batch_size = strtol(defGetString(def), NULL, 10);
+			continue;
+		}
+
+		if (strcmp(def->defname, "limit_syntax") == 0)
+		{
+			extracted_options->limit_syntax = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "grouping_sets") == 0)
+		{
+			extracted_options->grouping_sets = defGetBoolean(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "analyze_sampling") == 0)
+		{
+			/* Table setting overrides server setting, as for fetch_size */
+			if (extracted_options->analyze_sampling == NULL)
+				extracted_options->analyze_sampling = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "stats_ttl") == 0)
+		{
+			/* Table setting overrides server setting, as for fetch_size */
+			if (extracted_options->stats_ttl < 0)
+				extracted_options->stats_ttl = strtol(defGetString(def), NULL, 10);
+			continue;
+		}
+
+		if (strcmp(def->defname, "use_remote_estimate") == 0)
+		{
+			/* Table setting overrides server setting, as for fetch_size */
+			if (extracted_options->use_remote_estimate < 0)
+				extracted_options->use_remote_estimate = defGetBoolean(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "remote_estimator") == 0)
+		{
+			extracted_options->remote_estimator = defGetString(def);
+			continue;
+		}
+
+		if (strcmp(def->defname, "dialect") == 0)
+		{
+			extracted_options->dialect = defGetString(def);
+			continue;
+		}
+
 		/* Column mapping goes here */
 		/* TODO: is this useful? if so, how can columns names coincident
 		   with option names be escaped? */
@@ -653,30 +1028,17 @@ static char* get_schema_name(odbcFdwOptions *options)
 }
 
 /*
- * Establish ODBC connection
+ * Get an ODBC connection, from the connection cache if possible.
+ * Release it with odbc_ReleaseConnection.
  */
 static void
 odbc_connection(odbcFdwOptions* options, SQLHDBC *dbc)
 {
 	StringInfoData  conn_str;
-	SQLCHAR OutConnStr[1024];
-	SQLSMALLINT OutConnStrLen;
-	SQLRETURN ret;
-	
+
 	odbcConnStr(&conn_str, options);
-	if (odbc_env == NULL) {
-		/* Allocate an environment handle */
-		SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &odbc_env);
-		/* We want ODBC 3 support */
-		SQLSetEnvAttr(odbc_env, SQL_ATTR_ODBC_VERSION, (void *) SQL_OV_ODBC3, 0);
-	}
-
-	/* Allocate a connection handle */
-	SQLAllocHandle(SQL_HANDLE_DBC, odbc_env, dbc);
-	/* Connect to the DSN */
-	ret = SQLDriverConnect(*dbc, NULL, (SQLCHAR *) conn_str.data, SQL_NTS,
-	                       OutConnStr, 1024, &OutConnStrLen, SQL_DRIVER_COMPLETE);
-	check_return(ret, "Connecting to driver", dbc, SQL_HANDLE_DBC);
+	*dbc = odbc_GetConnection(conn_str.data, options->serverid, options->umid);
+	pfree(conn_str.data);
 }
 
 /*
@@ -788,10 +1150,58 @@ odbc_fdw_validator(PG_FUNCTION_ARGS)
 
 			sql_count = defGetString(def);
 		}
-		else if (strcmp(def->defname, "updatable") == 0)
+		else if (strcmp(def->defname, "updatable") == 0 ||
+				 strcmp(def->defname, "grouping_sets") == 0 ||
+				 strcmp(def->defname, "use_remote_estimate") == 0 ||
+				 strcmp(def->defname, "indexed") == 0)
 		{
 			 (void)defGetBoolean(def);
 		}
+		else if (strcmp(def->defname, "fetch_size") == 0 ||
+				 strcmp(def->defname, "batch_size") == 0)
+		{
+			char	   *value = defGetString(def);
+			char	   *end;
+			long		size;
+
+			size = strtol(value, &end, 10);
+			if (end == value || *end != '\0' || size <= 0 || size > INT_MAX)
+				ereport(ERROR,
+				        (errcode(ERRCODE_SYNTAX_ERROR),
+				         errmsg("%s requires a positive integer value",
+								def->defname)
+				        ));
+		}
+		else if (strcmp(def->defname, "limit_syntax") == 0)
+		{
+			(void) odbc_limit_syntax(defGetString(def));
+		}
+		else if (strcmp(def->defname, "analyze_sampling") == 0)
+		{
+			(void) odbc_sample_method(defGetString(def));
+		}
+		else if (strcmp(def->defname, "remote_estimator") == 0)
+		{
+			(void) odbc_estimator(defGetString(def));
+		}
+		else if (strcmp(def->defname, "dialect") == 0)
+		{
+			(void) odbc_dialect(defGetString(def));
+		}
+		else if (strcmp(def->defname, "stats_ttl") == 0)
+		{
+			char	   *value = defGetString(def);
+			char	   *end;
+			long		ttl;
+
+			ttl = strtol(value, &end, 10);
+			if (end == value || *end != '\0' || ttl < 0 || ttl > INT_MAX / 1000)
+				ereport(ERROR,
+				        (errcode(ERRCODE_SYNTAX_ERROR),
+				         errmsg("%s requires a non-negative integer value",
+								def->defname)
+				        ));
+		}
 	}
 
 	PG_RETURN_VOID();
@@ -953,6 +1363,8 @@ odbcGetOptions(Oid server_oid,
 	options = list_concat(options, mapping->options);
 
 	extract_odbcFdwOptions(options, extracted_options);
+	extracted_options->serverid = server_oid;
+	extracted_options->umid = mapping->umid;
 }
 
 /*
@@ -969,7 +1381,7 @@ odbcGetTableOptions(Oid foreigntableid, odbcFdwOptions *extracted_options)
 	odbcGetOptions(table->serverid, table->options, extracted_options);
 }
 
-static void
+void
 check_return(SQLRETURN ret, char *msg, SQLHANDLE handle, SQLSMALLINT type)
 {
 	if (SQL_SUCCEEDED(ret))
@@ -1177,16 +1589,9 @@ odbcGetTableSize(odbcFdwOptions* options, unsigned int *size)
 
 	if (dbc)
 	{
-		SQLDisconnect(dbc);
-		SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+		odbc_ReleaseConnection(dbc);
 		dbc = NULL;
 	}
-
-	if (odbc_env)
-	{
-		SQLFreeHandle(SQL_HANDLE_ENV, odbc_env);
-		odbc_env = NULL;
-	}
 }
 
 static int
@@ -1409,8 +1814,7 @@ odbc_tables_list(PG_FUNCTION_ARGS)
 		SRF_RETURN_NEXT(funcctx, result);
 	} else {
 		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-		SQLDisconnect(datafctx->dbc);
-		SQLFreeHandle(SQL_HANDLE_DBC, datafctx->dbc);
+		odbc_ReleaseConnection(datafctx->dbc);
 		SRF_RETURN_DONE(funcctx);
 	}
 }
@@ -1446,15 +1850,108 @@ odbcIsValidOption(const char *option, Oid context)
 		return false;
 }
 
+/*
+ * Map the value of the limit_syntax option to the OdbcLimitSyntax it
+ * stands for.  Without the option the driver limits the rows.
+ */
+static OdbcLimitSyntax
+odbc_limit_syntax(const char *name)
+{
+	if (name == NULL || strcmp(name, "max_rows") == 0)
+		return ODBC_LIMIT_MAX_ROWS;
+	if (strcmp(name, "limit") == 0)
+		return ODBC_LIMIT_LIMIT;
+	if (strcmp(name, "top") == 0)
+		return ODBC_LIMIT_TOP;
+	if (strcmp(name, "fetch_first") == 0)
+		return ODBC_LIMIT_FETCH_FIRST;
+
+	ereport(ERROR,
+	        (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+	         errmsg("invalid value for option limit_syntax: \"%s\"", name),
+	         errhint("Valid values are: limit, top, fetch_first, max_rows")
+	        ));
+	return ODBC_LIMIT_MAX_ROWS;		/* keep compiler quiet */
+}
+
+/*
+ * Map the value of the analyze_sampling option to the OdbcSampleMethod it
+ * stands for.  Without the option the method depends on the server.
+ */
+static OdbcSampleMethod
+odbc_sample_method(const char *name)
+{
+	if (name == NULL || strcmp(name, "auto") == 0)
+		return ODBC_SAMPLE_AUTO;
+	if (strcmp(name, "off") == 0)
+		return ODBC_SAMPLE_OFF;
+	if (strcmp(name, "tablesample") == 0)
+		return ODBC_SAMPLE_TABLESAMPLE;
+	if (strcmp(name, "sample") == 0)
+		return ODBC_SAMPLE_SAMPLE;
+	if (strcmp(name, "random") == 0)
+		return ODBC_SAMPLE_RANDOM;
+
+	ereport(ERROR,
+	        (errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+	         errmsg("invalid value for option analyze_sampling: \"%s\"", name),
+	         errhint("Valid values are: auto, off, tablesample, sample, random")
+	        ));
+	return ODBC_SAMPLE_OFF;		/* keep compiler quiet */
+}
+
+/*
+ * odbc_get_dialect
+ *		Get the SQL dialect of the server the options are for: the one the
+ *		dialect option names, or else the one detected from the driver.
+ *
+ * Even a dialect named by the option needs the driver, which tells the
+ * functions it supports.  The driver is asked over dbc, or over a
+ * connection of its own if dbc is NULL, unless it has been asked before.
+ */
+static void
+odbc_get_dialect(odbcFdwOptions *options, SQLHDBC dbc, OdbcDialect *dialect)
+{
+	const OdbcDialect *profile = odbc_dialect(options->dialect);
+
+	if (!odbc_cached_dialect(options->serverid, dialect))
+	{
+		if (dbc != NULL)
+			odbc_detect_dialect(dbc, options->serverid, profile, dialect);
+		else
+		{
+			odbc_connection(options, &dbc);
+			odbc_detect_dialect(dbc, options->serverid, profile, dialect);
+			odbc_ReleaseConnection(dbc);
+		}
+	}
+}
+
+/*
+ * Number of pages a table of the given number of rows and average row width
+ * would take locally; the remote server can't tell its own.
+ */
+static BlockNumber
+estimate_rel_pages(double tuples, int32 width)
+{
+	return (BlockNumber)
+		ceil(tuples * (width + MAXALIGN(SizeofHeapTupleHeader)) / BLCKSZ);
+}
+
 static void
 odbcGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
 {
 	PgFdwRelationInfo *fpinfo;
 	ListCell   *lc;
 	odbcFdwOptions options;
+	StringInfoData conn_str;
 	const char *namespace;
 	const char *relname;
 	const char *refname;
+	double		cached_rows;
+	int32		width;
+	bool		stale;
+	int			ttl;
 
 	RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
 
@@ -1463,8 +1960,33 @@ odbcGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid
 	/* Fetch the foreign table options */
 	odbcGetTableOptions(foreigntableid, &options);
 
-	baserel->rows = DEFAULT_TABLE_SIZE;
-	baserel->tuples = baserel->rows;
+	/*
+	 * Plan with the cached remote row count if there is one, else with the
+	 * one ANALYZE found.  A cached count older than stats_ttl is still used
+	 * while a background worker takes a new one.  The number of pages is
+	 * worked out from the row count and the average row width, since it
+	 * cannot be learnt from the remote server.  A table never counted is
+	 * assumed to be large.
+	 */
+	ttl = Max(options.stats_ttl, 0);
+	if (odbc_get_cached_stats(foreigntableid, ttl, &cached_rows, &width,
+							  &stale))
+	{
+		baserel->tuples = cached_rows;
+		if (stale)
+			odbc_request_stats_refresh(foreigntableid, ttl);
+	}
+	else
+	{
+		width = get_relation_data_width(foreigntableid, NULL);
+		if (ttl > 0)
+			odbc_request_stats_refresh(foreigntableid, ttl);
+	}
+
+	if (baserel->tuples <= 0)
+		baserel->tuples = DEFAULT_TABLE_SIZE;
+	baserel->pages = estimate_rel_pages(baserel->tuples, width);
+	baserel->rows = baserel->tuples;
 	fpinfo = (PgFdwRelationInfo *) palloc0(sizeof(PgFdwRelationInfo));
 	baserel->fdw_private = (void *) fpinfo;
 
@@ -1479,13 +2001,33 @@ odbcGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid
 	 * Extract user-settable option values.  Note that per-table setting of
 	 * use_remote_estimate overrides per-server setting.
 	 */
-	fpinfo->use_remote_estimate = false;
+	fpinfo->use_remote_estimate = (options.use_remote_estimate > 0);
 	fpinfo->fdw_startup_cost = DEFAULT_FDW_STARTUP_COST;
 	fpinfo->fdw_tuple_cost = DEFAULT_FDW_TUPLE_COST;
 	fpinfo->shippable_extensions = NIL;
-	fpinfo->fetch_size = 100;
+	fpinfo->fetch_size = options.fetch_size > 0 ? options.fetch_size
+												: DEFAULT_FETCH_SIZE;
+
+	/*
+	 * The dialect decides what can be pushed down, so it is needed before
+	 * the conditions are classified.  A dialect set by option also gives
+	 * the default LIMIT syntax; a detected one keeps max_rows, which works
+	 * with every driver.
+	 */
+	odbc_get_dialect(&options, NULL, &fpinfo->dialect);
+	if (options.limit_syntax == NULL && odbc_dialect(options.dialect) != NULL)
+		fpinfo->limit_syntax = fpinfo->dialect.limit_syntax;
+	else
+		fpinfo->limit_syntax = odbc_limit_syntax(options.limit_syntax);
+	fpinfo->grouping_sets = options.grouping_sets;
+	fpinfo->indexed_attrs = get_indexed_attrs(foreigntableid,
+											  baserel->max_attr);
+
+	/* Tables can only be joined remotely over the same connection */
+	odbcConnStr(&conn_str, &options);
+	fpinfo->conn_str = conn_str.data;
 
-	fpinfo->user = NULL;
+	fpinfo->user = GetUserMapping(GetUserId(), fpinfo->server->serverid);
 
 	/*
 	 * Identify which baserestrictinfo clauses can be sent to the remote
@@ -1507,7 +2049,7 @@ odbcGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid
 				   &fpinfo->attrs_used);
 	foreach(lc, fpinfo->local_conds)
 	{
-		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
 
 		pull_varattnos((Node *) rinfo->clause, baserel->relid,
 					   &fpinfo->attrs_used);
@@ -1535,31 +2077,56 @@ odbcGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid
 	fpinfo->rel_total_cost = -1;
 
 	/*
-	 * If the table or the server is configured to use remote estimates,
-	 * connect to the foreign server and execute EXPLAIN to estimate the
-	 * number of rows selected by the restriction clauses, as well as the
-	 * average row width.  Otherwise, estimate using whatever statistics we
-	 * have locally, in a way similar to ordinary tables.
+	 * If the table or the server is configured to use remote estimates, find
+	 * out how the server can be asked for them.  A server that cannot
+	 * EXPLAIN a query is asked for the cardinality of the table instead,
+	 * which the local estimates below then start from.
 	 */
-
+	if (fpinfo->use_remote_estimate)
 	{
-		/*
-		 * If the foreign table has never been ANALYZEd, it will have relpages
-		 * and reltuples equal to zero, which most likely has nothing to do
-		 * with reality.  We can't do a whole lot about that if we're not
-		 * allowed to consult the remote server, but we can use a hack similar
-		 * to plancat.c's treatment of empty relations: use a minimum size
-		 * estimate of 10 pages, and divide by the column-datatype-based width
-		 * estimate to get the corresponding number of tuples.
-		 */
-		if (baserel->pages == 0 && baserel->tuples == 0)
+		SQLHDBC		dbc;
+
+		odbc_connection(&options, &dbc);
+
+		fpinfo->estimator = odbc_estimator(options.remote_estimator);
+		if (fpinfo->estimator == ODBC_ESTIMATOR_AUTO)
+			fpinfo->estimator = fpinfo->dialect.estimator;
+
+		if (fpinfo->estimator == ODBC_ESTIMATOR_STATISTICS)
 		{
-			baserel->pages = 10;
-			baserel->tuples =
-				(10 * BLCKSZ) / (baserel->reltarget->width +
-								 MAXALIGN(SizeofHeapTupleHeader));
+			const char *nspname = options.schema;
+			const char *tablename = options.table;
+			double		cardinality;
+
+			/* Name the table as the remote queries do */
+			if (nspname == NULL)
+				nspname = get_namespace_name(get_rel_namespace(foreigntableid));
+			if (tablename == NULL)
+				tablename = get_rel_name(foreigntableid);
+
+			cardinality = odbc_get_remote_cardinality(dbc,
+													  fpinfo->server->serverid,
+													  nspname, tablename);
+			if (cardinality >= 0)
+			{
+				baserel->tuples = cardinality;
+				baserel->pages = estimate_rel_pages(cardinality, width);
+			}
+			fpinfo->use_remote_estimate = false;
 		}
 
+		odbc_ReleaseConnection(dbc);
+	}
+
+	/*
+	 * If remote estimates are still wanted, estimate_path_cost_size() has
+	 * the foreign server EXPLAIN the query to estimate the number of rows
+	 * selected by the restriction clauses, as well as the average row width.
+	 * Otherwise, estimate using whatever statistics we have locally, in a
+	 * way similar to ordinary tables.
+	 */
+
+	{
 		/* Estimate baserel size as best we can with local statistics. */
 		set_baserel_size_estimates(root, baserel);
 
@@ -1567,6 +2134,13 @@ odbcGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid
 		estimate_path_cost_size(root, baserel, NIL, NIL,
 								&fpinfo->rows, &fpinfo->width,
 								&fpinfo->startup_cost, &fpinfo->total_cost);
+
+		/* Remote estimates replace those from local statistics */
+		if (fpinfo->use_remote_estimate)
+		{
+			baserel->rows = fpinfo->rows;
+			baserel->reltarget->width = fpinfo->width;
+		}
 	}
 
 	/*
@@ -1627,11 +2201,12 @@ static void odbcGetForeignPaths(PlannerInfo *root,
 	add_paths_with_pathkeys_for_rel(root, baserel, NULL);
 
 	/*
-	 * If we're not using remote estimates, stop here.  We have no way to
-	 * estimate whether any join clauses would be worth sending across, so
-	 * don't bother building parameterized paths.
+	 * If we're not using remote estimates, the only join clauses we know to
+	 * be worth sending across are equalities on columns marked "indexed",
+	 * which the remote side can answer with an index lookup.  If there are
+	 * no such columns, don't bother building parameterized paths.
 	 */
-	if (!fpinfo->use_remote_estimate)
+	if (!fpinfo->use_remote_estimate && fpinfo->indexed_attrs == NULL)
 		return;
 
 	/*
@@ -1663,6 +2238,11 @@ static void odbcGetForeignPaths(PlannerInfo *root,
 		if (!odbc_is_foreign_expr(root, baserel, rinfo->clause))
 			continue;
 
+		/* Without remote estimates, consider index lookups only */
+		if (!fpinfo->use_remote_estimate &&
+			!is_indexed_key_clause(rinfo, baserel))
+			continue;
+
 		/* Calculate required outer rels for the resulting path */
 		required_outer = bms_union(rinfo->clause_relids,
 								   baserel->lateral_relids);
@@ -1739,6 +2319,11 @@ static void odbcGetForeignPaths(PlannerInfo *root,
 				if (!odbc_is_foreign_expr(root, baserel, rinfo->clause))
 					continue;
 
+				/* Without remote estimates, consider index lookups only */
+				if (!fpinfo->use_remote_estimate &&
+					!is_indexed_key_clause(rinfo, baserel))
+					continue;
+
 				/* Calculate required outer rels for the resulting path */
 				required_outer = bms_union(rinfo->clause_relids,
 										   baserel->lateral_relids);
@@ -1771,7 +2356,7 @@ static void odbcGetForeignPaths(PlannerInfo *root,
 		Cost		startup_cost;
 		Cost		total_cost;
 
-		/* Get a cost estimate from the remote */
+		/* Get a cost estimate */
 		estimate_path_cost_size(root, baserel,
 								param_info->ppi_clauses, NIL,
 								&rows, &width,
@@ -1816,8 +2401,35 @@ static ForeignScan* odbcGetForeignPlan(PlannerInfo *root,
 	List	   *fdw_recheck_quals = NIL;
 	List	   *retrieved_attrs;
 	StringInfoData sql;
+	bool		has_limit = false;
+	int			fetch_size = fpinfo->fetch_size;
+	int64		max_rows = 0;
 	ListCell   *lc;
 
+	/*
+	 * Get FDW private data created by odbcGetForeignUpperPaths(), if any.
+	 */
+	if (best_path->fdw_private)
+		has_limit = intVal(list_nth(best_path->fdw_private,
+									FdwPathPrivateHasLimit));
+
+	/*
+	 * No more rows than the LIMIT asks for are fetched at a time.  If the
+	 * server has no syntax for a LIMIT, have the driver stop there.
+	 */
+	if (has_limit)
+	{
+		int64		count;
+		int64		offset;
+
+		if (!odbc_get_limit_values(root->parse, &count, &offset))
+			elog(ERROR, "LIMIT of a pushed-down query is not a constant");
+		if (count < fetch_size)
+			fetch_size = (int) count;
+		if (fpinfo->limit_syntax == ODBC_LIMIT_MAX_ROWS)
+			max_rows = count;
+	}
+
 	if (IS_SIMPLE_REL(foreignrel))
 	{
 		/*
@@ -1846,7 +2458,7 @@ static ForeignScan* odbcGetForeignPlan(PlannerInfo *root,
 		 */
 		foreach(lc, scan_clauses)
 		{
-			RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+			RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
 
 			/* Ignore any pseudoconstants, they're dealt with elsewhere */
 			if (rinfo->pseudoconstant)
@@ -1949,7 +2561,7 @@ static ForeignScan* odbcGetForeignPlan(PlannerInfo *root,
 	initStringInfo(&sql);
 	odbc_deparseSelectStmtForRel(&sql, root, foreignrel, fdw_scan_tlist,
 							remote_exprs, best_path->path.pathkeys,
-							false, &retrieved_attrs, &params_list);
+							has_limit, false, &retrieved_attrs, &params_list);
 
 	/* Remember remote_exprs for possible use by postgresPlanDirectModify */
 	fpinfo->final_remote_exprs = remote_exprs;
@@ -1958,9 +2570,10 @@ static ForeignScan* odbcGetForeignPlan(PlannerInfo *root,
 	 * Build the fdw_private list that will be available to the executor.
 	 * Items in the list must match order in enum FdwScanPrivateIndex.
 	 */
-	fdw_private = list_make3(makeString(sql.data),
+	fdw_private = list_make4(makeString(sql.data),
 							 retrieved_attrs,
-							 makeInteger(fpinfo->fetch_size));
+							 makeInteger(fetch_size),
+							 makeInteger(max_rows));
 	if (IS_JOIN_REL(foreignrel) || IS_UPPER_REL(foreignrel))
 		fdw_private = lappend(fdw_private,
 							  makeString(fpinfo->relation_name->data));
@@ -1984,79 +2597,388 @@ static ForeignScan* odbcGetForeignPlan(PlannerInfo *root,
 }
 
 /*
- * odbcBeginForeignScan
+ * odbc_describe_columns
+ *		Describe the columns of the result set and set up the descriptor of
+ *		each retrieved column.
  *
+ * Columns of bounded size are bound to column-wise rowset buffers with
+ * SQLBindCol.  Long data (LOB) columns, and columns whose size is unknown
+ * or exceeds MAXIMUM_BUFFER_SIZE, are read piecewise with SQLGetData.
+ * Unless the driver supports SQL_GD_ANY_COLUMN, SQLGetData may only be
+ * used on columns after the last bound one, so every column following an
+ * unbound column is left unbound as well.  A bound value that turns out
+ * not to fit its buffer is read again with SQLGetData where the driver
+ * allows it (see odbc_decode_row).
  */
 static void
-odbcBeginForeignScan(ForeignScanState *node, int eflags)
+odbc_describe_columns(odbcFdwExecutionState *festate)
 {
-	SQLHDBC dbc;
-	odbcFdwExecutionState   *festate;
-	SQLSMALLINT result_columns;
-	SQLHSTMT stmt;
-	SQLRETURN ret;
-
-#ifdef DEBUG
-	char dsn[256];
-	char desc[256];
-	SQLSMALLINT dsn_ret;
-	SQLSMALLINT desc_ret;
-	SQLUSMALLINT direction;
-#endif
-	
-	int				rtindex;
-	odbcFdwOptions 	options;
-	char	   		*query;
-	Relation 		rel;
-	RangeTblEntry 	*rte;
-	int 			num_of_columns;
-	StringInfoData 	*columns;
-	int 			i;
-	ListCell 		*col_mapping;
-	StringInfoData 	col_str;
-	StringInfoData 	name_qualifier_char;
-	StringInfoData 	quote_char;
-	ForeignScan 	*fsplan = (ForeignScan *) node->ss.ps.plan;
-	EState			*estate = node->ss.ps.state;
-	int 			encoding = -1;
+	SQLHSTMT	stmt = festate->stmt;
+	SQLCHAR    *ColumnName;
+	SQLSMALLINT NameLengthPtr;
+	SQLSMALLINT DataTypePtr;
+	SQLULEN     ColumnSizePtr;
+	SQLSMALLINT DecimalDigitsPtr;
+	SQLSMALLINT NullablePtr;
+	SQLULEN		min_size;
+	SQLULEN		max_size = MAXIMUM_BUFFER_SIZE;
+	bool		any_column = (festate->getdata_ext & SQL_GD_ANY_COLUMN) != 0;
+	ListCell   *lc;
+	int			i;
 
-	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
-		return;
+	/* Only the result columns that feed an attribute are retrieved */
+	festate->num_columns = Min(festate->num_of_result_cols,
+							   list_length(festate->retrieved_attrs));
+	festate->columns = (odbcScanColumn *)
+		palloc0(sizeof(odbcScanColumn) * Max(festate->num_columns, 1));
+	festate->has_unbound_cols = false;
 
-	elog_debug("%s", __func__);
-	query = strVal(list_nth(fsplan->fdw_private,
-									 FdwScanPrivateSelectSql));
-	elog_debug("%s", query);
+	ColumnName = (SQLCHAR *) palloc(sizeof(SQLCHAR) * MAXIMUM_COLUMN_NAME_LEN);
 
-	/* Fetch the foreign table options */
-	if (fsplan->scan.scanrelid > 0)
- 		rtindex = fsplan->scan.scanrelid; 
-	else 
-		rtindex = bms_next_member(fsplan->fs_relids, -1);
+	i = 0;
+	foreach(lc, festate->retrieved_attrs)
+	{
+		odbcScanColumn *col = &festate->columns[i];
+		int			attnum = lfirst_int(lc);
+		Form_pg_attribute attr;
+		bool		bindable;
 
-	rte = rt_fetch(rtindex, estate->es_range_table);
+		if (i >= festate->num_columns)
+			break;
 
-	odbcGetTableOptions(rte->relid, &options);
+		SQLDescribeCol(stmt,
+		               i + 1,                   /* ColumnName */
+		               ColumnName,
+		               sizeof(SQLCHAR) * MAXIMUM_COLUMN_NAME_LEN, /* BufferLength */
+		               &NameLengthPtr,
+		               &DataTypePtr,
+		               &ColumnSizePtr,
+		               &DecimalDigitsPtr,
+		               &NullablePtr);
+
+		col->ordinal = i + 1;
+		col->attnum = attnum;
+		col->infunc = &festate->attinmeta->attinfuncs[attnum - 1];
+		col->ioparam = festate->attinmeta->attioparams[attnum - 1];
+		col->typmod = festate->attinmeta->atttypmods[attnum - 1];
+		attr = festate->tupdesc->attrs[attnum - 1];
 
-	odbc_connection(&options,  &dbc);
+		/*
+		 * Work out the size of the character representation of the column.
+		 * Character columns are sized in characters, and DECIMAL/NUMERIC
+		 * in digits, not counting sign and decimal point.
+		 */
+		switch (DataTypePtr)
+		{
+			case SQL_LONGVARCHAR:
+			case SQL_WLONGVARCHAR:
+			case SQL_LONGVARBINARY:
+				bindable = false;
+				break;
+			case SQL_CHAR:
+			case SQL_VARCHAR:
+			case SQL_WCHAR:
+			case SQL_WVARCHAR:
+				bindable = (ColumnSizePtr > 0 &&
+							ColumnSizePtr * ODBC_MAX_BYTES_PER_CHAR <= max_size);
+				if (bindable)
+					ColumnSizePtr *= ODBC_MAX_BYTES_PER_CHAR;
+				break;
+			case SQL_DECIMAL:
+			case SQL_NUMERIC:
+				bindable = (ColumnSizePtr > 0 &&
+							ColumnSizePtr + 2 <= max_size);
+				if (bindable)
+					ColumnSizePtr += 2;
+				break;
+			default:
+				bindable = (ColumnSizePtr > 0 && ColumnSizePtr <= max_size);
+				break;
+		}
+		if (festate->has_unbound_cols && !any_column)
+			bindable = false;
+
+		min_size = minimum_buffer_size(DataTypePtr);
+		if (ColumnSizePtr < min_size)
+			ColumnSizePtr = min_size;
+		if (ColumnSizePtr > max_size)
+			ColumnSizePtr = max_size;
+
+		/* By default the value is retrieved as text */
+		col->ctype = SQL_C_CHAR;
+		col->length = (int) ColumnSizePtr + 1;
+		if (DataTypePtr == SQL_LONGVARBINARY)
+			col->decode = odbc_decode_hex;
+		else if (DataTypePtr == SQL_BIT)
+			col->decode = odbc_decode_bit_text;
+		else
+			col->decode = odbc_decode_text;
 
-	SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+		/*
+		 * If the attribute type has a native ODBC C representation, bind the
+		 * column as that type and build the Datum directly instead of going
+		 * through the type's input function.
+		 */
+		if (!festate->has_unbound_cols || any_column)
+		{
+			SQLSMALLINT ctype;
 
-	/* Retrieve a list of rows */
-	ret = SQLExecDirect(stmt, (SQLCHAR *) query, SQL_NTS);
-	check_return(ret, "Executing ODBC query", stmt, SQL_HANDLE_STMT);
-	SQLNumResultCols(stmt, &result_columns);
+			ctype = odbc_native_ctype(DataTypePtr, DecimalDigitsPtr,
+									  attr->atttypid, attr->atttypmod);
+			if (ctype != SQL_C_CHAR)
+			{
+				bindable = true;
+				col->ctype = ctype;
+				col->decode = odbc_native_decoder(ctype, &col->length);
+			}
+		}
 
-	festate = (odbcFdwExecutionState *) palloc(sizeof(odbcFdwExecutionState));
-	if (fsplan->scan.scanrelid > 0)
-	{
-		festate->rel = node->ss.ss_currentRelation;
-		festate->tupdesc = RelationGetDescr(festate->rel);                                          
-	}
-	else
-    	{
-		festate->rel = NULL;           
-		festate->tupdesc = node->ss.ss_ScanTupleSlot->tts_tupleDescriptor;
+		col->bound = bindable;
+		if (!bindable)
+			festate->has_unbound_cols = true;
+		i++;
+	}
+
+	pfree(ColumnName);
+}
+
+/*
+ * odbc_set_rowset_size
+ *		Configure the statement as a block cursor returning up to fetch_size
+ *		rows per SQLFetch call.
+ *
+ * Bound columns are read straight out of their rowset buffers.  Unbound
+ * columns are read with SQLGetData after positioning the cursor with
+ * SQLSetPos, which requires the SQL_GD_BLOCK extension; if there are such
+ * columns and the driver lacks it, or if the driver refuses the requested
+ * array size, we fall back to whatever it accepts (possibly a single row
+ * per fetch).
+ */
+static void
+odbc_set_rowset_size(odbcFdwExecutionState *festate, int fetch_size)
+{
+	SQLHSTMT	stmt = festate->stmt;
+	SQLULEN		rowset_size = 1;
+	SQLRETURN	ret;
+
+	if (festate->has_unbound_cols && !(festate->getdata_ext & SQL_GD_BLOCK))
+		fetch_size = 1;
+
+	if (fetch_size > 1)
+	{
+		ret = SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE,
+							 (SQLPOINTER) (SQLULEN) fetch_size, 0);
+		if (SQL_SUCCEEDED(ret))
+		{
+			/* The driver may have substituted a smaller value (01S02) */
+			SQLGetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE,
+						   (SQLPOINTER) &rowset_size, 0, NULL);
+			if (rowset_size < 1)
+				rowset_size = 1;
+		}
+	}
+
+	festate->rowset_size = rowset_size;
+	festate->row_status = (SQLUSMALLINT *)
+		palloc0(sizeof(SQLUSMALLINT) * rowset_size);
+	festate->rows_fetched = 0;
+	festate->next_row = 0;
+	festate->current_row = 0;
+	festate->eof_reached = false;
+
+	SQLSetStmtAttr(stmt, SQL_ATTR_ROW_STATUS_PTR,
+				   (SQLPOINTER) festate->row_status, 0);
+	SQLSetStmtAttr(stmt, SQL_ATTR_ROWS_FETCHED_PTR,
+				   (SQLPOINTER) &festate->rows_fetched, 0);
+
+	elog_debug("rowset size %lu (requested %d)",
+			   (unsigned long) rowset_size, fetch_size);
+}
+
+/*
+ * odbc_bind_columns
+ *		Lay out the column-wise rowset buffer and the indicator arrays of the
+ *		bound columns and bind them with SQLBindCol.
+ *
+ * All bound columns share one buffer; each column gets rowset_size
+ * consecutive values starting at its (aligned) offset.  The rowset size
+ * must already be set.
+ */
+static void
+odbc_bind_columns(odbcFdwExecutionState *festate)
+{
+	size_t		total = 0;
+	int			i;
+
+	for (i = 0; i < festate->num_columns; i++)
+	{
+		odbcScanColumn *col = &festate->columns[i];
+
+		if (!col->bound)
+			continue;
+		col->offset = total;
+		total += MAXALIGN((size_t) col->length * festate->rowset_size);
+	}
+
+	festate->rowset_buffer = (char *) palloc(Max(total, 1));
+	festate->indicators = (SQLLEN *)
+		palloc(sizeof(SQLLEN) * festate->rowset_size * Max(festate->num_columns, 1));
+
+	for (i = 0; i < festate->num_columns; i++)
+	{
+		odbcScanColumn *col = &festate->columns[i];
+		SQLRETURN	ret;
+
+		if (!col->bound)
+			continue;
+
+		ret = SQLBindCol(festate->stmt, col->ordinal, col->ctype,
+						 festate->rowset_buffer + col->offset, col->length,
+						 festate->indicators + i * festate->rowset_size);
+		check_return(ret, "Binding ODBC column", festate->stmt, SQL_HANDLE_STMT);
+	}
+}
+
+/*
+ * odbc_fetch_next_row
+ *		Position the cursor on the next row of the result set, fetching a
+ *		new rowset from the driver when the current one is used up.
+ *
+ * Returns SQL_NO_DATA at the end of the result set.
+ */
+static SQLRETURN
+odbc_fetch_next_row(odbcFdwExecutionState *festate)
+{
+	SQLRETURN	ret;
+
+	for (;;)
+	{
+		SQLUSMALLINT status;
+
+		if (festate->next_row >= festate->rows_fetched)
+		{
+			if (festate->eof_reached)
+				return SQL_NO_DATA;
+
+			festate->rows_fetched = 0;
+			festate->next_row = 0;
+			ret = SQLFetch(festate->stmt);
+			if (ret == SQL_NO_DATA)
+			{
+				festate->eof_reached = true;
+				return SQL_NO_DATA;
+			}
+			check_return(ret, "Fetching ODBC rowset", festate->stmt,
+						 SQL_HANDLE_STMT);
+
+			/*
+			 * Some drivers leave SQL_ATTR_ROWS_FETCHED_PTR alone when
+			 * fetching a single row at a time.
+			 */
+			if (festate->rows_fetched == 0 && festate->rowset_size == 1)
+			{
+				festate->rows_fetched = 1;
+				festate->row_status[0] = SQL_ROW_SUCCESS;
+			}
+
+			/* A short rowset means there is nothing more to fetch */
+			if (festate->rows_fetched < festate->rowset_size)
+				festate->eof_reached = true;
+			continue;
+		}
+
+		/* Skip rows the driver flagged as missing or failed */
+		status = festate->row_status[festate->next_row];
+		if (status == SQL_ROW_NOROW || status == SQL_ROW_ERROR ||
+			status == SQL_ROW_DELETED)
+		{
+			festate->next_row++;
+			continue;
+		}
+		break;
+	}
+
+	/* SQLGetData reads from the current cursor row */
+	if (festate->rowset_size > 1 && festate->has_unbound_cols)
+	{
+		ret = SQLSetPos(festate->stmt, (SQLSETPOSIROW) (festate->next_row + 1),
+						SQL_POSITION, SQL_LOCK_NO_CHANGE);
+		check_return(ret, "Positioning in ODBC rowset", festate->stmt,
+					 SQL_HANDLE_STMT);
+	}
+
+	festate->current_row = festate->next_row++;
+	return SQL_SUCCESS;
+}
+
+/*
+ * odbcBeginForeignScan
+ *
+ */
+static void
+odbcBeginForeignScan(ForeignScanState *node, int eflags)
+{
+	SQLHDBC dbc;
+	odbcFdwExecutionState   *festate;
+	SQLSMALLINT result_columns;
+	SQLHSTMT stmt;
+
+#ifdef DEBUG
+	char dsn[256];
+	char desc[256];
+	SQLSMALLINT dsn_ret;
+	SQLSMALLINT desc_ret;
+	SQLUSMALLINT direction;
+#endif
+	
+	int				rtindex;
+	odbcFdwOptions 	options;
+	char	   		*query;
+	Relation 		rel;
+	RangeTblEntry 	*rte;
+	int 			num_of_columns;
+	StringInfoData 	*columns;
+	int 			i;
+	ListCell 		*col_mapping;
+	StringInfoData 	col_str;
+	StringInfoData 	name_qualifier_char;
+	StringInfoData 	quote_char;
+	ForeignScan 	*fsplan = (ForeignScan *) node->ss.ps.plan;
+	EState			*estate = node->ss.ps.state;
+	int 			encoding = -1;
+
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
+	elog_debug("%s", __func__);
+	query = strVal(list_nth(fsplan->fdw_private,
+									 FdwScanPrivateSelectSql));
+	elog_debug("%s", query);
+
+	/* Fetch the foreign table options */
+	if (fsplan->scan.scanrelid > 0)
+ 		rtindex = fsplan->scan.scanrelid; 
+	else 
+		rtindex = bms_next_member(fsplan->fs_relids, -1);
+
+	rte = rt_fetch(rtindex, estate->es_range_table);
+
+	odbcGetTableOptions(rte->relid, &options);
+
+	odbc_connection(&options,  &dbc);
+
+	stmt = odbc_AllocStatement(dbc);
+
+	festate = (odbcFdwExecutionState *) palloc0(sizeof(odbcFdwExecutionState));
+	if (fsplan->scan.scanrelid > 0)
+	{
+		festate->rel = node->ss.ss_currentRelation;
+		festate->tupdesc = RelationGetDescr(festate->rel);                                          
+	}
+	else
+    	{
+		festate->rel = NULL;           
+		festate->tupdesc = node->ss.ss_ScanTupleSlot->tts_tupleDescriptor;
 	}
 	festate->attinmeta = TupleDescGetAttInMetadata(festate->tupdesc);
 	festate->retrieved_attrs = (List *) list_nth(fsplan->fdw_private,
@@ -2064,13 +2986,324 @@ odbcBeginForeignScan(ForeignScanState *node, int eflags)
 	copy_odbcFdwOptions(&(festate->options), &options);
 	festate->stmt = stmt;
 	festate->conn = dbc;
-	festate->num_of_result_cols = result_columns;
-	/* prepare for the first iteration, there will be some precalculation needed in the first iteration*/
-	festate->first_iteration = true;
 	festate->encoding = encoding;
+
+	/*
+	 * A LIMIT the server has no syntax for is left to the driver.  Should it
+	 * not support SQL_ATTR_MAX_ROWS, IterateForeignScan still stops there.
+	 */
+	festate->max_rows = intVal(list_nth(fsplan->fdw_private,
+										FdwScanPrivateMaxRows));
+	if (festate->max_rows > 0)
+		SQLSetStmtAttr(stmt, SQL_ATTR_MAX_ROWS,
+					   (SQLPOINTER) (SQLULEN) festate->max_rows, 0);
+
+	/*
+	 * Retrieve a list of rows.  A query with runtime parameters is only
+	 * prepared here, as the values of its parameters, such as the results
+	 * of initPlans, are not known before the scan is iterated.  It is
+	 * executed by the first IterateForeignScan after this and every rescan.
+	 */
+	festate->query = query;
+	festate->query_cxt = estate->es_query_cxt;
+	festate->numParams = list_length(fsplan->fdw_exprs);
+	if (festate->numParams > 0)
+	{
+		OdbcDialect dialect;
+
+		odbc_get_dialect(&options, dbc, &dialect);
+		festate->params = odbc_prepare_query_params(stmt, query,
+													fsplan->fdw_exprs,
+													(PlanState *) node,
+													dialect.has_boolean,
+													&festate->param_exprs,
+													&festate->has_text_params);
+
+		/* Keep the result for the rescans with the same values */
+		initStringInfo(&festate->key_buf);
+	}
+	else
+	{
+		odbc_execute_scan(festate);
+		festate->query_sent = true;
+	}
+	SQLNumResultCols(stmt, &result_columns);
+	festate->num_of_result_cols = result_columns;
+
+	/*
+	 * Rows are returned as virtual tuples in the scan slot.  Anything
+	 * allocated while building a row goes into temp_cxt, which is reset
+	 * for every row.
+	 */
+	initStringInfo(&festate->col_data);
+	festate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
+											  "odbc_fdw tuple data",
+											  ALLOCSET_DEFAULT_SIZES);
+
+	if (!SQL_SUCCEEDED(SQLGetInfo(dbc, SQL_GETDATA_EXTENSIONS,
+								  (SQLPOINTER) &festate->getdata_ext,
+								  sizeof(festate->getdata_ext), NULL)))
+		festate->getdata_ext = 0;
+
+	/*
+	 * Describe the result columns, then set up the block cursor and bind
+	 * the rowset buffers, all before the first fetch.
+	 */
+	odbc_describe_columns(festate);
+	odbc_set_rowset_size(festate, intVal(list_nth(fsplan->fdw_private,
+												  FdwScanPrivateFetchSize)));
+	odbc_bind_columns(festate);
+
+	/*
+	 * When the executor tells us rescans are to be expected, spool the rows
+	 * of this first execution so that they can be replayed without another
+	 * round trip.  Parameterized scans keep their results in key_cache
+	 * instead.
+	 */
+	if ((eflags & EXEC_FLAG_REWIND) && festate->numParams == 0)
+		odbc_start_spool(festate);
+
 	node->fdw_state = (void *) festate;
 }
 
+/*
+ * odbc_execute_scan
+ *		Run the remote query of a scan, with the parameter values stored by
+ *		odbc_store_query_params, and position it before the first row
+ */
+static void
+odbc_execute_scan(odbcFdwExecutionState *festate)
+{
+	SQLRETURN	ret;
+
+	/* Close the cursor of a previous execution; bindings are kept */
+	SQLFreeStmt(festate->stmt, SQL_CLOSE);
+
+	if (festate->numParams > 0)
+		ret = SQLExecute(festate->stmt);
+	else
+		ret = SQLExecDirect(festate->stmt, (SQLCHAR *) festate->query, SQL_NTS);
+	check_return(ret, "Executing ODBC query", festate->stmt, SQL_HANDLE_STMT);
+
+	festate->rows_fetched = 0;
+	festate->next_row = 0;
+	festate->current_row = 0;
+	festate->eof_reached = false;
+	festate->rows_returned = 0;
+	festate->replaying = false;
+	festate->key_replaying = false;
+}
+
+/*
+ * odbc_send_scan_query
+ *		Evaluate the parameters of a parameterized scan and execute its
+ *		remote query, unless the rows for these values are cached
+ */
+static void
+odbc_send_scan_query(ForeignScanState *node, odbcFdwExecutionState *festate)
+{
+	odbc_store_query_params(festate->stmt, festate->params,
+							festate->param_exprs, festate->has_text_params,
+							node->ss.ps.ps_ExprContext);
+	if (odbc_lookup_key_cache(festate))
+		festate->key_replaying = true;
+	else
+		odbc_execute_scan(festate);
+	festate->query_sent = true;
+}
+
+/*
+ * odbc_lookup_key_cache
+ *		Look up the current parameter values of a parameterized scan in
+ *		key_cache
+ *
+ * Returns true, with key_next set to the first cached row, if the rows for
+ * these values are cached.  Otherwise the scan has to be executed, and
+ * key_entry is set to the entry its rows are to be collected in.
+ */
+static bool
+odbc_lookup_key_cache(odbcFdwExecutionState *festate)
+{
+	odbcKeyCacheKey key;
+	odbcKeyCacheEntry *entry;
+	bool		found;
+	int			i;
+
+	/* The values as bound make the key; they're already canonical */
+	resetStringInfo(&festate->key_buf);
+	for (i = 0; i < festate->numParams; i++)
+	{
+		odbcParamColumn *param = &festate->params[i];
+		SQLLEN		indicator = param->indicators[0];
+
+		appendBinaryStringInfo(&festate->key_buf, (char *) &indicator,
+							   sizeof(indicator));
+		if (indicator != SQL_NULL_DATA)
+			appendBinaryStringInfo(&festate->key_buf, param->values,
+								   (int) indicator);
+	}
+
+	if (festate->key_cache == NULL)
+	{
+		HASHCTL		ctl;
+
+		if (festate->key_cache_cxt == NULL)
+			festate->key_cache_cxt = AllocSetContextCreate(festate->query_cxt,
+														   "odbc_fdw key cache",
+														   ALLOCSET_DEFAULT_SIZES);
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(odbcKeyCacheKey);
+		ctl.entrysize = sizeof(odbcKeyCacheEntry);
+		ctl.hash = key_cache_hash;
+		ctl.match = key_cache_match;
+		ctl.hcxt = festate->key_cache_cxt;
+		festate->key_cache = hash_create("odbc_fdw key cache", 256, &ctl,
+										 HASH_ELEM | HASH_FUNCTION |
+										 HASH_COMPARE | HASH_CONTEXT);
+	}
+
+	key.data = festate->key_buf.data;
+	key.len = festate->key_buf.len;
+	entry = (odbcKeyCacheEntry *) hash_search(festate->key_cache, &key,
+											   HASH_ENTER, &found);
+	if (found && entry->complete)
+	{
+		festate->key_entry = NULL;
+		festate->key_next = list_head(entry->rows);
+		return true;
+	}
+
+	if (!found)
+	{
+		/* The entry points to key_buf; give it a copy of its own */
+		entry->key.data = MemoryContextAlloc(festate->key_cache_cxt, key.len);
+		memcpy(entry->key.data, key.data, key.len);
+		festate->key_cache_size += sizeof(odbcKeyCacheEntry) + key.len;
+	}
+	else
+	{
+		ListCell   *lc;
+
+		/* A previous execution was abandoned before its end */
+		foreach(lc, entry->rows)
+			festate->key_cache_size -=
+				((MinimalTuple) lfirst(lc))->t_len + sizeof(ListCell);
+		list_free_deep(entry->rows);
+	}
+	entry->rows = NIL;
+	entry->complete = false;
+	festate->key_entry = entry;
+	return false;
+}
+
+/*
+ * odbc_cache_row
+ *		Add the row in slot to the key_cache entry of the current execution
+ *
+ * The cache is bounded by work_mem; when it is full, it is emptied and
+ * starts over.
+ */
+static void
+odbc_cache_row(odbcFdwExecutionState *festate, TupleTableSlot *slot)
+{
+	MemoryContext oldcontext;
+	MinimalTuple tuple;
+
+	oldcontext = MemoryContextSwitchTo(festate->key_cache_cxt);
+	tuple = ExecCopySlotMinimalTuple(slot);
+	festate->key_entry->rows = lappend(festate->key_entry->rows, tuple);
+	MemoryContextSwitchTo(oldcontext);
+
+	festate->key_cache_size += tuple->t_len + sizeof(ListCell);
+	if (festate->key_cache_size > (Size) work_mem * 1024L)
+	{
+		elog(DEBUG1, "odbc_fdw: key cache exceeds work_mem, emptying it");
+		odbc_reset_key_cache(festate);
+	}
+}
+
+/*
+ * odbc_reset_key_cache
+ *		Drop all cached results of a parameterized scan
+ */
+static void
+odbc_reset_key_cache(odbcFdwExecutionState *festate)
+{
+	/* The hash table itself lives in key_cache_cxt too */
+	MemoryContextReset(festate->key_cache_cxt);
+	festate->key_cache = NULL;
+	festate->key_cache_size = 0;
+	festate->key_entry = NULL;
+	festate->key_next = NULL;
+}
+
+/*
+ * Hash and match functions for key_cache, whose keys are binary strings.
+ */
+static uint32
+key_cache_hash(const void *key, Size keysize)
+{
+	const odbcKeyCacheKey *k = (const odbcKeyCacheKey *) key;
+
+	return DatumGetUInt32(hash_any((const unsigned char *) k->data, k->len));
+}
+
+static int
+key_cache_match(const void *key1, const void *key2, Size keysize)
+{
+	const odbcKeyCacheKey *k1 = (const odbcKeyCacheKey *) key1;
+	const odbcKeyCacheKey *k2 = (const odbcKeyCacheKey *) key2;
+
+	if (k1->len != k2->len)
+		return 1;
+	return memcmp(k1->data, k2->data, k1->len);
+}
+
+/*
+ * odbc_start_spool
+ *		Begin (or restart) spooling the rows of the current execution.
+ */
+static void
+odbc_start_spool(odbcFdwExecutionState *festate)
+{
+	MemoryContext oldcontext;
+
+	festate->spool_complete = false;
+	if (festate->spool_disabled)
+		return;
+
+	if (festate->spool)
+	{
+		tuplestore_clear(festate->spool);
+		return;
+	}
+
+	oldcontext = MemoryContextSwitchTo(festate->query_cxt);
+	festate->spool = tuplestore_begin_heap(false, false, work_mem);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * odbc_spool_row
+ *		Add the row in slot to the spool.
+ *
+ * A result that does not fit in work_mem is not worth keeping: the spool
+ * is dropped and every later rescan executes the remote query again.
+ */
+static void
+odbc_spool_row(odbcFdwExecutionState *festate, TupleTableSlot *slot)
+{
+	tuplestore_puttupleslot(festate->spool, slot);
+
+	if (!tuplestore_in_memory(festate->spool))
+	{
+		elog(DEBUG1, "odbc_fdw: result exceeds work_mem, rescans will re-execute the remote query");
+		tuplestore_end(festate->spool);
+		festate->spool = NULL;
+		festate->spool_disabled = true;
+	}
+}
+
 /*
  * odbcIterateForeignScan
  *
@@ -2079,299 +3312,554 @@ static TupleTableSlot *
 odbcIterateForeignScan(ForeignScanState *node)
 {
 	TupleDesc       tupdesc;
-	EState *executor_state = node->ss.ps.state;
-	MemoryContext prev_context;
 	/* ODBC API return status */
 	SQLRETURN ret;
 	odbcFdwExecutionState *festate = (odbcFdwExecutionState *) node->fdw_state;
 	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
-	//SQLSMALLINT columns;
-	Datum   	*values;
-	bool		*nulls;
-	HeapTuple   tuple;
-	StringInfoData  col_data;
-	SQLHSTMT stmt = festate->stmt;
-	bool first_iteration = festate->first_iteration;
-	int num_of_result_columns = festate->num_of_result_cols;
-	List *col_position_mask = NIL;
-	List *col_size_array = NIL;
-	List *col_conversion_array = NIL;
+	Datum   	*values = slot->tts_values;
+	bool		*nulls = slot->tts_isnull;
+	MemoryContext oldcontext;
 
 	elog_debug("%s", __func__);
 
-	if (festate->rel)
-		tupdesc = RelationGetDescr(festate->rel);
-	else
+	if (festate->rel)
+		tupdesc = RelationGetDescr(festate->rel);
+	else
+	{
+		tupdesc = festate->tupdesc; 
+	}
+
+	/* If this is the first call after Begin or ReScan, send the query */
+	if (!festate->query_sent)
+		odbc_send_scan_query(node, festate);
+
+	if (festate->replaying)
+	{
+		/* Rescan without new parameters: return the spooled rows */
+		ExecClearTuple(slot);
+		MemoryContextReset(festate->temp_cxt);
+		tuplestore_gettupleslot(festate->spool, true, false, slot);
+		return slot;
+	}
+
+	if (festate->key_replaying)
+	{
+		/* Parameter values seen before: return the cached rows */
+		ExecClearTuple(slot);
+		MemoryContextReset(festate->temp_cxt);
+		if (festate->key_next != NULL)
+		{
+			ExecStoreMinimalTuple((MinimalTuple) lfirst(festate->key_next),
+								  slot, false);
+			festate->key_next = lnext(festate->key_next);
+		}
+		return slot;
+	}
+
+	if (festate->max_rows > 0 && festate->rows_returned >= festate->max_rows)
+		ret = SQL_NO_DATA;
+	else
+		ret = odbc_fetch_next_row(festate);
+
+	/*
+	 * The values of the previous row, still referenced by the slot, live
+	 * in temp_cxt; release them before building the next one.
+	 */
+	ExecClearTuple(slot);
+	MemoryContextReset(festate->temp_cxt);
+
+	if (!SQL_SUCCEEDED(ret))
+	{
+		if (festate->spool)
+			festate->spool_complete = true;
+		if (festate->key_entry)
+		{
+			festate->key_entry->complete = true;
+			festate->key_entry = NULL;
+		}
+		return slot;
+	}
+
+	oldcontext = MemoryContextSwitchTo(festate->temp_cxt);
+	odbc_decode_row(festate, tupdesc, values, nulls);
+	MemoryContextSwitchTo(oldcontext);
+
+	/*
+	 * Store the values as a virtual tuple; they remain valid until the
+	 * reset of temp_cxt on the next call.  No heap tuple is formed unless
+	 * something upstream needs to materialize the slot.
+	 */
+	ExecStoreVirtualTuple(slot);
+	festate->rows_returned++;
+
+	if (festate->spool)
+		odbc_spool_row(festate, slot);
+	else if (festate->key_entry)
+		odbc_cache_row(festate, slot);
+
+	return slot;
+}
+
+/*
+ * odbc_decode_row
+ *		Build the values of the current row of the cursor in values and
+ *		nulls, which are indexed by attribute number of tupdesc.
+ *
+ * Attributes not retrieved are set to NULL.  Values are allocated in the
+ * current memory context.
+ */
+static void
+odbc_decode_row(odbcFdwExecutionState *festate, TupleDesc tupdesc,
+				Datum *values, bool *nulls)
+{
+	SQLULEN		row = festate->current_row;
+	int			i;
+
+	memset(nulls, true, tupdesc->natts * sizeof(bool));
+	for (i = 0; i < festate->num_columns; i++)
+	{
+		odbcScanColumn *col = &festate->columns[i];
+		char	   *value;
+
+		if (col->bound)
+		{
+			/* Take the value straight out of the rowset buffer */
+			SQLLEN		indicator = festate->indicators[i * festate->rowset_size + row];
+
+			if (indicator == SQL_NULL_DATA)
+				continue;
+			if (col->ctype == SQL_C_CHAR &&
+				(indicator == SQL_NO_TOTAL || indicator >= col->length))
+			{
+				/* Truncated: read the whole value again, if we may */
+				if (!odbc_can_get_bound_data(festate))
+					ereport(ERROR,
+					        (errcode(ERRCODE_FDW_INVALID_STRING_LENGTH_OR_BUFFER_LENGTH),
+					         errmsg("value of column %d does not fit in its buffer of %d bytes",
+									col->ordinal, col->length - 1)
+					        ));
+				value = odbc_get_column_data(festate, col->ordinal,
+											 col->length - 1);
+				if (value == NULL)
+					continue;
+			}
+			else
+				value = festate->rowset_buffer + col->offset + row * col->length;
+		}
+		else
+		{
+			value = odbc_get_column_data(festate, col->ordinal, col->length - 1);
+			if (value == NULL)
+				continue;
+		}
+
+		nulls[col->attnum - 1] = false;
+		values[col->attnum - 1] = col->decode(festate, col, value);
+	}
+}
+
+/*
+ * odbc_can_get_bound_data
+ *		Can the value of a bound column of the current row be read again
+ *		with SQLGetData?
+ *
+ * That takes SQL_GD_BOUND, and SQL_GD_BLOCK to position the cursor on a
+ * row of a block cursor, which is done here.  Columns are read in
+ * increasing order, so reading a bound column before the unbound ones
+ * that follow it needs nothing more.
+ */
+static bool
+odbc_can_get_bound_data(odbcFdwExecutionState *festate)
+{
+	SQLRETURN	ret;
+
+	if (!(festate->getdata_ext & SQL_GD_BOUND))
+		return false;
+	if (festate->rowset_size > 1)
 	{
-		tupdesc = festate->tupdesc; 
+		if (!(festate->getdata_ext & SQL_GD_BLOCK))
+			return false;
+		ret = SQLSetPos(festate->stmt,
+						(SQLSETPOSIROW) (festate->current_row + 1),
+						SQL_POSITION, SQL_LOCK_NO_CHANGE);
+		check_return(ret, "Positioning in ODBC rowset", festate->stmt,
+					 SQL_HANDLE_STMT);
 	}
+	return true;
+}
 
-	ret = SQLFetch(stmt);
+/*
+ * odbc_get_column_data
+ *		Read the value of an unbound column of the current row with
+ *		SQLGetData, piece by piece if it does not fit in col_size bytes.
+ *
+ * Returns a palloc'd zero-terminated string, or NULL for a NULL value.
+ */
+static char *
+odbc_get_column_data(odbcFdwExecutionState *festate, SQLUSMALLINT column,
+					 int col_size)
+{
+	SQLHSTMT	stmt = festate->stmt;
+	SQLLEN		indicator;
+	SQLRETURN	ret;
+	char	   *buf;
 
-	/*
-	 * If this is the first iteration,
-	 * we need to calculate the mask for column mapping as well as the column size
-	 */
-	if (first_iteration == true)
-	{
-		SQLCHAR *ColumnName;
-		SQLSMALLINT NameLengthPtr;
-		SQLSMALLINT DataTypePtr;
-		SQLULEN     ColumnSizePtr;
-		SQLSMALLINT DecimalDigitsPtr;
-		SQLSMALLINT NullablePtr;
-		int i;
-		int k;
-		bool found;
+	buf = (char *) palloc(sizeof(char) * (col_size+1));
+
+	/* retrieve column data as a zero-terminated string */
+	buf[0] = 0;
+	ret = SQLGetData(stmt, column, SQL_C_CHAR,
+	                 buf, sizeof(char) * (col_size+1), &indicator);
 
-		StringInfoData sql_type;
-		SQLULEN min_size;
-		SQLULEN max_size = MAXIMUM_BUFFER_SIZE;
-		/* Allocate memory for the masks in a memory context that
-		   persists between IterateForeignScan calls */
-		prev_context = MemoryContextSwitchTo(executor_state->es_query_cxt);
-		col_position_mask = NIL;
-		col_size_array = NIL;
-		col_conversion_array = NIL;
-		/* Obtain the column information of the first row. */
-		for (i = 1; i <= num_of_result_columns; i++)
+	if (ret == SQL_SUCCESS_WITH_INFO)
+	{
+		SQLCHAR sqlstate[6];
+		SQLGetDiagRec(SQL_HANDLE_STMT, stmt, 1, sqlstate, NULL, NULL, 0, NULL);
+		if (strcmp((char*)sqlstate, ODBC_SQLSTATE_FRACTIONAL_TRUNCATION) == 0)
 		{
-			ColumnConversion conversion = TEXT_CONVERSION;
-			found = false;
-			ColumnName = (SQLCHAR *) palloc(sizeof(SQLCHAR) * MAXIMUM_COLUMN_NAME_LEN);
-			SQLDescribeCol(stmt,
-			               i,                       /* ColumnName */
-			               ColumnName,
-			               sizeof(SQLCHAR) * MAXIMUM_COLUMN_NAME_LEN, /* BufferLength */
-			               &NameLengthPtr,
-			               &DataTypePtr,
-			               &ColumnSizePtr,
-			               &DecimalDigitsPtr,
-			               &NullablePtr);
-
-			sql_data_type(DataTypePtr, ColumnSizePtr, DecimalDigitsPtr, NullablePtr,
-						  &sql_type);
-			if (strcmp("bytea", (char*)sql_type.data) == 0)
+			/* Fractional truncation has occured;
+			 * at this point we cannot obtain the lost digits
+			 */
+			if (buf[col_size])
 			{
-				conversion = HEX_CONVERSION;
+				/* The driver has omitted the trailing */
+				char *buf2 = (char *) palloc(sizeof(char) * (col_size+2));
+				strncpy(buf2, buf, col_size+1);
+				buf2[col_size+1] = 0;
+				pfree(buf);
+				buf = buf2;
 			}
-			if (strcmp("boolean", (char*)sql_type.data) == 0)
+			elog(NOTICE,"Truncating number: %s",buf);
+		}
+		else
+		{
+			/* The output is incomplete, we need to obtain the rest of the data */
+			char* accum_buffer;
+			size_t accum_buffer_size;
+			size_t accum_used = 0;
+			if (indicator == SQL_NO_TOTAL)
 			{
-				conversion = BOOL_CONVERSION;
+				/* Unknown total size, must copy part by part */
+				accum_buffer_size = 0;
+				accum_buffer = NULL;
+				while (1)
+				{
+					size_t buf_len = buf[col_size] ? col_size + 1 : col_size;
+					// Allocate new accumulation buffer if necessary
+					if (accum_used + buf_len > accum_buffer_size)
+					{
+						char *new_buff;
+						accum_buffer_size = accum_buffer_size == 0 ?
+											 col_size*2 : accum_buffer_size*2;
+						new_buff = (char *) palloc(sizeof(char) * (accum_buffer_size+1));
+						if (accum_buffer)
+						{
+							memmove(new_buff, accum_buffer, accum_used);
+							pfree(accum_buffer);
+						}
+						accum_buffer = new_buff;
+						accum_buffer[accum_used] = 0;
+					}
+					// Copy part to the accumulation buffer
+					strncpy(accum_buffer+accum_used, buf, buf_len);
+					accum_used += buf_len;
+					accum_buffer[accum_used] = 0;
+					// Get new part
+					if (ret != SQL_SUCCESS_WITH_INFO)
+						break;
+					ret = SQLGetData(stmt, column, SQL_C_CHAR, buf,
+									 sizeof(char) * (col_size+1), &indicator);
+				};
+
 			}
-			else if (strncmp("bit(",(char*)sql_type.data,4)==0 ||
-					 strncmp("varbit(",(char*)sql_type.data,7)==0)
+			else
 			{
-				conversion = BIN_CONVERSION;
+				/* We need to retrieve indicator more characters */
+				size_t buf_len = buf[col_size] ? col_size + 1 : col_size;
+				accum_buffer_size = buf_len + indicator;
+				accum_buffer = (char *) palloc(sizeof(char)*(accum_buffer_size+1));
+				strncpy(accum_buffer, buf, buf_len);
+				accum_buffer[buf_len] = 0;
+				ret = SQLGetData(stmt, column, SQL_C_CHAR, accum_buffer+buf_len, 
+								 sizeof(char)*(indicator+1), &indicator);
 			}
+			pfree(buf);
+			buf = accum_buffer;
+		}
+	}
 
-			min_size = minimum_buffer_size(DataTypePtr);
-			
-			col_position_mask = lappend_int(col_position_mask, i-1);
-			if (ColumnSizePtr < min_size)
-				ColumnSizePtr = min_size;
-			if (ColumnSizePtr > max_size)
-				ColumnSizePtr = max_size;
+	if (!SQL_SUCCEEDED(ret) || indicator == SQL_NULL_DATA)
+	{
+		pfree(buf);
+		return NULL;
+	}
 
-			col_size_array = lappend_int(col_size_array, (int) ColumnSizePtr);
-			col_conversion_array = lappend_int(col_conversion_array, (int) conversion);
+	return buf;
+}
 
-			pfree(ColumnName);
-		}
+/*
+ * odbc_native_ctype
+ *		Choose the ODBC C type used to bind a result column of the given SQL
+ *		type that is stored into an attribute of type pgtype.
+ *
+ * Returns SQL_C_CHAR if the value must go through the text representation
+ * and the type's input function.  Types with a typmod that would need to
+ * be applied (time and timestamp precision) also use the text path.
+ */
+static SQLSMALLINT
+odbc_native_ctype(SQLSMALLINT odbc_data_type, SQLSMALLINT decimal_digits,
+				  Oid pgtype, int32 pgtypmod)
+{
+	switch (odbc_data_type)
+	{
+		case SQL_SMALLINT:
+		case SQL_TINYINT:
+			if (pgtype == INT2OID)
+				return SQL_C_SSHORT;
+			/* FALLTHROUGH */
+		case SQL_INTEGER:
+			if (pgtype == INT4OID)
+				return SQL_C_SLONG;
+			/* FALLTHROUGH */
+		case SQL_BIGINT:
+			if (pgtype == INT8OID)
+				return SQL_C_SBIGINT;
+			break;
+		case SQL_REAL:
+			if (pgtype == FLOAT4OID)
+				return SQL_C_FLOAT;
+			/* FALLTHROUGH */
+		case SQL_FLOAT:
+		case SQL_DOUBLE:
+			if (pgtype == FLOAT8OID)
+				return SQL_C_DOUBLE;
+			break;
+		case SQL_TYPE_DATE:
+		case SQL_DATE:
+			if (pgtype == DATEOID)
+				return SQL_C_TYPE_DATE;
+			break;
+		case SQL_TYPE_TIME:
+		case SQL_TIME:
+			/* SQL_TIME_STRUCT has no fractional seconds */
+			if (pgtype == TIMEOID && pgtypmod < 0 && decimal_digits == 0)
+				return SQL_C_TYPE_TIME;
+			break;
+		case SQL_TYPE_TIMESTAMP:
+		case SQL_TIMESTAMP:
+			if (pgtype == TIMESTAMPOID && pgtypmod < 0)
+				return SQL_C_TYPE_TIMESTAMP;
+			break;
+		case SQL_BIT:
+			if (pgtype == BOOLOID)
+				return SQL_C_BIT;
+			break;
+		case SQL_GUID:
+			if (pgtype == UUIDOID)
+				return SQL_C_GUID;
+			break;
+	}
 
-		festate->col_position_mask = col_position_mask;
-		festate->col_size_array = col_size_array;
-		festate->col_conversion_array = col_conversion_array;
-		festate->first_iteration = false;
+	return SQL_C_CHAR;
+}
 
-		MemoryContextSwitchTo(prev_context);
-	}
-	else
+/*
+ * odbc_native_decoder
+ *		Decoder and buffer length of a column bound as one of the native C
+ *		types chosen by odbc_native_ctype.
+ */
+static odbcColumnDecoder
+odbc_native_decoder(SQLSMALLINT ctype, int *length)
+{
+	switch (ctype)
 	{
-		col_position_mask = festate->col_position_mask;
-		col_size_array = festate->col_size_array;
-		col_conversion_array = festate->col_conversion_array;
+		case SQL_C_SSHORT:
+			*length = sizeof(SQLSMALLINT);
+			return odbc_decode_int2;
+		case SQL_C_SLONG:
+			*length = sizeof(SQLINTEGER);
+			return odbc_decode_int4;
+		case SQL_C_SBIGINT:
+			*length = sizeof(SQLBIGINT);
+			return odbc_decode_int8;
+		case SQL_C_FLOAT:
+			*length = sizeof(SQLREAL);
+			return odbc_decode_float4;
+		case SQL_C_DOUBLE:
+			*length = sizeof(SQLDOUBLE);
+			return odbc_decode_float8;
+		case SQL_C_TYPE_DATE:
+			*length = sizeof(SQL_DATE_STRUCT);
+			return odbc_decode_date;
+		case SQL_C_TYPE_TIME:
+			*length = sizeof(SQL_TIME_STRUCT);
+			return odbc_decode_time;
+		case SQL_C_TYPE_TIMESTAMP:
+			*length = sizeof(SQL_TIMESTAMP_STRUCT);
+			return odbc_decode_timestamp;
+		case SQL_C_BIT:
+			*length = sizeof(SQLCHAR);
+			return odbc_decode_bool;
+		case SQL_C_GUID:
+			*length = sizeof(SQLGUID);
+			return odbc_decode_uuid;
+		default:
+			elog(ERROR, "unexpected ODBC C type %d", ctype);
 	}
+	return NULL;				/* keep compiler quiet */
+}
 
-	ExecClearTuple(slot);
-	if (SQL_SUCCEEDED(ret))
+/*
+ * Column decoders, see odbcColumnDecoder.
+ */
+static Datum
+odbc_decode_text(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				 char *value)
+{
+	if (festate->encoding != -1)
 	{
-		SQLSMALLINT i;
-		ListCell	*lc;
-		int			j;
+		/* Convert character encoding */
+		value = pg_any_to_server(value, strlen(value), festate->encoding);
+	}
 
-		values = (Datum *)palloc(sizeof(Datum) * tupdesc->natts );
-		nulls = (bool *) palloc(sizeof(bool) * tupdesc->natts );
-		memset(nulls, true, tupdesc->natts * sizeof(bool));
-		/* Loop through the num_of_result_columns */
-		i = 0;
-		foreach(lc,festate->retrieved_attrs)
-		{
-			SQLLEN indicator;
-			char * buf;
+	return InputFunctionCall(col->infunc, value, col->ioparam, col->typmod);
+}
 
-			j = lfirst_int(lc);
-			int col_size = list_nth_int(col_size_array, i);
-			int mapped_pos = list_nth_int(col_position_mask, i);
-			ColumnConversion conversion = list_nth_int(col_conversion_array, i);
+static Datum
+odbc_decode_hex(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				char *value)
+{
+	resetStringInfo(&festate->col_data);
+	appendStringInfoString(&festate->col_data, "\\x");
+	appendStringInfoString(&festate->col_data, value);
 
-			/* Ignore this column if position is marked as invalid */
-			if (mapped_pos == -1)
-				continue;
+	return odbc_decode_text(festate, col, festate->col_data.data);
+}
 
-			buf = (char *) palloc(sizeof(char) * (col_size+1));
-
-			/* retrieve column data as a zero-terminated string */
-			/* TODO:
-			   binary fields (SQL_C_BIT, SQL_C_BINARY) do not have
-			   a trailing zero; they should be copied as now but without
-			   adding 1 to col_size, or using SQL_C_BIT or SQL_C_BINARY
-			   and then encoded into a binary PG literal (e.g. X'...'
-			   or B'...')
-			   For floating point types we should use SQL_C_FLOAT/SQL_C_DOUBLE
-			   to avoid precision loss.
-			   For date/time/timestamp these structures can be used:
-			   SQL_C_TYPE_DATE/SQL_C_TYPE_TIME/SQL_C_TYPE_TIMESTAMP.
-			   And finally, SQL_C_NUMERIC and SQL_C_GUID could also be used.
-			*/
-			buf[0] = 0;
-			ret = SQLGetData(stmt, i+1, SQL_C_CHAR,
-			                 buf, sizeof(char) * (col_size+1), &indicator);
-
-			if (ret == SQL_SUCCESS_WITH_INFO)
-			{
-				SQLCHAR sqlstate[5];
-				SQLGetDiagRec(SQL_HANDLE_STMT, stmt, 1, sqlstate, NULL, NULL, 0, NULL);
-				if (strcmp((char*)sqlstate, ODBC_SQLSTATE_FRACTIONAL_TRUNCATION) == 0)
-				{
-					/* Fractional truncation has occured;
-					 * at this point we cannot obtain the lost digits
-					 */
-					if (buf[col_size])
-					{
-						/* The driver has omitted the trailing */
-						char *buf2 = (char *) palloc(sizeof(char) * (col_size+2));
-						strncpy(buf2, buf, col_size+1);
-						buf2[col_size+1] = 0;
-						pfree(buf);
-						buf = buf2;
-					}
-					elog(NOTICE,"Truncating number: %s",buf);
-				}
-				else
-				{
-					/* The output is incomplete, we need to obtain the rest of the data */
-					char* accum_buffer;
-					size_t accum_buffer_size;
-					size_t accum_used = 0;
-					if (indicator == SQL_NO_TOTAL)
-					{
-						/* Unknown total size, must copy part by part */
-						accum_buffer_size = 0;
-						accum_buffer = NULL;
-						while (1)
-						{
-							size_t buf_len = buf[col_size] ? col_size + 1 : col_size;
-							// Allocate new accumulation buffer if necessary
-							if (accum_used + buf_len > accum_buffer_size)
-							{
-								char *new_buff;
-								accum_buffer_size = accum_buffer_size == 0 ?
-													 col_size*2 : accum_buffer_size*2;
-								new_buff = (char *) palloc(sizeof(char) * (accum_buffer_size+1));
-								if (accum_buffer)
-								{
-									memmove(new_buff, accum_buffer, accum_used);
-									pfree(accum_buffer);
-								}
-								accum_buffer = new_buff;
-								accum_buffer[accum_used] = 0;
-							}
-							// Copy part to the accumulation buffer
-							strncpy(accum_buffer+accum_used, buf, buf_len);
-							accum_used += buf_len;
-							accum_buffer[accum_used] = 0;
-							// Get new part
-							if (ret != SQL_SUCCESS_WITH_INFO)
-								break;
-							ret = SQLGetData(stmt, i+1, SQL_C_CHAR, buf,
-											 sizeof(char) * (col_size+1), &indicator);
-						};
+static Datum
+odbc_decode_bit_text(odbcFdwExecutionState *festate, odbcScanColumn *col,
+					 char *value)
+{
+	/* Some drivers return SQL_BIT data as a raw 0/1 byte */
+	if (value[0] == 0)
+		value = "F";
+	else if (value[0] == 1)
+		value = "T";
 
-					}
-					else
-					{
-						/* We need to retrieve indicator more characters */
-						size_t buf_len = buf[col_size] ? col_size + 1 : col_size;
-						accum_buffer_size = buf_len + indicator;
-						accum_buffer = (char *) palloc(sizeof(char)*(accum_buffer_size+1));
-						strncpy(accum_buffer, buf, buf_len);
-						accum_buffer[buf_len] = 0;
-						ret = SQLGetData(stmt, i+1, SQL_C_CHAR, accum_buffer+buf_len, 
-										 sizeof(char)*(indicator+1), &indicator);
-					}
-					pfree(buf);
-					buf = accum_buffer;
-				}
-			}
+	return odbc_decode_text(festate, col, value);
+}
 
-			if (SQL_SUCCEEDED(ret))
-			{
-				/* Handle null columns */
-				if (indicator == SQL_NULL_DATA)
-				{
-					// BuildTupleFromCStrings expects NULLs to be NULL pointers
-					values[j-1] = (Datum)NULL;
-				}
-				else
-				{
-					if (festate->encoding != -1)
-					{
-						/* Convert character encoding */
-						buf = pg_any_to_server(buf, strlen(buf), festate->encoding);
-					}
+static Datum
+odbc_decode_int2(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				 char *value)
+{
+	return Int16GetDatum(*(SQLSMALLINT *) value);
+}
 
-					initStringInfo(&col_data);
-					switch (conversion)
-					{
-						case TEXT_CONVERSION :
-						appendStringInfoString (&col_data, buf);
-						break;
-						case HEX_CONVERSION :
-						appendStringInfoString (&col_data, "\\x");
-						appendStringInfoString (&col_data, buf);
-						break;
-						case BOOL_CONVERSION :
-						if (buf[0] == 0)
-							strcpy(buf, "F");
-						else if (buf[0] == 1)
-							strcpy(buf, "T");
-						appendStringInfoString (&col_data, buf);
-						break;
-						case BIN_CONVERSION :
-						ereport(ERROR,
-						        (errcode(ERRCODE_FDW_INVALID_DATA_TYPE),
-						         errmsg("Bit string columns are not supported")
-						        ));
-						break;
-					}
-					nulls[j-1] = false;
-					values[j-1] =  InputFunctionCall(&(festate->attinmeta->attinfuncs[j - 1]),
-															col_data.data,
-															festate->attinmeta->attioparams[j - 1],
-															festate->attinmeta->atttypmods[j - 1]);
-				}
-			}
-			pfree(buf);
-			i++;
-		}
+static Datum
+odbc_decode_int4(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				 char *value)
+{
+	return Int32GetDatum(*(SQLINTEGER *) value);
+}
 
-		tuple  = heap_form_tuple(tupdesc, values, nulls);
-		ExecStoreTuple(tuple, slot, InvalidBuffer, false);
-		pfree(values);
-	}
+static Datum
+odbc_decode_int8(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				 char *value)
+{
+	return Int64GetDatum(*(SQLBIGINT *) value);
+}
 
-	return slot;
+static Datum
+odbc_decode_float4(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				   char *value)
+{
+	return Float4GetDatum(*(SQLREAL *) value);
+}
+
+static Datum
+odbc_decode_float8(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				   char *value)
+{
+	return Float8GetDatum(*(SQLDOUBLE *) value);
+}
+
+static Datum
+odbc_decode_date(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				 char *value)
+{
+	SQL_DATE_STRUCT *d = (SQL_DATE_STRUCT *) value;
+
+	if (!IS_VALID_JULIAN(d->year, d->month, d->day))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+				 errmsg("date out of range")));
+	return DateADTGetDatum(date2j(d->year, d->month, d->day) -
+						   POSTGRES_EPOCH_JDATE);
+}
+
+static Datum
+odbc_decode_time(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				 char *value)
+{
+	SQL_TIME_STRUCT *t = (SQL_TIME_STRUCT *) value;
+
+	return TimeADTGetDatum(((((int64) t->hour * MINS_PER_HOUR) +
+							 t->minute) * SECS_PER_MINUTE +
+							t->second) * USECS_PER_SEC);
+}
+
+static Datum
+odbc_decode_timestamp(odbcFdwExecutionState *festate, odbcScanColumn *col,
+					  char *value)
+{
+	SQL_TIMESTAMP_STRUCT *ts = (SQL_TIMESTAMP_STRUCT *) value;
+	struct pg_tm tm;
+	fsec_t		fsec;
+	Timestamp	result;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = ts->year;
+	tm.tm_mon = ts->month;
+	tm.tm_mday = ts->day;
+	tm.tm_hour = ts->hour;
+	tm.tm_min = ts->minute;
+	tm.tm_sec = ts->second;
+	/* fraction is in nanoseconds, round it like timestamp_in */
+	fsec = (fsec_t) ((ts->fraction + 500) / 1000);
+
+	if (tm2timestamp(&tm, fsec, NULL, &result) != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+				 errmsg("timestamp out of range")));
+	return TimestampGetDatum(result);
+}
+
+static Datum
+odbc_decode_bool(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				 char *value)
+{
+	return BoolGetDatum(*(SQLCHAR *) value != 0);
+}
+
+static Datum
+odbc_decode_uuid(odbcFdwExecutionState *festate, odbcScanColumn *col,
+				 char *value)
+{
+	SQLGUID    *guid = (SQLGUID *) value;
+	pg_uuid_t  *uuid = (pg_uuid_t *) palloc(sizeof(pg_uuid_t));
+
+	/* uuid is stored in network byte order */
+	uuid->data[0] = (guid->Data1 >> 24) & 0xff;
+	uuid->data[1] = (guid->Data1 >> 16) & 0xff;
+	uuid->data[2] = (guid->Data1 >> 8) & 0xff;
+	uuid->data[3] = guid->Data1 & 0xff;
+	uuid->data[4] = (guid->Data2 >> 8) & 0xff;
+	uuid->data[5] = guid->Data2 & 0xff;
+	uuid->data[6] = (guid->Data3 >> 8) & 0xff;
+	uuid->data[7] = guid->Data3 & 0xff;
+	memcpy(uuid->data + 8, guid->Data4, 8);
+	return UUIDPGetDatum(uuid);
 }
 
 /*
@@ -2397,7 +3885,18 @@ odbcExplainForeignScan(ForeignScanState *node, ExplainState *es)
 	{
 		List       *fdw_private = ((ForeignScan *) node->ss.ps.plan)->fdw_private; 
 		char	   *sql = strVal(list_nth(fdw_private, FdwScanPrivateSelectSql));
-		ExplainPropertyText("Remote SQL", sql, es);                                                                         
+		long		max_rows = intVal(list_nth(fdw_private,
+											   FdwScanPrivateMaxRows));
+
+		/* For a join or upper relation, show what was pushed down */
+		if (list_length(fdw_private) > FdwScanPrivateRelations)
+			ExplainPropertyText("Relations",
+								strVal(list_nth(fdw_private,
+												FdwScanPrivateRelations)),
+								es);
+		ExplainPropertyText("Remote SQL", sql, es);
+		if (max_rows > 0)
+			ExplainPropertyLong("Remote Max Rows", max_rows, es);
         }
 }
 
@@ -2416,29 +3915,336 @@ odbcEndForeignScan(ForeignScanState *node)
 	festate = (odbcFdwExecutionState *) node->fdw_state;
 	if (festate)
 	{
+		if (festate->spool)
+		{
+			tuplestore_end(festate->spool);
+			festate->spool = NULL;
+		}
+
 		if (festate->stmt)
 		{
-			SQLFreeHandle(SQL_HANDLE_STMT, festate->stmt);
+			odbc_FreeStatement(festate->conn, festate->stmt);
 			festate->stmt = NULL;
 		}
 
-		if (festate->conn)
-		{
-			SQLDisconnect(festate->conn);
-			SQLFreeHandle(SQL_HANDLE_DBC, festate->conn);
-			festate->conn = NULL;
-		}
+		if (festate->conn)
+		{
+			odbc_ReleaseConnection(festate->conn);
+			festate->conn = NULL;
+		}
+	}
+}
+
+/*
+ * odbcReScanForeignScan
+ *      Rescan table, possibly with new parameters
+ */
+static void
+odbcReScanForeignScan(ForeignScanState *node)
+{
+	odbcFdwExecutionState *festate = (odbcFdwExecutionState *) node->fdw_state;
+
+	elog_debug("%s", __func__);
+
+	/*
+	 * A parameterized scan, typically the inner side of a nested loop, is
+	 * rescanned for each outer row.  Its parameters are evaluated by the
+	 * next IterateForeignScan, which only goes to the remote server for
+	 * values whose rows aren't cached yet.
+	 */
+	if (festate->numParams > 0)
+	{
+		festate->query_sent = false;
+		festate->key_replaying = false;
+		festate->key_entry = NULL;
+		return;
+	}
+
+	/* If the last execution was spooled in full, replay it */
+	if (festate->spool && festate->spool_complete)
+	{
+		festate->replaying = true;
+		tuplestore_rescan(festate->spool);
+		return;
+	}
+
+	/*
+	 * Otherwise execute the remote query again.  Column bindings and
+	 * statement attributes survive closing the cursor.
+	 */
+	odbc_execute_scan(festate);
+
+	/* A scan rescanned once is likely to be rescanned again */
+	odbc_start_spool(festate);
+}
+
+/*
+ * odbcAnalyzeForeignTable
+ *		Test whether analyzing this foreign table is supported
+ */
+static bool
+odbcAnalyzeForeignTable(Relation relation,
+						AcquireSampleRowsFunc *func,
+						BlockNumber *totalpages)
+{
+	elog_debug("%s", __func__);
+
+	/* Return the row-analysis function pointer */
+	*func = odbcAcquireSampleRows;
+
+	/*
+	 * ODBC has no way to ask for the size of a table in pages.  Report one
+	 * page; odbcGetForeignRelSize works the pages out from the row count.
+	 */
+	*totalpages = 1;
+
+	return true;
+}
+
+/*
+ * odbcAcquireSampleRows
+ *		Acquire a random sample of rows from the foreign table
+ *
+ * Selected rows are returned in the caller-allocated array rows[], which
+ * must have at least targrows entries.  The actual number of rows selected
+ * is returned as the function result.  We also count the total number of
+ * rows in the table and return it into *totalrows.  Note that
+ * *totaldeadrows is always set to 0.
+ *
+ * Where the server can sample a table itself, only about the fraction of
+ * the rows that makes up the sample is fetched; that needs the remote row
+ * count first.  Otherwise all rows are streamed through, a rowset at a time.
+ * Either way the rows fetched are reduced to targrows by reservoir sampling,
+ * and only those kept are converted.
+ */
+static int
+odbcAcquireSampleRows(Relation relation, int elevel,
+					  HeapTuple *rows, int targrows,
+					  double *totalrows,
+					  double *totaldeadrows)
+{
+	odbcFdwExecutionState *festate;
+	odbcFdwOptions options;
+	OdbcDialect dialect;
+	OdbcSampleMethod method;
+	SQLHDBC		dbc;
+	SQLSMALLINT result_columns;
+	StringInfoData sql;
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	Datum	   *values;
+	bool	   *nulls;
+	double		reltuples = -1;
+	double		sample_frac = 1.0;
+	double		samplerows = 0;
+	double		rowstoskip = -1;
+	int			numrows = 0;
+	ReservoirStateData rstate;
+	MemoryContext anl_cxt = CurrentMemoryContext;
+	MemoryContext oldcontext;
+
+	elog_debug("%s", __func__);
+
+	odbcGetTableOptions(RelationGetRelid(relation), &options);
+	odbc_connection(&options, &dbc);
+	odbc_get_dialect(&options, dbc, &dialect);
+
+	method = odbc_sample_method(options.analyze_sampling);
+	if (method == ODBC_SAMPLE_AUTO)
+		method = dialect.sample_method;
+
+	/*
+	 * Ask for a little more than the sample size, so that the sample is
+	 * still full when the server returns fewer rows than the fraction
+	 * suggests.  A table not much larger than the sample is read in full.
+	 */
+	if (method != ODBC_SAMPLE_OFF)
+	{
+		reltuples = odbc_count_remote_rows(dbc, relation, &options);
+		if (reltuples > 0)
+			sample_frac = 1.1 * targrows / reltuples;
+		if (reltuples <= 0 || sample_frac >= 1.0)
+			method = ODBC_SAMPLE_OFF;
+	}
+
+	festate = (odbcFdwExecutionState *) palloc0(sizeof(odbcFdwExecutionState));
+	festate->rel = relation;
+	festate->tupdesc = tupdesc;
+	festate->attinmeta = TupleDescGetAttInMetadata(tupdesc);
+	copy_odbcFdwOptions(&(festate->options), &options);
+	festate->conn = dbc;
+	festate->encoding = -1;
+
+	initStringInfo(&sql);
+	odbc_deparseAnalyzeSql(&sql, relation, &dialect, method, sample_frac,
+						   &festate->retrieved_attrs);
+	festate->query = sql.data;
+	elog_debug("%s", festate->query);
+
+	festate->stmt = odbc_AllocStatement(dbc);
+	odbc_execute_scan(festate);
+	SQLNumResultCols(festate->stmt, &result_columns);
+	festate->num_of_result_cols = result_columns;
+
+	/* Rows are converted in temp_cxt, then copied out as heap tuples */
+	initStringInfo(&festate->col_data);
+	festate->temp_cxt = AllocSetContextCreate(CurrentMemoryContext,
+											  "odbc_fdw analyze data",
+											  ALLOCSET_DEFAULT_SIZES);
+
+	if (!SQL_SUCCEEDED(SQLGetInfo(dbc, SQL_GETDATA_EXTENSIONS,
+								  (SQLPOINTER) &festate->getdata_ext,
+								  sizeof(festate->getdata_ext), NULL)))
+		festate->getdata_ext = 0;
+
+	odbc_describe_columns(festate);
+	odbc_set_rowset_size(festate, options.fetch_size > 0 ? options.fetch_size
+														 : DEFAULT_FETCH_SIZE);
+	odbc_bind_columns(festate);
+
+	values = (Datum *) palloc(tupdesc->natts * sizeof(Datum));
+	nulls = (bool *) palloc(tupdesc->natts * sizeof(bool));
+
+	/* Prepare for sampling rows */
+	reservoir_init_selection_state(&rstate, targrows);
+
+	while (SQL_SUCCEEDED(odbc_fetch_next_row(festate)))
+	{
+		int			pos;
+
+		/* Allow users to cancel long query */
+		vacuum_delay_point();
+
+		samplerows += 1;
+
+		/*
+		 * The first targrows rows are simply collected.  After that, each
+		 * row replaces a random one of the sample with decreasing
+		 * probability (Vitter's algorithm, see analyze.c); the rows in
+		 * between are skipped without being converted.
+		 */
+		if (numrows < targrows)
+			pos = numrows++;
+		else
+		{
+			if (rowstoskip < 0)
+				rowstoskip = reservoir_get_next_S(&rstate, samplerows, targrows);
+
+			if (rowstoskip <= 0)
+			{
+				pos = (int) (targrows * sampler_random_fract(rstate.randstate));
+				Assert(pos >= 0 && pos < targrows);
+				heap_freetuple(rows[pos]);
+			}
+			else
+				pos = -1;
+
+			rowstoskip -= 1;
+		}
+
+		if (pos < 0)
+			continue;
+
+		MemoryContextReset(festate->temp_cxt);
+		oldcontext = MemoryContextSwitchTo(festate->temp_cxt);
+		odbc_decode_row(festate, tupdesc, values, nulls);
+		MemoryContextSwitchTo(anl_cxt);
+		rows[pos] = heap_form_tuple(tupdesc, values, nulls);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	odbc_FreeStatement(dbc, festate->stmt);
+	odbc_ReleaseConnection(dbc);
+	MemoryContextDelete(festate->temp_cxt);
+
+	/* We assume that we have no dead tuple. */
+	*totaldeadrows = 0.0;
+
+	/* A sampled table has the size counted, otherwise all rows were seen */
+	*totalrows = (method == ODBC_SAMPLE_OFF) ? samplerows : reltuples;
+
+	ereport(elevel,
+			(errmsg("\"%s\": table contains %.0f rows, %d rows in sample",
+					RelationGetRelationName(relation),
+					*totalrows, numrows)));
+
+	return numrows;
+}
+
+/*
+ * odbc_count_remote_rows
+ *		Count the rows of the remote table, with the sql_count query if the
+ *		table has one.
+ *
+ * Returns -1 if the count cannot be read, including when the query fails;
+ * callers that cannot do without the count report the error.
+ */
+static double
+odbc_count_remote_rows(SQLHDBC dbc, Relation relation,
+					   odbcFdwOptions *options)
+{
+	SQLHSTMT	stmt;
+	SQLRETURN	ret;
+	StringInfoData sql;
+	SQLUBIGINT	count = 0;
+	SQLLEN		indicator = SQL_NULL_DATA;
+
+	initStringInfo(&sql);
+	if (is_blank_string(options->sql_count))
+	{
+		OdbcDialect dialect;
+
+		odbc_get_dialect(options, dbc, &dialect);
+		odbc_deparseAnalyzeSizeSql(&sql, relation, &dialect);
+	}
+	else
+		appendStringInfoString(&sql, options->sql_count);
+
+	elog_debug("Count query: %s", sql.data);
+
+	stmt = odbc_AllocStatement(dbc);
+	ret = SQLExecDirect(stmt, (SQLCHAR *) sql.data, SQL_NTS);
+	if (!SQL_SUCCEEDED(ret))
+		elog(DEBUG1, "odbc_fdw: could not count the rows of \"%s\"",
+			 RelationGetRelationName(relation));
+	else
+	{
+		ret = SQLFetch(stmt);
+		if (SQL_SUCCEEDED(ret))
+			ret = SQLGetData(stmt, 1, SQL_C_UBIGINT, &count, 0, &indicator);
 	}
+	odbc_FreeStatement(dbc, stmt);
+
+	if (!SQL_SUCCEEDED(ret) || indicator == SQL_NULL_DATA)
+		return -1;
+	return (double) count;
 }
 
 /*
- * odbcReScanForeignScan
- *      Rescan table, possibly with new parameters
+ * odbc_remote_row_count
+ *		Count the rows of an odbc_fdw foreign table on the remote server.
+ *
+ * Returns -1 if the count cannot be read.
  */
-static void
-odbcReScanForeignScan(ForeignScanState *node)
+double
+odbc_remote_row_count(Relation relation)
 {
-	elog(ERROR, "should not be here, TBD");
+	odbcFdwOptions options;
+	SQLHDBC		dbc;
+	double		rows;
+
+	if (GetFdwRoutineForRelation(relation, false)->AnalyzeForeignTable !=
+		odbcAnalyzeForeignTable)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not an odbc_fdw foreign table",
+						RelationGetRelationName(relation))));
+
+	odbcGetTableOptions(RelationGetRelid(relation), &options);
+	odbc_connection(&options, &dbc);
+	rows = odbc_count_remote_rows(dbc, relation, &options);
+	odbc_ReleaseConnection(dbc);
+
+	return rows;
 }
 
 static void
@@ -2695,7 +4501,7 @@ odbcBeginDirectModify(ForeignScanState *node, int eflags)
 	odbcGetTableOptions(RelationGetRelid(dmstate->rel), &options);
 	odbc_connection(&options,  &dbc);
 	/* Allocate a statement handle */
-	SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	stmt = odbc_AllocStatement(dbc);
 
 	//-------------------
 	dmstate->stmt = stmt;
@@ -2719,6 +4525,21 @@ odbcBeginDirectModify(ForeignScanState *node, int eflags)
 	dmstate->set_processed = intVal(list_nth(fsplan->fdw_private,
 											 FdwDirectModifyPrivateSetProcessed));
 
+	/* Prepare the command if it has runtime parameters to bind */
+	dmstate->numParams = list_length(fsplan->fdw_exprs);
+	if (dmstate->numParams > 0)
+	{
+		OdbcDialect dialect;
+
+		odbc_get_dialect(&options, dbc, &dialect);
+		dmstate->params = odbc_prepare_query_params(stmt, dmstate->query,
+													fsplan->fdw_exprs,
+													(PlanState *) node,
+													dialect.has_boolean,
+													&dmstate->param_exprs,
+													&dmstate->has_text_params);
+	}
+
 	/* Create context for per-tuple temp workspace. */
 	dmstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
 											  "postgres_fdw temporary data",
@@ -2746,7 +4567,16 @@ odbcIterateDirectModify(ForeignScanState *node)
 	 * If this is the first call after Begin, execute the statement.
 	 */
 	if (dmstate->num_tuples == -1) {
-		ret = SQLExecDirect(dmstate->stmt, (SQLCHAR *) dmstate->query, SQL_NTS);
+		if (dmstate->numParams > 0)
+		{
+			odbc_store_query_params(dmstate->stmt, dmstate->params,
+									dmstate->param_exprs,
+									dmstate->has_text_params,
+									node->ss.ps.ps_ExprContext);
+			ret = SQLExecute(dmstate->stmt);
+		}
+		else
+			ret = SQLExecDirect(dmstate->stmt, (SQLCHAR *) dmstate->query, SQL_NTS);
 		check_return(ret, "Executing ODBC SQLExecute", dmstate->stmt, SQL_HANDLE_STMT);
 
 		/* Check number of rows affected, and fetch RETURNING tuple if any */
@@ -2795,14 +4625,13 @@ odbcEndDirectModify(ForeignScanState *node)
 	{
 		if (dmstate->stmt) 
 		{
-			SQLFreeHandle(SQL_HANDLE_STMT, dmstate->stmt);
+			odbc_FreeStatement(dmstate->conn, dmstate->stmt);
 			dmstate->stmt = NULL;
 		}
 
 		if (dmstate->conn)
 		{
-			SQLDisconnect(dmstate->conn);
-			SQLFreeHandle(SQL_HANDLE_DBC, dmstate->conn);
+			odbc_ReleaseConnection(dmstate->conn);
 			dmstate->conn = NULL;
 		}
 
@@ -2830,6 +4659,9 @@ odbcPlanForeignModify(PlannerInfo *root,
 	List	   *returningList = NIL;
 	List	   *retrieved_attrs = NIL;
 	bool		doNothing = false;
+	odbcFdwOptions options;
+	OdbcDialect dialect;
+	int			batch_size;
 
 	if (operation != CMD_INSERT) {
 		elog(ERROR, "unexpected operation: %d", (int) operation);
@@ -2894,22 +4726,34 @@ odbcPlanForeignModify(PlannerInfo *root,
 			 (int) plan->onConflictAction);
 
 	/*
-	 * Construct the SQL command string.
+	 * Construct the SQL command string, in the dialect of the server.
 	 */
-	odbc_deparseInsertSql(&sql, root, resultRelation, rel,
+	odbcGetTableOptions(rte->relid, &options);
+	odbc_get_dialect(&options, NULL, &dialect);
+	odbc_deparseInsertSql(&sql, root, resultRelation, rel, &dialect,
 					targetAttrs, doNothing, returningList,
 					&retrieved_attrs);
 
 	heap_close(rel, NoLock);
 
+	/*
+	 * Rows can only be buffered and sent several per statement if nothing
+	 * has to come back for each of them, and the VALUES list ends the
+	 * statement.
+	 */
+	batch_size = options.batch_size > 0 ? options.batch_size : 1;
+	if (retrieved_attrs != NIL || doNothing || targetAttrs == NIL)
+		batch_size = 1;
+
 	/*
 	 * Build the fdw_private list that will be available to the executor.
 	 * Items in the list must match enum FdwModifyPrivateIndex, above.
 	 */
-	return list_make4(makeString(sql.data),
+	return list_make5(makeString(sql.data),
 					  targetAttrs,
 					  makeInteger((retrieved_attrs != NIL)),
-					  retrieved_attrs);
+					  retrieved_attrs,
+					  makeInteger(batch_size));
 }
 
 /*
@@ -2988,8 +4832,9 @@ odbcBeginForeignModify(ModifyTableState *mtstate,
 	odbcGetTableOptions(RelationGetRelid(rel), &options);
 
 	odbc_connection(&options, &dbc);
+	odbc_get_dialect(&options, dbc, &fmstate->dialect);
 	/* Allocate a statement handle */
-	SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+	stmt = odbc_AllocStatement(dbc);
 
 	//-------------------
 	fmstate->conn = dbc;
@@ -3005,6 +4850,24 @@ odbcBeginForeignModify(ModifyTableState *mtstate,
 											 FdwModifyPrivateHasReturning));
 	fmstate->retrieved_attrs = (List *) list_nth(fdw_private,
 												 FdwModifyPrivateRetrievedAttrs);
+	fmstate->batch_size = intVal(list_nth(fdw_private,
+										  FdwModifyPrivateBatchSize));
+
+	initStringInfo(&fmstate->row_sql);
+	if (fmstate->batch_size > 1)
+	{
+		SQLUINTEGER	max_len = 0;
+
+		initStringInfo(&fmstate->batch_sql);
+		appendStringInfoString(&fmstate->batch_sql, fmstate->query);
+		fmstate->query_len = fmstate->batch_sql.len;
+		fmstate->num_buffered = 0;
+
+		/* 0 means the driver doesn't know of a limit */
+		SQLGetInfo(dbc, SQL_MAX_STATEMENT_LEN, &max_len, sizeof(max_len), NULL);
+		fmstate->max_sql_len = (max_len > 0 && max_len < ODBC_MAX_BATCH_SQL_LEN) ?
+			max_len : ODBC_MAX_BATCH_SQL_LEN;
+	}
 
 	/* Create context for per-tuple temp workspace. */
 	fmstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
@@ -3047,6 +4910,10 @@ odbcBeginForeignModify(ModifyTableState *mtstate,
 
 	Assert(fmstate->p_nums <= n_params);
 
+#ifndef DIRECT_INSERT
+	odbc_init_param_arrays(fmstate);
+#endif
+
 	resultRelInfo->ri_FdwState = fmstate;
 }
 
@@ -3101,233 +4968,749 @@ odbc_convert_prep_stmt_params(odbcFdwModifyState *fmstate,
 		int			nestlevel;
 		ListCell   *lc;
 
-		nestlevel = odbc_set_transmission_modes();
+		nestlevel = odbc_set_transmission_modes();
+
+		foreach(lc, fmstate->target_attrs)
+		{
+			int			attnum = lfirst_int(lc);
+			Datum		value;
+			bool		isnull;
+
+			value = slot_getattr(slot, attnum, &isnull);
+			if (isnull)
+				p_values[pindex] = NULL;
+			else
+				p_values[pindex] = OutputFunctionCall(&fmstate->p_flinfo[pindex],
+													  value);
+			pindex++;
+		}
+
+		odbc_reset_transmission_modes(nestlevel);
+	}
+
+	Assert(pindex == fmstate->p_nums);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return p_values;
+}
+
+#ifndef DIRECT_INSERT
+/*
+ * odbc_init_param_arrays
+ *		Bind each target column of the prepared INSERT to an array of
+ *		batch_size parameter values
+ *
+ * All buffered rows are then sent by a single SQLExecute.  If the driver
+ * can't take that many parameter sets, the batch shrinks to what it can.
+ */
+static void
+odbc_init_param_arrays(odbcFdwModifyState *fmstate)
+{
+	SQLULEN		paramset_size = 0;
+	SQLRETURN	ret;
+	ListCell   *lc;
+	int			i = 0;
+
+	if (fmstate->batch_size > 1)
+	{
+		ret = SQLSetStmtAttr(fmstate->stmt, SQL_ATTR_PARAMSET_SIZE,
+							 (SQLPOINTER) (SQLULEN) fmstate->batch_size, 0);
+		if (SQL_SUCCEEDED(ret))
+			ret = SQLGetStmtAttr(fmstate->stmt, SQL_ATTR_PARAMSET_SIZE,
+								 &paramset_size, 0, NULL);
+		if (!SQL_SUCCEEDED(ret) || paramset_size < 1)
+			paramset_size = 1;
+		if (paramset_size < (SQLULEN) fmstate->batch_size)
+		{
+			elog(DEBUG1, "odbc_fdw: driver accepts %lu parameter sets, batch_size was %d",
+				 (unsigned long) paramset_size, fmstate->batch_size);
+			fmstate->batch_size = (int) paramset_size;
+		}
+		fmstate->paramset_size = paramset_size;
+	}
+	else
+		fmstate->paramset_size = 1;
+
+	fmstate->param_status = (SQLUSMALLINT *)
+		palloc0(sizeof(SQLUSMALLINT) * fmstate->batch_size);
+	SQLSetStmtAttr(fmstate->stmt, SQL_ATTR_PARAM_STATUS_PTR,
+				   fmstate->param_status, 0);
+	SQLSetStmtAttr(fmstate->stmt, SQL_ATTR_PARAMS_PROCESSED_PTR,
+				   &fmstate->params_processed, 0);
+	fmstate->num_buffered = 0;
+
+	fmstate->params = (odbcParamColumn *)
+		palloc0(sizeof(odbcParamColumn) * Max(fmstate->p_nums, 1));
+
+	foreach(lc, fmstate->target_attrs)
+	{
+		int			attnum = lfirst_int(lc);
+		Form_pg_attribute attr = RelationGetDescr(fmstate->rel)->attrs[attnum - 1];
+		odbcParamColumn *param = &fmstate->params[i];
+
+		Assert(!attr->attisdropped);
+
+		param->number = i + 1;
+		param->nrows = fmstate->batch_size;
+		param->flinfo = &fmstate->p_flinfo[i];
+		if (!odbc_set_param_type(param, attr->atttypid, attr->atttypmod))
+			elog(ERROR, "Does not support data type %d", attr->atttypid);
+		if (param->ctype == SQL_C_CHAR &&
+			param->atttypid != TEXTOID && param->atttypid != VARCHAROID &&
+			param->atttypid != BPCHAROID)
+			fmstate->has_text_params = true;
+
+		param->values = MemoryContextAllocHuge(CurrentMemoryContext,
+											   param->width * fmstate->batch_size);
+		param->indicators = (SQLLEN *) palloc(sizeof(SQLLEN) * fmstate->batch_size);
+		odbc_bind_param(fmstate->stmt, param);
+		i++;
+	}
+}
+#endif
+
+/*
+ * odbc_set_param_type
+ *		Choose the C and SQL types a parameter of type typid is sent as
+ *
+ * Returns false if there is no mapping for typid; the parameter is then set
+ * up to be sent as text.
+ */
+static bool
+odbc_set_param_type(odbcParamColumn *param, Oid typid, int32 typmod)
+{
+	param->atttypid = typid;
+	param->ctype = SQL_C_CHAR;
+	param->sqltype = SQL_VARCHAR;
+	param->fixed = false;
+	param->width = 32;
+	switch (typid)
+	{
+		case BOOLOID:
+			/* boolean to SQL_SMALLINT */
+			param->ctype = SQL_C_SSHORT;
+			param->sqltype = SQL_SMALLINT;
+			param->width = sizeof(SQLSMALLINT);
+			break;
+		case INT2OID:
+			param->ctype = SQL_C_SSHORT;
+			param->sqltype = SQL_SMALLINT;
+			param->width = sizeof(SQLSMALLINT);
+			break;
+		case INT4OID:
+			param->ctype = SQL_C_SLONG;
+			param->sqltype = SQL_INTEGER;
+			param->width = sizeof(SQLINTEGER);
+			break;
+		case INT8OID:
+			param->ctype = SQL_C_SBIGINT;
+			param->sqltype = SQL_BIGINT;
+			param->width = sizeof(SQLBIGINT);
+			break;
+		case FLOAT4OID:
+			/* float4 widens to double exactly */
+			param->ctype = SQL_C_DOUBLE;
+			param->sqltype = SQL_REAL;
+			param->width = sizeof(SQLDOUBLE);
+			break;
+		case FLOAT8OID:
+			param->ctype = SQL_C_DOUBLE;
+			param->sqltype = SQL_DOUBLE;
+			param->width = sizeof(SQLDOUBLE);
+			break;
+		case DATEOID:
+			param->ctype = SQL_C_TYPE_DATE;
+			param->sqltype = SQL_TYPE_DATE;
+			param->column_size = 10;
+			param->width = sizeof(SQL_DATE_STRUCT);
+			break;
+		case TIMESTAMPOID:
+			param->ctype = SQL_C_TYPE_TIMESTAMP;
+			param->sqltype = SQL_TYPE_TIMESTAMP;
+			param->column_size = 26;
+			param->decimal_digits = 6;
+			param->width = sizeof(SQL_TIMESTAMP_STRUCT);
+			break;
+		case UUIDOID:
+			param->ctype = SQL_C_GUID;
+			param->sqltype = SQL_GUID;
+			param->width = sizeof(SQLGUID);
+			break;
+		case NUMERICOID:
+			/* decimal, numeric to SQL_DECIMAL */
+			param->sqltype = SQL_DECIMAL;
+
+			/*
+			 * A numeric(p,s) small enough for an int64 once scaled is
+			 * sent as SQL_NUMERIC_STRUCT; the struct needs a fixed scale,
+			 * so anything else goes as text.
+			 */
+			if (typmod >= (int32) VARHDRSZ)
+			{
+				int32		tmp = typmod - VARHDRSZ;
+				int			precision = (tmp >> 16) & 0xffff;
+				int			scale = tmp & 0xffff;
+
+				if (precision <= 18 && scale <= precision)
+				{
+					int64		factor = 1;
+					int			k;
+
+					for (k = 0; k < scale; k++)
+						factor *= 10;
+
+					param->ctype = SQL_C_NUMERIC;
+					param->column_size = precision;
+					param->decimal_digits = scale;
+					param->width = sizeof(SQL_NUMERIC_STRUCT);
+					param->scale_factor =
+						DirectFunctionCall1(int8_numeric,
+											Int64GetDatum(factor));
+				}
+			}
+			break;
+		case BYTEAOID:
+			/* bytea to SQL_LONGVARBINARY */
+			param->ctype = SQL_C_BINARY;
+			param->sqltype = SQL_LONGVARBINARY;
+			break;
+		case CHAROID:
+			/* char to SQL_CHAR */
+			param->sqltype = SQL_CHAR;
+			break;
+		case BPCHAROID:
+			/* bpchar, char(%u) to SQL_WCHAR */
+			param->sqltype = SQL_WCHAR;
+			break;
+		case VARCHAROID:
+			/* varchar in utf8, to SQL_VARCHAR */
+			param->sqltype = SQL_VARCHAR;
+			break;
+		case TEXTOID:
+			/* text to SQL_LONGVARCHAR */
+			param->sqltype = SQL_LONGVARCHAR;
+			break;
+		case TIMEOID:
+			/* SQL_TIME_STRUCT has no fractional seconds: send as text */
+			param->sqltype = SQL_TIME;
+			break;
+		default:
+			return false;
+	}
+	param->fixed = (param->ctype != SQL_C_CHAR &&
+					param->ctype != SQL_C_BINARY);
+	return true;
+}
+
+/*
+ * odbc_bind_param
+ *		(Re)bind a parameter to its value array
+ */
+static void
+odbc_bind_param(SQLHSTMT stmt, odbcParamColumn *param)
+{
+	SQLULEN		column_size = 0;
+	SQLSMALLINT decimal_digits = 0;
+	SQLRETURN	ret;
+
+	/* Character and binary types take their maximum length */
+	if (param->fixed)
+	{
+		column_size = param->column_size;
+		decimal_digits = param->decimal_digits;
+	}
+	else if (param->ctype == SQL_C_BINARY)
+		column_size = param->width;
+	else if (param->sqltype == SQL_CHAR || param->sqltype == SQL_WCHAR ||
+			 param->sqltype == SQL_VARCHAR || param->sqltype == SQL_LONGVARCHAR)
+		column_size = param->width - 1;
+
+	ret = SQLBindParameter(stmt, param->number, SQL_PARAM_INPUT,
+						   param->ctype, param->sqltype, column_size,
+						   decimal_digits, param->values, param->width,
+						   param->indicators);
+	check_return(ret, "Executing ODBC SQLBindParameter",
+				 stmt, SQL_HANDLE_STMT);
+
+	/*
+	 * SQLBindParameter leaves the precision and scale of a SQL_C_NUMERIC
+	 * value at the driver's defaults; they have to be set in the
+	 * application parameter descriptor, data pointer last.
+	 */
+	if (param->ctype == SQL_C_NUMERIC)
+	{
+		SQLHDESC	apd;
+
+		ret = SQLGetStmtAttr(stmt, SQL_ATTR_APP_PARAM_DESC,
+							 &apd, 0, NULL);
+		check_return(ret, "Getting ODBC parameter descriptor",
+					 stmt, SQL_HANDLE_STMT);
+		SQLSetDescField(apd, param->number, SQL_DESC_TYPE,
+						(SQLPOINTER) SQL_C_NUMERIC, 0);
+		SQLSetDescField(apd, param->number, SQL_DESC_PRECISION,
+						(SQLPOINTER) (SQLLEN) param->column_size, 0);
+		SQLSetDescField(apd, param->number, SQL_DESC_SCALE,
+						(SQLPOINTER) (SQLLEN) param->decimal_digits, 0);
+		ret = SQLSetDescField(apd, param->number, SQL_DESC_DATA_PTR,
+							  param->values, 0);
+		check_return(ret, "Setting ODBC numeric parameter", apd,
+					 SQL_HANDLE_DESC);
+	}
+}
+
+/*
+ * odbc_store_param
+ *		Store the value of a parameter for the given row of its batch
+ *
+ * value is NULL for a SQL NULL; len is its length in bytes, not counting
+ * the terminating zero SQL_C_CHAR values need.
+ */
+static void
+odbc_store_param(SQLHSTMT stmt, odbcParamColumn *param, int row,
+				 const char *value, SQLLEN len)
+{
+	SQLLEN		needed;
+
+	if (value == NULL)
+	{
+		param->indicators[row] = SQL_NULL_DATA;
+		return;
+	}
+
+	needed = (param->ctype == SQL_C_CHAR) ? len + 1 : len;
+	if (needed > param->width && !param->fixed)
+	{
+		SQLLEN		width = param->width;
+		int			r;
+
+		while (width < needed)
+			width *= 2;
+
+		/*
+		 * Move the rows buffered so far to their slots at the new width,
+		 * last row first so none is overwritten before it's moved.
+		 */
+		param->values = repalloc_huge(param->values, width * param->nrows);
+		for (r = row - 1; r > 0; r--)
+			memmove(param->values + r * width, param->values + r * param->width,
+					param->width);
+		param->width = width;
+		odbc_bind_param(stmt, param);
+	}
+	Assert(needed <= param->width);
+
+	memcpy(param->values + row * param->width, value, len);
+	if (param->ctype == SQL_C_CHAR)
+		param->values[row * param->width + len] = '\0';
+	param->indicators[row] = len;
+}
+
+/*
+ * odbc_store_datum
+ *		Convert a value to the C type of a parameter, and store it for the
+ *		given row of its batch
+ */
+static void
+odbc_store_datum(SQLHSTMT stmt, odbcParamColumn *param, int row, Datum value,
+				 bool isnull)
+{
+	if (isnull)
+	{
+		odbc_store_param(stmt, param, row, NULL, 0);
+		return;
+	}
+
+	switch (param->ctype)
+	{
+		case SQL_C_SSHORT:
+			{
+				SQLSMALLINT v;
+
+				if (param->atttypid == BOOLOID)
+					v = DatumGetBool(value) ? 1 : 0;
+				else
+					v = DatumGetInt16(value);
+				odbc_store_param(stmt, param, row, (char *) &v, sizeof(v));
+				break;
+			}
+		case SQL_C_BIT:
+			{
+				SQLCHAR		v = DatumGetBool(value) ? 1 : 0;
+
+				odbc_store_param(stmt, param, row, (char *) &v, sizeof(v));
+				break;
+			}
+		case SQL_C_SLONG:
+			{
+				SQLINTEGER	v = DatumGetInt32(value);
+
+				odbc_store_param(stmt, param, row, (char *) &v, sizeof(v));
+				break;
+			}
+		case SQL_C_SBIGINT:
+			{
+				SQLBIGINT	v = DatumGetInt64(value);
+
+				odbc_store_param(stmt, param, row, (char *) &v, sizeof(v));
+				break;
+			}
+		case SQL_C_DOUBLE:
+			{
+				SQLDOUBLE	v;
+
+				if (param->atttypid == FLOAT4OID)
+					v = DatumGetFloat4(value);
+				else
+					v = DatumGetFloat8(value);
+				odbc_store_param(stmt, param, row, (char *) &v, sizeof(v));
+				break;
+			}
+		case SQL_C_TYPE_DATE:
+			{
+				DateADT		date = DatumGetDateADT(value);
+				SQL_DATE_STRUCT d;
+				int			year,
+							month,
+							day;
+
+				if (DATE_NOT_FINITE(date))
+					ereport(ERROR,
+							(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+							 errmsg("cannot send infinite date to the data source")));
+				j2date(date + POSTGRES_EPOCH_JDATE, &year, &month, &day);
+				d.year = year;
+				d.month = month;
+				d.day = day;
+				odbc_store_param(stmt, param, row, (char *) &d, sizeof(d));
+				break;
+			}
+		case SQL_C_TYPE_TIMESTAMP:
+			{
+				Timestamp	timestamp = DatumGetTimestamp(value);
+				SQL_TIMESTAMP_STRUCT ts;
+				struct pg_tm tm;
+				fsec_t		fsec;
+
+				if (TIMESTAMP_NOT_FINITE(timestamp) ||
+					timestamp2tm(timestamp, NULL, &tm, &fsec, NULL, NULL) != 0)
+					ereport(ERROR,
+							(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+							 errmsg("timestamp out of range")));
+				ts.year = tm.tm_year;
+				ts.month = tm.tm_mon;
+				ts.day = tm.tm_mday;
+				ts.hour = tm.tm_hour;
+				ts.minute = tm.tm_min;
+				ts.second = tm.tm_sec;
+				/* fsec is in microseconds, fraction in nanoseconds */
+				ts.fraction = (SQLUINTEGER) fsec * 1000;
+				odbc_store_param(stmt, param, row, (char *) &ts, sizeof(ts));
+				break;
+			}
+		case SQL_C_GUID:
+			{
+				pg_uuid_t  *uuid = DatumGetUUIDP(value);
+				SQLGUID		guid;
+
+				/* uuid is stored in network byte order */
+				guid.Data1 = ((SQLUINTEGER) uuid->data[0] << 24) |
+					((SQLUINTEGER) uuid->data[1] << 16) |
+					((SQLUINTEGER) uuid->data[2] << 8) |
+					uuid->data[3];
+				guid.Data2 = (uuid->data[4] << 8) | uuid->data[5];
+				guid.Data3 = (uuid->data[6] << 8) | uuid->data[7];
+				memcpy(guid.Data4, uuid->data + 8, 8);
+				odbc_store_param(stmt, param, row, (char *) &guid, sizeof(guid));
+				break;
+			}
+		case SQL_C_NUMERIC:
+			{
+				SQL_NUMERIC_STRUCT n;
+				int64		scaled;
+				uint64		magnitude;
+				int			k;
+
+				/* The typmod has already rounded value to our scale */
+				scaled = DatumGetInt64(DirectFunctionCall1(numeric_int8,
+														   DirectFunctionCall2(numeric_mul,
+																			   value,
+																			   param->scale_factor)));
+				memset(&n, 0, sizeof(n));
+				n.precision = (SQLCHAR) param->column_size;
+				n.scale = (SQLSCHAR) param->decimal_digits;
+				n.sign = (scaled >= 0) ? 1 : 0;
+				magnitude = (scaled >= 0) ? (uint64) scaled : -(uint64) scaled;
+				/* val is a little-endian integer */
+				for (k = 0; k < 8; k++)
+					n.val[k] = (magnitude >> (8 * k)) & 0xff;
+				odbc_store_param(stmt, param, row, (char *) &n, sizeof(n));
+				break;
+			}
+		case SQL_C_BINARY:
+			{
+				bytea	   *b = DatumGetByteaPP(value);
+
+				odbc_store_param(stmt, param, row, VARDATA_ANY(b), VARSIZE_ANY_EXHDR(b));
+				break;
+			}
+		default:
+			if (param->atttypid == TEXTOID || param->atttypid == VARCHAROID ||
+				param->atttypid == BPCHAROID)
+			{
+				/* The text is already in the form the data source gets */
+				text	   *t = DatumGetTextPP(value);
+
+				odbc_store_param(stmt, param, row, VARDATA_ANY(t), VARSIZE_ANY_EXHDR(t));
+			}
+			else
+			{
+				char	   *str = OutputFunctionCall(param->flinfo, value);
+
+				odbc_store_param(stmt, param, row, str, strlen(str));
+			}
+			break;
+	}
+}
+
+/*
+ * odbc_prepare_query_params
+ *		Prepare a remote statement whose parameters are computed by fdw_exprs,
+ *		and bind each parameter to a buffer for its value
+ *
+ * The executable expressions are returned in *param_exprs.  *has_text_params
+ * tells whether any value is sent in text form.
+ *
+ * Unlike an inserted value, which the remote column converts, a parameter
+ * is compared with remote values of its own type.  Booleans are therefore
+ * sent as booleans: as text to servers that have a boolean type
+ * (has_boolean), and as SQL_BIT to the others.
+ */
+static odbcParamColumn *
+odbc_prepare_query_params(SQLHSTMT stmt, const char *query, List *fdw_exprs,
+						  PlanState *node, bool has_boolean,
+						  List **param_exprs, bool *has_text_params)
+{
+	odbcParamColumn *params;
+	SQLRETURN	ret;
+	ListCell   *lc;
+	int			i = 0;
+
+	ret = SQLPrepare(stmt, (SQLCHAR *) query, SQL_NTS);
+	check_return(ret, "Preparing ODBC query", stmt, SQL_HANDLE_STMT);
+
+	/*
+	 * Prepare for evaluation of the parameter expressions.  They're built
+	 * in the query context, as they are re-evaluated for every rescan.
+	 */
+#if PG_VERSION_NUM >= 100000
+	*param_exprs = ExecInitExprList(fdw_exprs, node);
+#else
+	*param_exprs = (List *) ExecInitExpr((Expr *) fdw_exprs, node);
+#endif
+
+	*has_text_params = false;
+	params = (odbcParamColumn *)
+		palloc0(sizeof(odbcParamColumn) * list_length(fdw_exprs));
+	foreach(lc, fdw_exprs)
+	{
+		Node	   *param_expr = (Node *) lfirst(lc);
+		odbcParamColumn *param = &params[i];
+		Oid			typefnoid;
+		bool		isvarlena;
+
+		param->number = i + 1;
+		param->nrows = 1;
+
+		/* Types without a native C mapping are sent as text */
+		odbc_set_param_type(param, exprType(param_expr), exprTypmod(param_expr));
+		if (param->atttypid == BOOLOID)
+		{
+			if (has_boolean)
+			{
+				param->ctype = SQL_C_CHAR;
+				param->sqltype = SQL_VARCHAR;
+				param->width = 32;
+				param->fixed = false;
+			}
+			else
+			{
+				param->ctype = SQL_C_BIT;
+				param->sqltype = SQL_BIT;
+				param->column_size = 1;
+				param->width = sizeof(SQLCHAR);
+			}
+		}
+		getTypeOutputInfo(param->atttypid, &typefnoid, &isvarlena);
+		param->flinfo = (FmgrInfo *) palloc0(sizeof(FmgrInfo));
+		fmgr_info(typefnoid, param->flinfo);
+		if (param->ctype == SQL_C_CHAR &&
+			param->atttypid != TEXTOID && param->atttypid != VARCHAROID &&
+			param->atttypid != BPCHAROID)
+			*has_text_params = true;
+
+		param->values = palloc(param->width);
+		param->indicators = (SQLLEN *) palloc(sizeof(SQLLEN));
+		odbc_bind_param(stmt, param);
+		i++;
+	}
+
+	return params;
+}
+
+/*
+ * odbc_store_query_params
+ *		Evaluate the parameters of a remote statement, and store their values
+ *		in the bound buffers ready for SQLExecute
+ */
+static void
+odbc_store_query_params(SQLHSTMT stmt, odbcParamColumn *params,
+						List *param_exprs, bool has_text_params,
+						ExprContext *econtext)
+{
+	MemoryContext oldcontext;
+	int			nestlevel = 0;
+	ListCell   *lc;
+	int			i = 0;
 
-		foreach(lc, fmstate->target_attrs)
-		{
-			int			attnum = lfirst_int(lc);
-			Datum		value;
-			bool		isnull;
+	/* Evaluate the parameters in the short-lived per-tuple context */
+	oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+	if (has_text_params)
+		nestlevel = odbc_set_transmission_modes();
 
-			value = slot_getattr(slot, attnum, &isnull);
-			if (isnull)
-				p_values[pindex] = NULL;
-			else
-				p_values[pindex] = OutputFunctionCall(&fmstate->p_flinfo[pindex],
-													  value);
-			pindex++;
-		}
+	foreach(lc, param_exprs)
+	{
+		ExprState  *expr_state = (ExprState *) lfirst(lc);
+		Datum		value;
+		bool		isnull;
 
-		odbc_reset_transmission_modes(nestlevel);
+#if PG_VERSION_NUM >= 100000
+		value = ExecEvalExpr(expr_state, econtext, &isnull);
+#else
+		value = ExecEvalExpr(expr_state, econtext, &isnull, NULL);
+#endif
+		odbc_store_datum(stmt, &params[i++], 0, value, isnull);
 	}
 
-	Assert(pindex == fmstate->p_nums);
-
+	if (has_text_params)
+		odbc_reset_transmission_modes(nestlevel);
 	MemoryContextSwitchTo(oldcontext);
-
-	return p_values;
 }
 
-/**
- * Try to bind parameters to prepared stmt
+#ifndef DIRECT_INSERT
+/*
+ * odbc_flush_param_batch
+ *		Execute the prepared INSERT for all buffered rows
  */
 static void
-odbc_Bind_Prepared(odbcFdwModifyState *fmstate, char** p_value)
+odbc_flush_param_batch(odbcFdwModifyState *fmstate)
 {
-	ListCell   *lc;
-    int         attnum;
-    Form_pg_attribute   attr;
-	int         nums = 0;
-	SQLRETURN 	ret = SQL_SUCCESS;
-    Datum       result = 0;
-    SQLLEN      param_size = 0;
-	SQLLEN      column_size = 0;
-    char        *param_p = NULL;
-    int         dst_type;
+	SQLRETURN	ret;
+	SQLULEN		i;
 
-	foreach(lc, fmstate->target_attrs)
+	if (fmstate->num_buffered == 0)
+		return;
+
+	if (fmstate->paramset_size != (SQLULEN) fmstate->num_buffered)
 	{
-		attnum = lfirst_int(lc);
-		attr = RelationGetDescr(fmstate->rel)->attrs[attnum - 1];
-		Assert(!attr->attisdropped);
+		ret = SQLSetStmtAttr(fmstate->stmt, SQL_ATTR_PARAMSET_SIZE,
+							 (SQLPOINTER) (SQLULEN) fmstate->num_buffered, 0);
+		check_return(ret, "Setting ODBC parameter set size",
+					 fmstate->stmt, SQL_HANDLE_STMT);
+		fmstate->paramset_size = fmstate->num_buffered;
+	}
 
-        if (attr->atttypid == 17 || attr->atttypid == 16) {
-		    result = InputFunctionCall(&fmstate->p_inputflinfo[nums], 
-                                    	p_value[nums],
-										fmstate->p_input_typIOParam[nums],
-										fmstate->p_input_typmod[nums]);
-	    } else {
-            result = (Datum)p_value[nums];
-        }
+	fmstate->params_processed = 0;
+	ret = SQLExecute(fmstate->stmt);
 
-		if (attr->atttypid == 16) {
-				// boolean  to SQL_BIT
-				SQLSMALLINT odbc_param = (SQLSMALLINT) result ;
-				param_size = sizeof(odbc_param);
-				ret = SQLBindParameter(fmstate->stmt, nums+1, 
-										SQL_PARAM_INPUT, SQL_C_SHORT, 
-										SQL_SMALLINT, 0, 0, 
-										&odbc_param, 0, &param_size);
-		} else if (attr->atttypid == 17) {
-				// bytea to SQL_LONGVARBINARY 
-				bytea   *string = DatumGetByteaPP(result);
-				char    *odbc_param = VARDATA_ANY(string);
-				param_size = VARSIZE_ANY_EXHDR(string);
-				ret = SQLBindParameter(fmstate->stmt, nums+1, 
-										SQL_PARAM_INPUT, SQL_C_CHAR, 
-										SQL_LONGVARBINARY, 0, 0, 
-										odbc_param, 0, &param_size);
-        } else {
-		    param_p = (char*)result;
-		    switch (attr->atttypid) {
-			    case 18:
-			    {
-				    // char to SQL_CHAR
-				    param_size = sizeof(SQLCHAR);
-                    dst_type = SQL_CHAR;
-				    break;
-			    }
-			    case 1042: 
-			    {
-				    //bpchar, char(%u) to SQL_WCHAR
-				    param_size = strlen(param_p);
-                    dst_type = SQL_WCHAR;
-				    break;
-			    }
-			    case 1043:
-			    {
-				    //varcar in utf8, to  SQL_VARCHAR
-				    param_size = strlen(param_p);
-                    dst_type = SQL_VARCHAR;
-				    break;
-			    }
-			    case 25:
-			    {
-				    //text to SQL_LONGVARCHAR TBD
-                    param_size = strlen(param_p);
-                    dst_type = SQL_LONGVARCHAR;
-				    break;
-			    }
-			    case 1700: 
-			    {
-				    // decimal,numerical to	SQL_DECIMAL
-				    param_size = strlen(param_p);
-                    dst_type = SQL_DECIMAL;
-				    break;
-			    }
-			    case 23:
-			    {
-				    // int4, integer to	SQL_INTEGER
-				    param_size = strlen(param_p);
-                    dst_type = SQL_INTEGER;
-			    	break;
-			    }
-			    case 700:
-			    {
-				    // float4, real to SQL_FLOAT
-				    param_size = strlen(param_p);
-                    dst_type = SQL_FLOAT;
-				    break;
-			    }
-			    case 701 :
-			    {
-				    // float8 to SQL_DOUBLE 
-				    param_size = strlen(param_p);
-                    dst_type = SQL_DOUBLE;
-				    break;
-			    }
-			    case 21:
-			    {
-				    // int2, smallint to SQL_SMALLINT
-                    param_size = strlen(param_p);
-                    dst_type = SQL_SMALLINT;
-				    break;
-			    }
-			    case 20:
-			    {
-				    // int8, bigint to SQL_BIGINT
-				    param_size = strlen(param_p);
-                    dst_type = SQL_BIGINT;
-
-				    break;
-			    }
-			    case 1082:
-			    {
-			    	// date to SQL_DATE
-				    param_size = strlen(param_p);
-                    dst_type = SQL_DATE;
-				    break;
-			    }
-			    case 1083:
-			    {
-				    // time to SQL_TIME
-				    param_size = strlen(param_p);
-                    dst_type = SQL_TIME;
-				    break;
-			    }
-			    case 1114:
-			    {
-				    //timestamp to SQL_TIMESTAMP
-				    param_size = strlen(param_p);
-                    dst_type = SQL_TIMESTAMP;
-				    break;
-			    }
-			    case 2950:
-			    {
-				    // uuid to SQL_GUID
-				    param_size = strlen(param_p);
-                    dst_type = SQL_GUID;
-				    break;
-			    }
-			    default:
-			    {
-				    elog(ERROR, "Does not support data type %d", attr->atttypid);
-				    break;
-			    }
-            }
-
-			if (dst_type == SQL_CHAR || dst_type == SQL_WCHAR ||
-				dst_type == SQL_VARCHAR || dst_type == SQL_LONGVARCHAR) {
-				column_size = param_size;
-			} else {
-				column_size = 0;
+	/* Look for the first row the driver reports as failed */
+	fmstate->failed_row = -1;
+	if (ret != SQL_SUCCESS)
+	{
+		for (i = 0; i < fmstate->params_processed &&
+			 i < (SQLULEN) fmstate->num_buffered; i++)
+		{
+			if (fmstate->param_status[i] == SQL_PARAM_ERROR)
+			{
+				fmstate->failed_row = (int) i;
+				break;
 			}
-			ret = SQLBindParameter(fmstate->stmt, nums+1, SQL_PARAM_INPUT, 
-									SQL_C_CHAR, dst_type, column_size, 0, 
-									(SQLCHAR*)param_p, 0, &param_size);
-
 		}
-		check_return(ret, "Executing ODBC SQLBindParameter", 
-					 fmstate->stmt, SQL_HANDLE_STMT);
-		nums++;
 	}
-	return ;
+
+	if (!SQL_SUCCEEDED(ret) || fmstate->failed_row >= 0)
+	{
+		ErrorContextCallback errcallback;
+
+		/* Tell which row of a batch failed */
+		errcallback.callback = param_batch_error_callback;
+		errcallback.arg = (void *) fmstate;
+		errcallback.previous = error_context_stack;
+		if (fmstate->num_buffered > 1)
+			error_context_stack = &errcallback;
+
+		/* Some rows failed even though the statement as a whole didn't */
+		check_return(SQL_SUCCEEDED(ret) ? SQL_ERROR : ret,
+					 "Executing ODBC SQLExecute", fmstate->stmt, SQL_HANDLE_STMT);
+
+		error_context_stack = errcallback.previous;
+	}
+
+	fmstate->num_buffered = 0;
+}
+
+/*
+ * Callback function which is called when an error occurs while executing a
+ * batch of parameter sets.
+ */
+static void
+param_batch_error_callback(void *arg)
+{
+	odbcFdwModifyState *fmstate = (odbcFdwModifyState *) arg;
+
+	if (fmstate->failed_row >= 0)
+		errcontext("row %d of %d in batched insert into foreign table \"%s\"",
+				   fmstate->failed_row + 1, fmstate->num_buffered,
+				   RelationGetRelationName(fmstate->rel));
+	else
+		errcontext("batched insert of %d rows into foreign table \"%s\"",
+				   fmstate->num_buffered,
+				   RelationGetRelationName(fmstate->rel));
 }
+#endif
 
 #ifdef DIRECT_INSERT
-char *build_insert_sql(odbcFdwModifyState *fmstate, char** p_value)
+/*
+ * Append the VALUES list "(...)" of one row to buf, with the row's values
+ * inlined as literals.
+ */
+static void
+build_insert_values(odbcFdwModifyState *fmstate, char **p_value, StringInfo buf)
 {
 	ListCell			*lc;
 	int         		attnum;
 	Form_pg_attribute   attr;
-	StringInfoData  	buf;
 	int					nums = 0;
 	char				*param_p = NULL;
 	Datum				result = 0;
 
-	initStringInfo(&buf);
-	appendStringInfoString(&buf, fmstate->query);
-	appendStringInfoChar(&buf, '(');
+	appendStringInfoChar(buf, '(');
 
 	foreach(lc, fmstate->target_attrs)
 	{
 		if (nums >0)
-			appendStringInfoChar(&buf, ',');
+			appendStringInfoChar(buf, ',');
 
 		attnum = lfirst_int(lc);
 		attr = RelationGetDescr(fmstate->rel)->attrs[attnum - 1];
 		Assert(!attr->attisdropped);
 
+		if (p_value[nums] == NULL) {
+			appendStringInfoString(buf, "NULL");
+			nums++;
+			continue;
+		}
+
 		if ( attr->atttypid == 16) {
 			result = InputFunctionCall(&fmstate->p_inputflinfo[nums],
 							p_value[nums],
@@ -3341,9 +5724,9 @@ char *build_insert_sql(odbcFdwModifyState *fmstate, char** p_value)
 			 // boolean  to SQL_BIT
 			SQLSMALLINT odbc_param = (SQLSMALLINT) result ;
 			if (odbc_param ==0) {
- 				appendStringInfoChar(&buf, '0');
+ 				appendStringInfoChar(buf, '0');
 			} else {
-				appendStringInfoChar(&buf, '1');
+				appendStringInfoChar(buf, '1');
             		}
 		} else {
 			param_p = (char*)result;
@@ -3351,9 +5734,7 @@ char *build_insert_sql(odbcFdwModifyState *fmstate, char** p_value)
 				case 18:
 				{
   				// char to SQL_CHAR
-					appendStringInfoChar(&buf, '\'');
-					appendStringInfoChar(&buf, *param_p);
-					appendStringInfoChar(&buf, '\'');
+					odbc_deparseStringLiteral(buf, param_p, &fmstate->dialect);
 					break;
 				}
 				case 17: //// bytea to SQL_LONGVARBINARY 
@@ -3364,9 +5745,7 @@ char *build_insert_sql(odbcFdwModifyState *fmstate, char** p_value)
 				case 1114://timestamp to SQL_TIMESTAMP
 				case 25: //text to SQL_LONGVARCHAR TBD
 				{
-					appendStringInfoChar(&buf, '\'');
-					appendStringInfoString(&buf, param_p);
-					appendStringInfoChar(&buf, '\'');
+					odbc_deparseStringLiteral(buf, param_p, &fmstate->dialect);
 					break;
 				}
 				case 1700:// decimal,numerical to SQL_DECIMAL
@@ -3377,7 +5756,7 @@ char *build_insert_sql(odbcFdwModifyState *fmstate, char** p_value)
 				case 20: // int8, bigint to SQL_BIGINT
 				case 2950: // uuid to SQL_GUID 
 				{
-					appendStringInfoString(&buf, param_p);
+					appendStringInfoString(buf, param_p);
 					break;
 				}
     				default:
@@ -3389,8 +5768,33 @@ char *build_insert_sql(odbcFdwModifyState *fmstate, char** p_value)
 		}
 		nums++;
 	}
-	appendStringInfoChar(&buf, ')');
-	return buf.data;
+	appendStringInfoChar(buf, ')');
+}
+
+/*
+ * odbc_flush_insert_batch
+ *		Send the rows buffered in batch_sql as one INSERT statement
+ */
+static void
+odbc_flush_insert_batch(odbcFdwModifyState *fmstate)
+{
+	SQLRETURN	ret;
+
+	if (fmstate->num_buffered == 0)
+		return;
+
+	elog_debug("%s: sending %d rows", __func__, fmstate->num_buffered);
+
+	ret = SQLExecDirect(fmstate->stmt, (SQLCHAR *) fmstate->batch_sql.data,
+						SQL_NTS);
+	check_return(ret, "Executing ODBC SQLExecDirect", fmstate->stmt,
+				 SQL_HANDLE_STMT);
+	SQLFreeStmt(fmstate->stmt, SQL_CLOSE);
+
+	/* Keep the query, drop the rows */
+	fmstate->batch_sql.len = fmstate->query_len;
+	fmstate->batch_sql.data[fmstate->query_len] = '\0';
+	fmstate->num_buffered = 0;
 }
 #endif
 
@@ -3404,14 +5808,18 @@ odbcExecForeignInsert(EState *estate,
 					  TupleTableSlot *slot,
 					  TupleTableSlot *planSlot)
 {
-	char **p_values;
 	int			n_rows;
 	SQLRETURN 	ret;
 	SQLLEN		count;
-#ifdef DIRECT_INSERT
-	char 		*insert_sql;
-#endif
+	MemoryContext oldcontext;
 	odbcFdwModifyState *fmstate = (odbcFdwModifyState *) resultRelInfo->ri_FdwState;
+#ifndef DIRECT_INSERT
+	ListCell   *lc;
+	int			nestlevel = 0;
+	int			i;
+#else
+	char	  **p_values;
+#endif
 
 	/* Set up the prepared statement on the remote server, if we didn't yet */
 #ifndef DIRECT_INSERT
@@ -3419,29 +5827,79 @@ odbcExecForeignInsert(EState *estate,
 		odbc_prepare_foreign_modify(fmstate);
 		fmstate->prepared = true;
 	}
-#endif
-	/* Convert parameters needed by prepared statement to text form */
-	p_values = (char**) odbc_convert_prep_stmt_params(fmstate, NULL, slot);
 
-	/*
-	 * Execute the prepared statement.
-	 */
-#ifndef	DIRECT_INSERT
-	odbc_Bind_Prepared(fmstate, p_values);
+	/* Add the row to the parameter arrays, in their native C types */
+	oldcontext = MemoryContextSwitchTo(fmstate->temp_cxt);
+	if (fmstate->has_text_params)
+		nestlevel = odbc_set_transmission_modes();
+	i = 0;
+	foreach(lc, fmstate->target_attrs)
+	{
+		int			attnum = lfirst_int(lc);
+		Datum		value;
+		bool		isnull;
+
+		value = slot_getattr(slot, attnum, &isnull);
+		odbc_store_datum(fmstate->stmt, &fmstate->params[i++],
+						 fmstate->num_buffered, value, isnull);
+	}
+	if (fmstate->has_text_params)
+		odbc_reset_transmission_modes(nestlevel);
+	MemoryContextSwitchTo(oldcontext);
+	fmstate->num_buffered++;
 
 	/*
-	 * Get the result, and check for success.
-	 *
-	 * We don't use a PG_TRY block here, so be careful not to throw error
-	 * without releasing the PGresult.
+	 * Execute the prepared statement once the batch is full.  Buffered rows
+	 * are reported as inserted now; any error surfaces when the batch is
+	 * sent.
 	 */
-	ret = SQLExecute(fmstate->stmt);
+	if (fmstate->batch_size > 1)
+	{
+		if (fmstate->num_buffered >= fmstate->batch_size)
+			odbc_flush_param_batch(fmstate);
+		MemoryContextReset(fmstate->temp_cxt);
+		return slot;
+	}
+	odbc_flush_param_batch(fmstate);
 #else
-	insert_sql = build_insert_sql(fmstate, p_values);
-	ret = SQLExecDirect(fmstate->stmt, (SQLCHAR *) insert_sql, SQL_NTS);
-#endif
+	/* Convert parameters needed by the statement to text form */
+	p_values = (char**) odbc_convert_prep_stmt_params(fmstate, NULL, slot);
+
+	oldcontext = MemoryContextSwitchTo(fmstate->temp_cxt);
+	resetStringInfo(&fmstate->row_sql);
+	if (fmstate->batch_size <= 1)
+		appendStringInfoString(&fmstate->row_sql, fmstate->query);
+	build_insert_values(fmstate, p_values, &fmstate->row_sql);
+	MemoryContextSwitchTo(oldcontext);
+
+	if (fmstate->batch_size > 1)
+	{
+		/*
+		 * Buffer the row; it's reported as inserted now, and any error
+		 * surfaces when the batch is sent.  Send the batch first if this
+		 * row would make the statement too long.
+		 */
+		if (fmstate->num_buffered > 0 &&
+			(SQLULEN) (fmstate->batch_sql.len + 1 + fmstate->row_sql.len) >
+			fmstate->max_sql_len)
+			odbc_flush_insert_batch(fmstate);
+
+		if (fmstate->num_buffered > 0)
+			appendStringInfoChar(&fmstate->batch_sql, ',');
+		appendBinaryStringInfo(&fmstate->batch_sql, fmstate->row_sql.data,
+							   fmstate->row_sql.len);
+		fmstate->num_buffered++;
+
+		if (fmstate->num_buffered >= fmstate->batch_size)
+			odbc_flush_insert_batch(fmstate);
+
+		MemoryContextReset(fmstate->temp_cxt);
+		return slot;
+	}
 
+	ret = SQLExecDirect(fmstate->stmt, (SQLCHAR *) fmstate->row_sql.data, SQL_NTS);
 	check_return(ret, "Executing ODBC SQLExecute", fmstate->stmt, SQL_HANDLE_STMT);
+#endif
 
 	/* Check number of rows affected, and fetch RETURNING tuple if any */
 	ret = SQLRowCount(fmstate->stmt, &count);
@@ -3466,16 +5924,24 @@ odbcEndForeignModify(EState *estate, ResultRelInfo *resultRelInfo)
 	/* Release remote connection */
 	if (fmstate)
 	{	
+		/* Send the rows still buffered */
+		if (fmstate->stmt && fmstate->batch_size > 1)
+#ifdef DIRECT_INSERT
+			odbc_flush_insert_batch(fmstate);
+#else
+			odbc_flush_param_batch(fmstate);
+#endif
+
+
 		if (fmstate->stmt)
 		{
-			SQLFreeHandle(SQL_HANDLE_STMT, fmstate->stmt);
+			odbc_FreeStatement(fmstate->conn, fmstate->stmt);
 			fmstate->stmt = NULL;
 		}
 
 		if (fmstate->conn)
 		{
-			SQLDisconnect(fmstate->conn);
-			SQLFreeHandle(SQL_HANDLE_DBC, fmstate->conn);
+			odbc_ReleaseConnection(fmstate->conn);
 			fmstate->conn = NULL;
 		}
 
@@ -3632,6 +6098,7 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 		}
 		SQLCloseCursor(query_stmt);
 		SQLFreeHandle(SQL_HANDLE_STMT, query_stmt);
+		odbc_ReleaseConnection(dbc);
 
 		tables        = lappend(tables, (void*)options.table);
 		table_columns = lappend(table_columns, (void*)col_str.data);
@@ -3741,6 +6208,7 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 			SQLCloseCursor(tables_stmt);
 
 			SQLFreeHandle(SQL_HANDLE_STMT, tables_stmt);
+			odbc_ReleaseConnection(dbc);
 		}
 		else if (stmt->list_type == FDW_IMPORT_SCHEMA_LIMIT_TO)
 		{
@@ -3814,6 +6282,7 @@ odbcImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 			}
 			SQLCloseCursor(columns_stmt);
 			SQLFreeHandle(SQL_HANDLE_STMT, columns_stmt);
+			odbc_ReleaseConnection(dbc);
 			table_columns = lappend(table_columns, (void*)col_str.data);
 		}
 	}
@@ -3939,6 +6408,133 @@ odbc_find_em_expr_for_rel(EquivalenceClass *ec, RelOptInfo *rel)
 	return NULL;
 }
 
+/*
+ * Find an equivalence class member expression to be computed as a sort column
+ * in the given target.
+ */
+extern Expr *
+odbc_find_em_expr_for_input_target(PlannerInfo *root,
+								   EquivalenceClass *ec,
+								   PathTarget *target)
+{
+	ListCell   *lc1;
+	int			i;
+
+	i = 0;
+	foreach(lc1, target->exprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc1);
+		Index		sgref = get_pathtarget_sortgroupref(target, i);
+		ListCell   *lc2;
+
+		/* Ignore non-sort expressions */
+		if (sgref == 0 ||
+			get_sortgroupref_clause_noerr(sgref,
+										  root->parse->sortClause) == NULL)
+		{
+			i++;
+			continue;
+		}
+
+		/* We ignore binary-compatible relabeling on both ends */
+		while (expr && IsA(expr, RelabelType))
+			expr = ((RelabelType *) expr)->arg;
+
+		/* Locate an EquivalenceClass member matching this expr, if any */
+		foreach(lc2, ec->ec_members)
+		{
+			EquivalenceMember *em = (EquivalenceMember *) lfirst(lc2);
+			Expr	   *em_expr;
+
+			/* Don't match constants */
+			if (em->em_is_const)
+				continue;
+
+			/* Ignore child members */
+			if (em->em_is_child)
+				continue;
+
+			/* Match if same expression (after stripping relabel) */
+			em_expr = em->em_expr;
+			while (em_expr && IsA(em_expr, RelabelType))
+				em_expr = ((RelabelType *) em_expr)->arg;
+
+			if (equal(em_expr, expr))
+				return em->em_expr;
+		}
+
+		i++;
+	}
+
+	/* We didn't find any suitable equivalence class expression */
+	return NULL;
+}
+
+/*
+ * get_indexed_attrs
+ *		Collect the columns of a foreign table marked with the "indexed"
+ *		column option
+ */
+static Bitmapset *
+get_indexed_attrs(Oid foreigntableid, AttrNumber max_attr)
+{
+	Bitmapset  *indexed_attrs = NULL;
+	AttrNumber	attnum;
+
+	for (attnum = 1; attnum <= max_attr; attnum++)
+	{
+		List	   *options = GetForeignColumnOptions(foreigntableid, attnum);
+		ListCell   *lc;
+
+		foreach(lc, options)
+		{
+			DefElem    *def = (DefElem *) lfirst(lc);
+
+			if (strcmp(def->defname, "indexed") == 0 && defGetBoolean(def))
+				indexed_attrs = bms_add_member(indexed_attrs, attnum);
+		}
+	}
+
+	return indexed_attrs;
+}
+
+/*
+ * is_indexed_key_clause
+ *		Is this join clause an equality between an indexed column of baserel
+ *		and an expression of other relations?
+ *
+ * The remote side can answer such a clause with an index lookup, which is
+ * what makes a parameterized scan cheap.
+ */
+static bool
+is_indexed_key_clause(RestrictInfo *rinfo, RelOptInfo *baserel)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) baserel->fdw_private;
+	OpExpr	   *op;
+	Node	   *key;
+
+	/* Only mergejoinable operators are known to be equalities */
+	if (!is_opclause(rinfo->clause) || rinfo->mergeopfamilies == NIL)
+		return false;
+
+	op = (OpExpr *) rinfo->clause;
+	if (list_length(op->args) != 2)
+		return false;
+	if (bms_equal(rinfo->left_relids, baserel->relids))
+		key = (Node *) linitial(op->args);
+	else if (bms_equal(rinfo->right_relids, baserel->relids))
+		key = (Node *) lsecond(op->args);
+	else
+		return false;
+
+	while (key && IsA(key, RelabelType))
+		key = (Node *) ((RelabelType *) key)->arg;
+
+	return (key && IsA(key, Var) &&
+			((Var *) key)->varno == baserel->relid &&
+			bms_is_member(((Var *) key)->varattno, fpinfo->indexed_attrs));
+}
+
 /*
  * Detect whether we want to process an EquivalenceClass member.
  *
@@ -4035,43 +6631,151 @@ estimate_path_cost_size(PlannerInfo *root,
 	Cost		startup_cost;
 	Cost		total_cost;
 	Cost		cpu_per_tuple;
+	OdbcRemoteEstimate remote;
+	List	   *local_param_join_conds = NIL;
 
 	/*
 	 * If the table or the server is configured to use remote estimates,
 	 * connect to the foreign server and execute EXPLAIN to estimate the
 	 * number of rows selected by the restriction+join clauses.  Otherwise,
-	 * estimate rows using whatever statistics we have locally, in a way
-	 * similar to ordinary tables.
+	 * or if the server cannot explain the query, estimate rows using
+	 * whatever statistics we have locally, in a way similar to ordinary
+	 * tables.
 	 */
+	if (fpinfo->use_remote_estimate &&
+		get_remote_estimate(root, foreignrel, param_join_conds, pathkeys,
+							&local_param_join_conds, &remote))
+	{
+		Selectivity local_sel;
+		QualCost	local_cost;
+
+		rows = remote.rows;
+		width = (remote.width > 0) ? remote.width
+			: foreignrel->reltarget->width;
+
+		if (remote.total_cost >= 0)
+		{
+			startup_cost = remote.startup_cost;
+			total_cost = remote.total_cost;
+		}
+		else
+		{
+			/*
+			 * The server told the rows but not what they cost.  Charge for
+			 * producing them, and for sorting them as in the local estimates
+			 * below.
+			 */
+			startup_cost = 0;
+			total_cost = cpu_tuple_cost * rows;
+			if (pathkeys != NIL)
+				total_cost *= DEFAULT_FDW_SORT_MULTIPLIER;
+		}
+
+		retrieved_rows = rows;
 
+		/* Factor in the selectivity of the locally-checked quals */
+		local_sel = clauselist_selectivity(root,
+										   local_param_join_conds,
+										   foreignrel->relid,
+										   JOIN_INNER,
+										   NULL);
+		local_sel *= fpinfo->local_conds_sel;
+
+		rows = clamp_row_est(rows * local_sel);
+
+		/* Add in the eval cost of the locally-checked quals */
+		startup_cost += fpinfo->local_conds_cost.startup;
+		total_cost += fpinfo->local_conds_cost.per_tuple * retrieved_rows;
+		cost_qual_eval(&local_cost, local_param_join_conds, root);
+		startup_cost += local_cost.startup;
+		total_cost += local_cost.per_tuple * retrieved_rows;
+	}
+	else
 	{
 		Cost		run_cost = 0;
 
-		/*
-		 * We don't support join conditions in this mode (hence, no
-		 * parameterized paths can be made).
-		 */
-		Assert(param_join_conds == NIL);
-
 		/*
 		 * Use rows/width estimates made by set_baserel_size_estimates() for
 		 * base foreign relations and set_joinrel_size_estimates() for join
-		 * between foreign relations.
+		 * between foreign relations.  A parameterized scan of a base relation
+		 * returns the rows matching its join conditions for one outer row.
 		 */
-		rows = foreignrel->rows;
+		if (param_join_conds != NIL)
+			rows = get_parameterized_baserel_size(root, foreignrel,
+												  param_join_conds);
+		else
+			rows = foreignrel->rows;
 		width = foreignrel->reltarget->width;
 
 		/* Back into an estimate of the number of retrieved rows. */
 		retrieved_rows = clamp_row_est(rows / fpinfo->local_conds_sel);
 
-		/*
-		 * We will come here again and again with different set of pathkeys
-		 * that caller wants to cost. We don't need to calculate the cost of
-		 * bare scan each time. Instead, use the costs if we have cached them
-		 * already.
-		 */
-		if (fpinfo->rel_startup_cost > 0 && fpinfo->rel_total_cost > 0)
+		if (param_join_conds != NIL)
+		{
+			QualCost	join_cost;
+			bool		index_lookup = false;
+			ListCell   *lc;
+
+			/* Only base relations get parameterized paths */
+			Assert(IS_SIMPLE_REL(foreignrel));
+
+			retrieved_rows = Min(retrieved_rows, foreignrel->tuples);
+
+			foreach(lc, param_join_conds)
+			{
+				RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+				if (is_indexed_key_clause(rinfo, foreignrel))
+				{
+					index_lookup = true;
+					break;
+				}
+			}
+
+			cost_qual_eval(&join_cost, param_join_conds, root);
+			startup_cost = foreignrel->baserestrictcost.startup;
+			startup_cost += join_cost.startup;
+
+			if (index_lookup)
+			{
+				/*
+				 * The join conditions include an equality on an indexed
+				 * column, so cost the scan as a remote index scan: descend
+				 * the index as genericcostestimate() does, then visit each
+				 * matching row with a random page fetch.
+				 */
+				startup_cost += ceil(log(Max(foreignrel->tuples, 2.0)) /
+									 log(2.0)) * cpu_operator_cost;
+
+				cpu_per_tuple = cpu_tuple_cost + cpu_index_tuple_cost +
+					foreignrel->baserestrictcost.per_tuple +
+					join_cost.per_tuple;
+				run_cost = random_page_cost * Min(retrieved_rows,
+												  Max(foreignrel->pages, 1));
+				run_cost += cpu_per_tuple * retrieved_rows;
+			}
+			else
+			{
+				/*
+				 * No join condition can use a remote index, so every rescan
+				 * reads the whole table, checking the join conditions on
+				 * each row.
+				 */
+				cpu_per_tuple = cpu_tuple_cost +
+					foreignrel->baserestrictcost.per_tuple +
+					join_cost.per_tuple;
+				run_cost = seq_page_cost * foreignrel->pages;
+				run_cost += cpu_per_tuple * foreignrel->tuples;
+			}
+		}
+		else if (fpinfo->rel_startup_cost > 0 && fpinfo->rel_total_cost > 0)
 		{
+			/*
+			 * We will come here again and again with different set of
+			 * pathkeys that caller wants to cost. We don't need to calculate
+			 * the cost of bare scan each time. Instead, use the costs if we
+			 * have cached them already.
+			 */
 			startup_cost = fpinfo->rel_startup_cost;
 			run_cost = fpinfo->rel_total_cost - fpinfo->rel_startup_cost;
 		}
@@ -4141,6 +6845,37 @@ estimate_path_cost_size(PlannerInfo *root,
 			run_cost += nrows * remote_conds_cost.per_tuple;
 			run_cost += fpinfo->local_conds_cost.per_tuple * retrieved_rows;
 		}
+		else if (IS_UPPER_REL(foreignrel) &&
+				 fpinfo->stage == UPPERREL_DISTINCT)
+		{
+			PgFdwRelationInfo *ofpinfo;
+			double		input_rows;
+			int			numDistinctCols;
+
+			/*
+			 * Cost the DISTINCT as a hashed aggregation without aggregates,
+			 * per cost_agg(): every input row is hashed on the distinct
+			 * columns, and one row per distinct group comes out.
+			 */
+			ofpinfo = (PgFdwRelationInfo *) fpinfo->outerrel->fdw_private;
+
+			/* Get rows and width from input rel */
+			input_rows = ofpinfo->rows;
+			width = ofpinfo->width;
+
+			numDistinctCols = list_length(root->parse->distinctClause);
+			rows = retrieved_rows =
+				estimate_num_groups(root,
+									get_sortgrouplist_exprs(root->parse->distinctClause,
+															fpinfo->grouped_tlist),
+									input_rows, NULL);
+
+			startup_cost = ofpinfo->rel_startup_cost;
+			startup_cost += (cpu_operator_cost * numDistinctCols) * input_rows;
+
+			run_cost = ofpinfo->rel_total_cost - ofpinfo->rel_startup_cost;
+			run_cost += cpu_tuple_cost * rows;
+		}
 		else if (IS_UPPER_REL(foreignrel))
 		{
 			PgFdwRelationInfo *ofpinfo;
@@ -4180,10 +6915,45 @@ estimate_path_cost_size(PlannerInfo *root,
 
 			/* Get number of grouping columns and possible number of groups */
 			numGroupCols = list_length(root->parse->groupClause);
-			numGroups = estimate_num_groups(root,
-											get_sortgrouplist_exprs(root->parse->groupClause,
-																	fpinfo->grouped_tlist),
-											input_rows, NULL);
+			if (root->parse->groupingSets)
+			{
+				List	   *gsets;
+				ListCell   *lc;
+
+				/*
+				 * The remote server emits one row per group of each grouping
+				 * set, so add up the groups of the expanded sets.  An empty
+				 * set yields a single row.
+				 */
+				gsets = expand_grouping_sets(root->parse->groupingSets, -1);
+				numGroups = 0;
+				foreach(lc, gsets)
+				{
+					List	   *gset = (List *) lfirst(lc);
+					List	   *groupExprs = NIL;
+					ListCell   *lc2;
+
+					foreach(lc2, gset)
+					{
+						TargetEntry *tle;
+
+						tle = get_sortgroupref_tle(lfirst_int(lc2),
+												   fpinfo->grouped_tlist);
+						groupExprs = lappend(groupExprs, tle->expr);
+					}
+
+					if (groupExprs == NIL)
+						numGroups += 1;
+					else
+						numGroups += estimate_num_groups(root, groupExprs,
+														 input_rows, NULL);
+				}
+			}
+			else
+				numGroups = estimate_num_groups(root,
+												get_sortgrouplist_exprs(root->parse->groupClause,
+																		fpinfo->grouped_tlist),
+												input_rows, NULL);
 
 			/*
 			 * Number of rows expected from foreign server will be same as
@@ -4286,6 +7056,80 @@ estimate_path_cost_size(PlannerInfo *root,
 	*p_total_cost = total_cost;
 }
 
+/*
+ * get_remote_estimate
+ *		Have the foreign server estimate the query that a scan of foreignrel
+ *		with the given join conditions and pathkeys would send.
+ *
+ * The join conditions that are not sent are returned in
+ * *local_param_join_conds.  Returns false if the server gives no estimate,
+ * leaving the caller to estimate locally.
+ */
+static bool
+get_remote_estimate(PlannerInfo *root,
+					RelOptInfo *foreignrel,
+					List *param_join_conds,
+					List *pathkeys,
+					List **local_param_join_conds,
+					OdbcRemoteEstimate *est)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
+	List	   *remote_param_join_conds;
+	List	   *fdw_scan_tlist = NIL;
+	List	   *remote_conds;
+	StringInfoData sql;
+	SQLHDBC		dbc;
+	bool		found;
+
+	/* Required only to be passed to odbc_deparseSelectStmtForRel */
+	List	   *retrieved_attrs;
+
+	/*
+	 * param_join_conds might contain both clauses that are safe to send
+	 * across, and clauses that aren't.
+	 */
+	odbc_classifyConditions(root, foreignrel, param_join_conds,
+							&remote_param_join_conds, local_param_join_conds);
+
+	/*
+	 * Servers other than PostgreSQL get a plain NULL in place of the
+	 * parameters, and would estimate the join conditions as never true.
+	 */
+	if (!fpinfo->dialect.postgres_syntax && remote_param_join_conds != NIL)
+		return false;
+
+	/* Build the list of columns to be fetched from the foreign server. */
+	if (IS_JOIN_REL(foreignrel) || IS_UPPER_REL(foreignrel))
+		fdw_scan_tlist = odbc_build_tlist_to_deparse(foreignrel);
+
+	/*
+	 * The complete list of remote conditions includes everything from
+	 * baserestrictinfo plus any extra join_conds relevant to this particular
+	 * path.
+	 */
+	remote_conds = list_concat(list_copy(remote_param_join_conds),
+							   fpinfo->remote_conds);
+
+	/*
+	 * Construct the SELECT to be estimated.  Params and other-relation Vars
+	 * are replaced by dummy values, so don't request params_list.
+	 */
+	initStringInfo(&sql);
+	odbc_deparseSelectStmtForRel(&sql, root, foreignrel, fdw_scan_tlist,
+								 remote_conds, pathkeys, false, false,
+								 &retrieved_attrs, NULL);
+
+	/* Get the remote estimate, from the cache if it has been asked for */
+	dbc = odbc_GetConnection(fpinfo->conn_str, fpinfo->server->serverid,
+							 fpinfo->user->umid);
+	found = odbc_get_remote_estimate(dbc, fpinfo->server->serverid,
+									 fpinfo->estimator, sql.data, est);
+	odbc_ReleaseConnection(dbc);
+
+	pfree(sql.data);
+	return found;
+}
+
 static List *
 get_useful_pathkeys_for_relation(PlannerInfo *root, RelOptInfo *rel)
 {
@@ -4329,7 +7173,10 @@ get_useful_pathkeys_for_relation(PlannerInfo *root, RelOptInfo *rel)
 		}
 
 		if (query_pathkeys_ok)
+		{
 			useful_pathkeys_list = list_make1(list_copy(root->query_pathkeys));
+			fpinfo->qp_is_pushdown_safe = true;
+		}
 	}
 
 	/*
@@ -4486,7 +7333,8 @@ get_useful_ecs_for_relation(PlannerInfo *root, RelOptInfo *rel)
  *		Add paths for post-join operations like aggregation, grouping etc. if
  *		corresponding operations are safe to push down.
  *
- * Right now, we only support aggregate, grouping and having clause pushdown.
+ * Right now, we support aggregate, grouping and having clause pushdown, and
+ * DISTINCT, ORDER BY and LIMIT pushdown on top of that or of a scan or join.
  */
 static void
 odbcGetForeignUpperPaths(PlannerInfo *root, UpperRelationKind stage,
@@ -4503,14 +7351,36 @@ odbcGetForeignUpperPaths(PlannerInfo *root, UpperRelationKind stage,
 		return;
 
 	/* Ignore stages we don't support; and skip any duplicate calls. */
-	if (stage != UPPERREL_GROUP_AGG || output_rel->fdw_private)
+	if ((stage != UPPERREL_GROUP_AGG &&
+		 stage != UPPERREL_DISTINCT &&
+		 stage != UPPERREL_ORDERED &&
+		 stage != UPPERREL_FINAL) ||
+		output_rel->fdw_private)
 		return;
 
 	fpinfo = (PgFdwRelationInfo *) palloc0(sizeof(PgFdwRelationInfo));
 	fpinfo->pushdown_safe = false;
+	fpinfo->stage = stage;
 	output_rel->fdw_private = fpinfo;
 
-	add_foreign_grouping_paths(root, input_rel, output_rel);
+	switch (stage)
+	{
+		case UPPERREL_GROUP_AGG:
+			add_foreign_grouping_paths(root, input_rel, output_rel);
+			break;
+		case UPPERREL_DISTINCT:
+			add_foreign_distinct_paths(root, input_rel, output_rel);
+			break;
+		case UPPERREL_ORDERED:
+			add_foreign_ordered_paths(root, input_rel, output_rel);
+			break;
+		case UPPERREL_FINAL:
+			add_foreign_final_paths(root, input_rel, output_rel);
+			break;
+		default:
+			elog(ERROR, "unexpected upper relation: %d", (int) stage);
+			break;
+	}
 }
 
 /*
@@ -4525,23 +7395,384 @@ add_foreign_grouping_paths(PlannerInfo *root, RelOptInfo *input_rel,
 						   RelOptInfo *grouped_rel)
 {
 	Query	   *parse = root->parse;
-	PgFdwRelationInfo *ifpinfo = input_rel->fdw_private;
-	PgFdwRelationInfo *fpinfo = grouped_rel->fdw_private;
-	ForeignPath *grouppath;
-	PathTarget *grouping_target;
+	PgFdwRelationInfo *ifpinfo = input_rel->fdw_private;
+	PgFdwRelationInfo *fpinfo = grouped_rel->fdw_private;
+	ForeignPath *grouppath;
+	PathTarget *grouping_target;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+	/* Nothing to be done, if there is no grouping or aggregation required. */
+	if (!parse->groupClause && !parse->groupingSets && !parse->hasAggs &&
+		!root->hasHavingQual)
+		return;
+
+	grouping_target = root->upper_targets[UPPERREL_GROUP_AGG];
+
+	/* save the input_rel as outerrel in fpinfo */
+	fpinfo->outerrel = input_rel;
+
+	/*
+	 * Copy foreign table, foreign server, user mapping, FDW options etc.
+	 * details from the input relation's fpinfo.
+	 */
+	fpinfo->table = ifpinfo->table;
+	fpinfo->server = ifpinfo->server;
+	fpinfo->user = ifpinfo->user;
+	fpinfo->conn_str = ifpinfo->conn_str;
+	merge_fdw_options(fpinfo, ifpinfo, NULL);
+
+	/* Assess if it is safe to push down aggregation and grouping. */
+	if (!foreign_grouping_ok(root, grouped_rel))
+		return;
+
+	/* Estimate the cost of push down */
+	estimate_path_cost_size(root, grouped_rel, NIL, NIL, &rows,
+							&width, &startup_cost, &total_cost);
+
+	/* Now update this information in the fpinfo */
+	fpinfo->rows = rows;
+	fpinfo->width = width;
+	fpinfo->startup_cost = startup_cost;
+	fpinfo->total_cost = total_cost;
+
+	/* Create and add foreign path to the grouping relation. */
+	grouppath = create_foreignscan_path(root,
+										grouped_rel,
+										grouping_target,
+										rows,
+										startup_cost,
+										total_cost,
+										NIL,	/* no pathkeys */
+										NULL,	/* no required_outer */
+										NULL,
+										NIL);	/* no fdw_private */
+
+	/* Add generated path into grouped_rel by add_path(). */
+	add_path(grouped_rel, (Path *) grouppath);
+}
+
+/*
+ * add_foreign_distinct_paths
+ *		Add foreign path for performing the query's DISTINCT remotely.
+ *
+ * Given input_rel represents the underlying scan, join or grouping.  The
+ * paths are added to the given distinct_rel.
+ */
+static void
+add_foreign_distinct_paths(PlannerInfo *root, RelOptInfo *input_rel,
+						   RelOptInfo *distinct_rel)
+{
+	Query	   *parse = root->parse;
+	PgFdwRelationInfo *ifpinfo = input_rel->fdw_private;
+	PgFdwRelationInfo *fpinfo = distinct_rel->fdw_private;
+	PathTarget *distinct_target = root->upper_targets[UPPERREL_GROUP_AGG];
+	ForeignPath *distinct_path;
+	List	   *tlist = NIL;
+	ListCell   *lc;
+	int			i;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+	/*
+	 * DISTINCT ON has no counterpart in other SQL dialects, and we don't
+	 * support cases where there are any SRFs in the targetlist.
+	 */
+	if (!parse->distinctClause || parse->hasDistinctOn ||
+		parse->hasTargetSRFs)
+		return;
+
+	/* The input_rel should be a base, join, or grouping relation */
+	if (!(input_rel->reloptkind == RELOPT_BASEREL ||
+		  input_rel->reloptkind == RELOPT_JOINREL ||
+		  (input_rel->reloptkind == RELOPT_UPPER_REL &&
+		   ifpinfo->stage == UPPERREL_GROUP_AGG)))
+		return;
+
+	/*
+	 * If the underlying relation has any local conditions, those conditions
+	 * are required to be applied before removing duplicates.
+	 */
+	if (ifpinfo->local_conds)
+		return;
+
+	/* save the input_rel as outerrel in fpinfo */
+	fpinfo->outerrel = input_rel;
+
+	/*
+	 * Copy foreign table, foreign server, user mapping, FDW options etc.
+	 * details from the input relation's fpinfo.
+	 */
+	fpinfo->table = ifpinfo->table;
+	fpinfo->server = ifpinfo->server;
+	fpinfo->user = ifpinfo->user;
+	fpinfo->conn_str = ifpinfo->conn_str;
+	merge_fdw_options(fpinfo, ifpinfo, NULL);
+
+	/*
+	 * The input of the DISTINCT is computed by the grouping target, as
+	 * window functions are not pushed down.  Every expression of it must be
+	 * a DISTINCT column, or the remote server would keep rows that differ
+	 * only in the others; and it must be safe to evaluate remotely, on top of
+	 * the input relation.
+	 */
+	i = 0;
+	foreach(lc, distinct_target->exprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+		Index		sgref = get_pathtarget_sortgroupref(distinct_target, i);
+		TargetEntry *tle;
+
+		if (!sgref ||
+			!get_sortgroupref_clause_noerr(sgref, parse->distinctClause))
+			return;
+
+		if (!odbc_is_foreign_expr(root, input_rel, expr))
+			return;
+
+		tle = makeTargetEntry(expr, list_length(tlist) + 1, NULL, false);
+		tle->ressortgroupref = sgref;
+		tlist = lappend(tlist, tle);
+
+		i++;
+	}
+
+	/* Store generated targetlist */
+	fpinfo->grouped_tlist = tlist;
+
+	/* Safe to pushdown */
+	fpinfo->pushdown_safe = true;
+
+	/*
+	 * Set cached relation costs to some negative value, so that we can detect
+	 * when they are set to some sensible costs, during one (usually the
+	 * first) of the calls to estimate_path_cost_size().
+	 */
+	fpinfo->rel_startup_cost = -1;
+	fpinfo->rel_total_cost = -1;
+
+	/*
+	 * Set the string describing this distinct relation to be used in EXPLAIN
+	 * output of corresponding ForeignScan.
+	 */
+	fpinfo->relation_name = makeStringInfo();
+	appendStringInfo(fpinfo->relation_name, "Distinct on (%s)",
+					 ifpinfo->relation_name->data);
+
+	/* Estimate the cost of push down */
+	estimate_path_cost_size(root, distinct_rel, NIL, NIL, &rows,
+							&width, &startup_cost, &total_cost);
+
+	/* Now update this information in the fpinfo */
+	fpinfo->rows = rows;
+	fpinfo->width = width;
+	fpinfo->startup_cost = startup_cost;
+	fpinfo->total_cost = total_cost;
+
+	/* Create and add foreign path to the distinct relation. */
+	distinct_path = create_foreignscan_path(root,
+											distinct_rel,
+											distinct_target,
+											rows,
+											startup_cost,
+											total_cost,
+											NIL,	/* no pathkeys */
+											NULL,	/* no required_outer */
+											NULL,
+											NIL);	/* no fdw_private */
+
+	add_path(distinct_rel, (Path *) distinct_path);
+}
+
+/*
+ * add_foreign_ordered_paths
+ *		Add foreign paths for performing the final sort remotely.
+ *
+ * Given input_rel contains the source-data Paths.  The paths are added to the
+ * given ordered_rel.
+ */
+static void
+add_foreign_ordered_paths(PlannerInfo *root, RelOptInfo *input_rel,
+						  RelOptInfo *ordered_rel)
+{
+	PgFdwRelationInfo *ifpinfo = input_rel->fdw_private;
+	PgFdwRelationInfo *fpinfo = ordered_rel->fdw_private;
+	PathTarget *grouping_target = root->upper_targets[UPPERREL_GROUP_AGG];
+	ForeignPath *ordered_path;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+	ListCell   *lc;
+
+	/* Shouldn't get here unless the query has ORDER BY */
+	Assert(root->parse->sortClause);
+
+	/* We don't support cases where there are any SRFs in the targetlist */
+	if (root->parse->hasTargetSRFs)
+		return;
+
+	/* Save the input_rel as outerrel in fpinfo */
+	fpinfo->outerrel = input_rel;
+
+	/*
+	 * Copy foreign table, foreign server, user mapping, FDW options etc.
+	 * details from the input relation's fpinfo.
+	 */
+	fpinfo->table = ifpinfo->table;
+	fpinfo->server = ifpinfo->server;
+	fpinfo->user = ifpinfo->user;
+	fpinfo->conn_str = ifpinfo->conn_str;
+	merge_fdw_options(fpinfo, ifpinfo, NULL);
+
+	/*
+	 * If the input_rel is a base or join relation, we would already have
+	 * considered pushing down the final sort to the remote server when
+	 * creating pre-sorted foreign paths for that relation, because the
+	 * query_pathkeys is set to the root->sort_pathkeys in that case (see
+	 * standard_qp_callback()).
+	 */
+	if (input_rel->reloptkind == RELOPT_BASEREL ||
+		input_rel->reloptkind == RELOPT_JOINREL)
+	{
+		Assert(root->query_pathkeys == root->sort_pathkeys);
+
+		/* Safe to push down if the query_pathkeys is safe to push down */
+		fpinfo->pushdown_safe = ifpinfo->qp_is_pushdown_safe;
+
+		return;
+	}
+
+	/* Otherwise, the input_rel should be a grouping or distinct relation */
+	if (input_rel->reloptkind != RELOPT_UPPER_REL ||
+		(ifpinfo->stage != UPPERREL_GROUP_AGG &&
+		 ifpinfo->stage != UPPERREL_DISTINCT))
+		return;
+
+	/*
+	 * We try to create a path below by extending a simple foreign path for
+	 * the underlying grouping or distinct relation to perform the final sort
+	 * remotely.  Their paths have no pathkeys of their own, so the ORDER BY
+	 * is deparsed from the sort columns of the grouping target, which is
+	 * also the input of the DISTINCT as window functions are not pushed
+	 * down.
+	 */
+
+	/* Assess if it is safe to push down the final sort */
+	foreach(lc, root->sort_pathkeys)
+	{
+		PathKey    *pathkey = (PathKey *) lfirst(lc);
+		EquivalenceClass *pathkey_ec = pathkey->pk_eclass;
+		Expr	   *sort_expr;
+
+		/*
+		 * odbc_is_foreign_expr would detect volatile expressions as well, but
+		 * checking ec_has_volatile here saves some cycles.
+		 */
+		if (pathkey_ec->ec_has_volatile)
+			return;
+
+		/* Get the sort expression for the pathkey_ec */
+		sort_expr = odbc_find_em_expr_for_input_target(root, pathkey_ec,
+													   grouping_target);
+
+		/* If it's unsafe to remote, we cannot push down the final sort */
+		if (!sort_expr || !odbc_is_foreign_expr(root, input_rel, sort_expr))
+			return;
+	}
+
+	/* Safe to push down */
+	fpinfo->pushdown_safe = true;
+
+	/* Estimate the costs of performing the final sort remotely */
+	estimate_path_cost_size(root, input_rel, NIL, root->sort_pathkeys,
+							&rows, &width, &startup_cost, &total_cost);
+
+	/*
+	 * Create foreign ordering path on the grouping relation, whose fpinfo
+	 * drives the deparsing, and add it to the ordered_rel.
+	 */
+	ordered_path = create_foreignscan_path(root,
+										   input_rel,
+										   root->upper_targets[UPPERREL_FINAL],
+										   rows,
+										   startup_cost,
+										   total_cost,
+										   root->sort_pathkeys,
+										   NULL,	/* no required_outer */
+										   NULL,	/* no extra plan */
+										   NIL);	/* no fdw_private */
+
+	add_path(ordered_rel, (Path *) ordered_path);
+}
+
+/*
+ * add_foreign_final_paths
+ *		Add foreign path for performing the query's LIMIT remotely.
+ *
+ * Given input_rel contains the source-data Paths.  The paths are added to the
+ * given final_rel.  Since no Limit node is put on top of a path of the
+ * final_rel, the path must return only the rows the LIMIT and OFFSET let
+ * through.
+ */
+static void
+add_foreign_final_paths(PlannerInfo *root, RelOptInfo *input_rel,
+						RelOptInfo *final_rel)
+{
+	Query	   *parse = root->parse;
+	PgFdwRelationInfo *ifpinfo = (PgFdwRelationInfo *) input_rel->fdw_private;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) final_rel->fdw_private;
+	List	   *pathkeys = NIL;
+	int64		count;
+	int64		offset;
+	double		input_rows;
 	double		rows;
 	int			width;
 	Cost		startup_cost;
 	Cost		total_cost;
+	List	   *fdw_private;
+	ForeignPath *final_path;
 
-	/* Nothing to be done, if there is no grouping or aggregation required. */
-	if (!parse->groupClause && !parse->groupingSets && !parse->hasAggs &&
-		!root->hasHavingQual)
+	/* Currently, we only support this for SELECT commands */
+	if (parse->commandType != CMD_SELECT)
 		return;
 
-	grouping_target = root->upper_targets[UPPERREL_GROUP_AGG];
+	/*
+	 * No work if there is no LIMIT; leave FOR UPDATE/SHARE and SRFs in the
+	 * targetlist to be handled locally.
+	 */
+	if (!parse->limitCount && !parse->limitOffset)
+		return;
+	if (parse->rowMarks || parse->hasTargetSRFs)
+		return;
 
-	/* save the input_rel as outerrel in fpinfo */
+	/*
+	 * If the input_rel is an ordered relation, replace the input_rel with its
+	 * input relation; the sort is then done remotely below the LIMIT.
+	 */
+	if (input_rel->reloptkind == RELOPT_UPPER_REL &&
+		ifpinfo->stage == UPPERREL_ORDERED)
+	{
+		input_rel = ifpinfo->outerrel;
+		ifpinfo = (PgFdwRelationInfo *) input_rel->fdw_private;
+		pathkeys = root->sort_pathkeys;
+	}
+
+	/* The input_rel should be a base, join, grouping or distinct relation */
+	if (!(input_rel->reloptkind == RELOPT_BASEREL ||
+		  input_rel->reloptkind == RELOPT_JOINREL ||
+		  (input_rel->reloptkind == RELOPT_UPPER_REL &&
+		   (ifpinfo->stage == UPPERREL_GROUP_AGG ||
+			ifpinfo->stage == UPPERREL_DISTINCT))))
+		return;
+	if (!ifpinfo->pushdown_safe)
+		return;
+
+	/* Save the input_rel as outerrel in fpinfo */
 	fpinfo->outerrel = input_rel;
 
 	/*
@@ -4551,36 +7782,114 @@ add_foreign_grouping_paths(PlannerInfo *root, RelOptInfo *input_rel,
 	fpinfo->table = ifpinfo->table;
 	fpinfo->server = ifpinfo->server;
 	fpinfo->user = ifpinfo->user;
+	fpinfo->conn_str = ifpinfo->conn_str;
 	merge_fdw_options(fpinfo, ifpinfo, NULL);
 
-	/* Assess if it is safe to push down aggregation and grouping. */
-	if (!foreign_grouping_ok(root, grouped_rel))
+	/*
+	 * If the underlying relation has any local conditions, the LIMIT/OFFSET
+	 * cannot be pushed down.
+	 */
+	if (ifpinfo->local_conds)
 		return;
 
-	/* Estimate the cost of push down */
-	estimate_path_cost_size(root, grouped_rel, NIL, NIL, &rows,
-							&width, &startup_cost, &total_cost);
+	/*
+	 * The LIMIT and OFFSET are written into the remote query as literals, so
+	 * they must be constants.  A LIMIT 0 or LIMIT ALL is not worth the
+	 * trouble; neither is an OFFSET without LIMIT.
+	 */
+	if (!odbc_get_limit_values(parse, &count, &offset) || count <= 0)
+		return;
 
-	/* Now update this information in the fpinfo */
-	fpinfo->rows = rows;
-	fpinfo->width = width;
-	fpinfo->startup_cost = startup_cost;
-	fpinfo->total_cost = total_cost;
+	/* TOP and SQL_ATTR_MAX_ROWS cannot skip rows */
+	if (offset > 0 &&
+		(fpinfo->limit_syntax == ODBC_LIMIT_TOP ||
+		 fpinfo->limit_syntax == ODBC_LIMIT_MAX_ROWS))
+		return;
 
-	/* Create and add foreign path to the grouping relation. */
-	grouppath = create_foreignscan_path(root,
-										grouped_rel,
-										grouping_target,
-										rows,
-										startup_cost,
-										total_cost,
-										NIL,	/* no pathkeys */
-										NULL,	/* no required_outer */
-										NULL,
-										NIL);	/* no fdw_private */
+	/* Safe to push down */
+	fpinfo->pushdown_safe = true;
 
-	/* Add generated path into grouped_rel by add_path(). */
-	add_path(grouped_rel, (Path *) grouppath);
+	/*
+	 * Estimate the costs of the underlying relation, sorted if need be, and
+	 * take the share of them needed to produce the rows the LIMIT returns.
+	 */
+	estimate_path_cost_size(root, input_rel, NIL, pathkeys, &rows, &width,
+							&startup_cost, &total_cost);
+	input_rows = rows;
+	adjust_limit_rows_costs(&rows, &startup_cost, &total_cost, offset, count);
+
+	/*
+	 * The core code costs a local Limit on top of the scan the same way,
+	 * without accounting for the rows the scan fetches ahead of it, so there
+	 * would be no difference between the two.  Tweak the costs of the remote
+	 * LIMIT to ensure we'll prefer it if the LIMIT is a useful one.
+	 */
+	if (count + offset < input_rows)
+		total_cost -= (total_cost - startup_cost) * 0.05 *
+			(input_rows - (count + offset)) / input_rows;
+
+	/*
+	 * Build the fdw_private list that will be used by odbcGetForeignPlan.
+	 * Items in the list must match order in enum FdwPathPrivateIndex.
+	 */
+	fdw_private = list_make1(makeInteger(true));
+
+	/*
+	 * Create the path on the underlying relation, whose fdw_private drives
+	 * the deparsing; it is added to the final_rel, though.
+	 */
+	final_path = create_foreignscan_path(root,
+										 input_rel,
+										 root->upper_targets[UPPERREL_FINAL],
+										 rows,
+										 startup_cost,
+										 total_cost,
+										 pathkeys,
+										 NULL,	/* no required_outer */
+										 NULL,	/* no extra plan */
+										 fdw_private);
+
+	/* and add it to the final_rel */
+	add_path(final_rel, (Path *) final_path);
+}
+
+/*
+ * adjust_limit_rows_costs
+ *		Adjust the size and cost estimates of a path for a LIMIT count
+ *		OFFSET offset on top of it, as create_limit_path() does.
+ */
+static void
+adjust_limit_rows_costs(double *rows, Cost *startup_cost, Cost *total_cost,
+						int64 offset, int64 count)
+{
+	double		input_rows = *rows;
+	Cost		input_startup_cost = *startup_cost;
+	Cost		input_total_cost = *total_cost;
+
+	if (offset > 0)
+	{
+		double		offset_rows = Min((double) offset, *rows);
+
+		if (input_rows > 0)
+			*startup_cost += (input_total_cost - input_startup_cost) *
+				offset_rows / input_rows;
+		*rows -= offset_rows;
+		if (*rows < 1)
+			*rows = 1;
+	}
+
+	if (count > 0)
+	{
+		double		count_rows = Min((double) count, *rows);
+
+		if (input_rows > 0)
+			*total_cost = *startup_cost +
+				(input_total_cost - input_startup_cost) *
+				count_rows / input_rows;
+		*rows = count_rows;
+		if (*rows < 1)
+			*rows = 1;
+	}
 }
 
 static bool
@@ -4595,8 +7904,11 @@ foreign_grouping_ok(PlannerInfo *root, RelOptInfo *grouped_rel)
 	int			i;
 	List	   *tlist = NIL;
 
-	/* We currently don't support pushing Grouping Sets. */
-	if (query->groupingSets)
+	/*
+	 * Grouping sets, ROLLUP and CUBE are pushed down only when the server is
+	 * known to support them; otherwise aggregate locally.
+	 */
+	if (query->groupingSets && !fpinfo->grouping_sets)
 		return false;
 
 	/* Get the fpinfo of the underlying scan relation. */
@@ -4685,7 +7997,7 @@ foreign_grouping_ok(PlannerInfo *root, RelOptInfo *grouped_rel)
 				{
 					Expr	   *expr = (Expr *) lfirst(l);
 
-					if (IsA(expr, Aggref))
+					if (IsA(expr, Aggref) || IsA(expr, GroupingFunc))
 						tlist = add_to_flat_tlist(tlist, list_make1(expr));
 				}
 			}
@@ -4738,7 +8050,7 @@ foreign_grouping_ok(PlannerInfo *root, RelOptInfo *grouped_rel)
 
 		foreach(lc, fpinfo->local_conds)
 		{
-			RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+			RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
 
 			aggvars = list_concat(aggvars,
 								  pull_var_clause((Node *) rinfo->clause,
@@ -4755,7 +8067,7 @@ foreign_grouping_ok(PlannerInfo *root, RelOptInfo *grouped_rel)
 			 * part of GROUP BY clause which are checked above, so no need to
 			 * access them again here.
 			 */
-			if (IsA(expr, Aggref))
+			if (IsA(expr, Aggref) || IsA(expr, GroupingFunc))
 			{
 				if (!odbc_is_foreign_expr(root, grouped_rel, expr))
 					return false;
@@ -4791,6 +8103,390 @@ foreign_grouping_ok(PlannerInfo *root, RelOptInfo *grouped_rel)
 }
 #endif
 
+/*
+ * Assess whether the join between inner and outer relations can be pushed down
+ * to the foreign server. As a side effect, save information we obtain in this
+ * function to PgFdwRelationInfo passed in.
+ */
+static bool
+foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel, JoinType jointype,
+				RelOptInfo *outerrel, RelOptInfo *innerrel,
+				JoinPathExtraData *extra)
+{
+	PgFdwRelationInfo *fpinfo;
+	PgFdwRelationInfo *fpinfo_o;
+	PgFdwRelationInfo *fpinfo_i;
+	ListCell   *lc;
+	List	   *joinclauses;
+
+	/*
+	 * We support pushing down INNER, LEFT, RIGHT and FULL OUTER joins.
+	 * Constructing queries representing SEMI and ANTI joins is hard, hence
+	 * not considered right now.
+	 */
+	if (jointype != JOIN_INNER && jointype != JOIN_LEFT &&
+		jointype != JOIN_RIGHT && jointype != JOIN_FULL)
+		return false;
+
+	/*
+	 * If either of the joining relations is marked as unsafe to pushdown, the
+	 * join can not be pushed down.
+	 */
+	fpinfo = (PgFdwRelationInfo *) joinrel->fdw_private;
+	fpinfo_o = (PgFdwRelationInfo *) outerrel->fdw_private;
+	fpinfo_i = (PgFdwRelationInfo *) innerrel->fdw_private;
+	if (!fpinfo_o || !fpinfo_o->pushdown_safe ||
+		!fpinfo_i || !fpinfo_i->pushdown_safe)
+		return false;
+
+	/*
+	 * The core code only offers joins between relations of the same server
+	 * and user, but ODBC attributes can also be set per table; both sides
+	 * must be reached through the same connection.
+	 */
+	if (strcmp(fpinfo_o->conn_str, fpinfo_i->conn_str) != 0)
+		return false;
+
+	/*
+	 * If joining relations have local conditions, those conditions are
+	 * required to be applied before joining the relations. Hence the join can
+	 * not be pushed down.
+	 */
+	if (fpinfo_o->local_conds || fpinfo_i->local_conds)
+		return false;
+
+	/*
+	 * Merge FDW options.  We might be tempted to do this after we have deemed
+	 * the foreign join to be OK.  But we must do this beforehand so that we
+	 * know which quals can be evaluated on the foreign server, which might
+	 * depend on shippable_extensions.
+	 */
+	fpinfo->server = fpinfo_o->server;
+	fpinfo->user = fpinfo_o->user;
+	fpinfo->conn_str = fpinfo_o->conn_str;
+	merge_fdw_options(fpinfo, fpinfo_o, fpinfo_i);
+
+	/*
+	 * Whole-row references and system columns of a joined relation are
+	 * deparsed with ROW() and casts that only PostgreSQL understands.
+	 */
+	if (!fpinfo->dialect.postgres_syntax)
+	{
+		List	   *vars = pull_var_clause((Node *) joinrel->reltarget->exprs,
+										   PVC_RECURSE_PLACEHOLDERS);
+
+		foreach(lc, vars)
+		{
+			Var		   *var = (Var *) lfirst(lc);
+
+			if (IsA(var, Var) && var->varattno <= 0)
+				return false;
+		}
+	}
+
+	/*
+	 * Separate restrict list into join quals and pushed-down (other) quals.
+	 *
+	 * Join quals belonging to an outer join must all be shippable, else we
+	 * cannot execute the join remotely.  Add such quals to 'joinclauses'.
+	 *
+	 * Add other quals to fpinfo->remote_conds if they are shippable, else to
+	 * fpinfo->local_conds.  In an inner join it's okay to execute conditions
+	 * either locally or remotely; the same is true for pushed-down conditions
+	 * at an outer join.
+	 *
+	 * Note we might return failure after having already scribbled on
+	 * fpinfo->remote_conds and fpinfo->local_conds.  That's okay because we
+	 * won't consult those lists again if we deem the join unshippable.
+	 */
+	joinclauses = NIL;
+	foreach(lc, extra->restrictlist)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		bool		is_remote_clause = odbc_is_foreign_expr(root, joinrel,
+															rinfo->clause);
+
+		if (IS_OUTER_JOIN(jointype) && !rinfo->is_pushed_down)
+		{
+			if (!is_remote_clause)
+				return false;
+			joinclauses = lappend(joinclauses, rinfo);
+		}
+		else
+		{
+			if (is_remote_clause)
+				fpinfo->remote_conds = lappend(fpinfo->remote_conds, rinfo);
+			else
+				fpinfo->local_conds = lappend(fpinfo->local_conds, rinfo);
+		}
+	}
+
+	/*
+	 * deparseExplicitTargetList() isn't smart enough to handle anything other
+	 * than a Var.  In particular, if there's some PlaceHolderVar that would
+	 * need to be evaluated within this join tree (because there's an upper
+	 * reference to a quantity that may go to NULL as a result of an outer
+	 * join), then we can't try to push the join down because we'll fail when
+	 * we get to deparseExplicitTargetList().  However, a PlaceHolderVar that
+	 * needs to be evaluated *at the top* of this join tree is OK, because we
+	 * can do that locally after fetching the results from the remote side.
+	 */
+	foreach(lc, root->placeholder_list)
+	{
+		PlaceHolderInfo *phinfo = lfirst(lc);
+
+		if (bms_is_subset(phinfo->ph_eval_at, joinrel->relids) &&
+			bms_nonempty_difference(joinrel->relids, phinfo->ph_eval_at))
+			return false;
+	}
+
+	/* Save the join clauses, for later use. */
+	fpinfo->joinclauses = joinclauses;
+
+	fpinfo->outerrel = outerrel;
+	fpinfo->innerrel = innerrel;
+	fpinfo->jointype = jointype;
+
+	/*
+	 * By default, both the input relations are not required to be deparsed as
+	 * subqueries, but there might be some relations covered by the input
+	 * relations that are required to be deparsed as subqueries, so save the
+	 * relids of those relations for later use by the deparser.
+	 */
+	fpinfo->make_outerrel_subquery = false;
+	fpinfo->make_innerrel_subquery = false;
+	Assert(bms_is_subset(fpinfo_o->lower_subquery_rels, outerrel->relids));
+	Assert(bms_is_subset(fpinfo_i->lower_subquery_rels, innerrel->relids));
+	fpinfo->lower_subquery_rels = bms_union(fpinfo_o->lower_subquery_rels,
+											fpinfo_i->lower_subquery_rels);
+
+	/*
+	 * Pull the other remote conditions from the joining relations into join
+	 * clauses or other remote clauses (remote_conds) of this relation
+	 * wherever possible. This avoids building subqueries at every join step.
+	 *
+	 * For an inner join, clauses from both the relations are added to the
+	 * other remote clauses. For LEFT and RIGHT OUTER join, the clauses from
+	 * the outer side are added to remote_conds since those can be evaluated
+	 * after the join is evaluated. The clauses from inner side are added to
+	 * the joinclauses, since they need to be evaluated while constructing the
+	 * join.
+	 *
+	 * For a FULL OUTER JOIN, the other clauses from either relation can not
+	 * be added to the joinclauses or remote_conds, since each relation acts
+	 * as an outer relation for the other.
+	 *
+	 * The joining sides can not have local conditions, thus no need to test
+	 * shippability of the clauses being pulled up.
+	 */
+	switch (jointype)
+	{
+		case JOIN_INNER:
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   list_copy(fpinfo_i->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   list_copy(fpinfo_o->remote_conds));
+			break;
+
+		case JOIN_LEFT:
+			fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+											  list_copy(fpinfo_i->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   list_copy(fpinfo_o->remote_conds));
+			break;
+
+		case JOIN_RIGHT:
+			fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+											  list_copy(fpinfo_o->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   list_copy(fpinfo_i->remote_conds));
+			break;
+
+		case JOIN_FULL:
+
+			/*
+			 * In this case, if any of the input relations has conditions, we
+			 * need to deparse that relation as a subquery so that the
+			 * conditions can be evaluated before the join.  Remember it in
+			 * the fpinfo of this relation so that the deparser can take
+			 * appropriate action.  Also, save the relids of base relations
+			 * covered by that relation for later use by the deparser.
+			 */
+			if (fpinfo_o->remote_conds)
+			{
+				fpinfo->make_outerrel_subquery = true;
+				fpinfo->lower_subquery_rels =
+					bms_add_members(fpinfo->lower_subquery_rels,
+									outerrel->relids);
+			}
+			if (fpinfo_i->remote_conds)
+			{
+				fpinfo->make_innerrel_subquery = true;
+				fpinfo->lower_subquery_rels =
+					bms_add_members(fpinfo->lower_subquery_rels,
+									innerrel->relids);
+			}
+			break;
+
+		default:
+			/* Should not happen, we have just checked this above */
+			elog(ERROR, "unsupported join type %d", jointype);
+	}
+
+	/*
+	 * For an inner join, all restrictions can be treated alike. Treating the
+	 * pushed down conditions as join conditions allows a top level full outer
+	 * join to be deparsed without requiring subqueries.
+	 */
+	if (jointype == JOIN_INNER)
+	{
+		Assert(!fpinfo->joinclauses);
+		fpinfo->joinclauses = fpinfo->remote_conds;
+		fpinfo->remote_conds = NIL;
+	}
+
+	/* Mark that this join can be pushed down safely */
+	fpinfo->pushdown_safe = true;
+
+	/*
+	 * Set cached relation costs to some negative value, so that we can detect
+	 * when they are set to some sensible costs, during one (usually the
+	 * first) of the calls to estimate_path_cost_size().
+	 */
+	fpinfo->rel_startup_cost = -1;
+	fpinfo->rel_total_cost = -1;
+
+	/*
+	 * Set the string describing this join relation to be used in EXPLAIN
+	 * output of corresponding ForeignScan.
+	 */
+	fpinfo->relation_name = makeStringInfo();
+	appendStringInfo(fpinfo->relation_name, "(%s) %s JOIN (%s)",
+					 fpinfo_o->relation_name->data,
+					 odbc_get_jointype_name(fpinfo->jointype),
+					 fpinfo_i->relation_name->data);
+
+	/*
+	 * Set the relation index.  This is defined as the position of this
+	 * joinrel in the join_rel_list list plus the length of the rtable list.
+	 * Note that since this joinrel is at the end of the join_rel_list list
+	 * when we are called, we can get the position by list_length.
+	 */
+	Assert(fpinfo->relation_index == 0);	/* shouldn't be set yet */
+	fpinfo->relation_index =
+		list_length(root->parse->rtable) + list_length(root->join_rel_list);
+
+	return true;
+}
+
+/*
+ * odbcGetForeignJoinPaths
+ *		Add possible ForeignPath to joinrel, if join is safe to push down.
+ */
+static void
+odbcGetForeignJoinPaths(PlannerInfo *root,
+						RelOptInfo *joinrel,
+						RelOptInfo *outerrel,
+						RelOptInfo *innerrel,
+						JoinType jointype,
+						JoinPathExtraData *extra)
+{
+	PgFdwRelationInfo *fpinfo;
+	ForeignPath *joinpath;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+	/*
+	 * Skip if this join combination has been considered already.
+	 */
+	if (joinrel->fdw_private)
+		return;
+
+	/*
+	 * Create unfinished PgFdwRelationInfo entry which is used to indicate
+	 * that the join relation is already considered, so that we won't waste
+	 * time in judging safety of join pushdown and adding the same paths again
+	 * if found safe. Once we know that this join can be pushed down, we fill
+	 * the entry.
+	 */
+	fpinfo = (PgFdwRelationInfo *) palloc0(sizeof(PgFdwRelationInfo));
+	fpinfo->pushdown_safe = false;
+	joinrel->fdw_private = fpinfo;
+	/* attrs_used is only for base relations. */
+	fpinfo->attrs_used = NULL;
+
+	/*
+	 * A pushed-down join would need RecheckForeignScan and an alternative
+	 * local join plan for EvalPlanQual rechecks, which we don't provide.
+	 * Keep joins that rows may be rechecked for local.
+	 */
+	if (root->parse->commandType == CMD_DELETE ||
+		root->parse->commandType == CMD_UPDATE ||
+		root->rowMarks)
+		return;
+
+	if (!foreign_join_ok(root, joinrel, jointype, outerrel, innerrel, extra))
+		return;
+
+	/*
+	 * Compute the selectivity and cost of the local_conds, so we don't have
+	 * to do it over again for each path. The best we can do for these
+	 * conditions is to estimate selectivity on the basis of local statistics.
+	 * The local conditions are applied after the join has been computed on
+	 * the remote side like quals in WHERE clause, so pass jointype as
+	 * JOIN_INNER.
+	 */
+	fpinfo->local_conds_sel = clauselist_selectivity(root,
+													 fpinfo->local_conds,
+													 0,
+													 JOIN_INNER,
+													 NULL);
+	cost_qual_eval(&fpinfo->local_conds_cost, fpinfo->local_conds, root);
+
+	/*
+	 * The join cost model in estimate_path_cost_size() applies the join
+	 * clauses to the cross product of the joining relations, so it needs
+	 * their selectivity.
+	 */
+	fpinfo->joinclause_sel = clauselist_selectivity(root, fpinfo->joinclauses,
+													0, fpinfo->jointype,
+													extra->sjinfo);
+
+	/* Estimate costs for bare join relation */
+	estimate_path_cost_size(root, joinrel, NIL, NIL, &rows,
+							&width, &startup_cost, &total_cost);
+	/* Now update this information in the joinrel */
+	joinrel->rows = rows;
+	joinrel->reltarget->width = width;
+	fpinfo->rows = rows;
+	fpinfo->width = width;
+	fpinfo->startup_cost = startup_cost;
+	fpinfo->total_cost = total_cost;
+
+	/*
+	 * Create a new join path and add it to the joinrel which represents a
+	 * join between foreign tables.
+	 */
+	joinpath = create_foreignscan_path(root,
+									   joinrel,
+									   NULL,	/* default pathtarget */
+									   rows,
+									   startup_cost,
+									   total_cost,
+									   NIL, /* no pathkeys */
+									   NULL,	/* no required_outer */
+									   NULL,	/* no epq_path */
+									   NIL);	/* no fdw_private */
+
+	/* Add generated path into joinrel by add_path(). */
+	add_path(joinrel, (Path *) joinpath);
+
+	/* Consider pathkeys for the join relation */
+	add_paths_with_pathkeys_for_rel(root, joinrel, NULL);
+}
+
 static void
 merge_fdw_options(PgFdwRelationInfo *fpinfo,
 				  const PgFdwRelationInfo *fpinfo_o,
@@ -4813,6 +8509,10 @@ merge_fdw_options(PgFdwRelationInfo *fpinfo,
 	fpinfo->shippable_extensions = fpinfo_o->shippable_extensions;
 	fpinfo->use_remote_estimate = fpinfo_o->use_remote_estimate;
 	fpinfo->fetch_size = fpinfo_o->fetch_size;
+	fpinfo->limit_syntax = fpinfo_o->limit_syntax;
+	fpinfo->grouping_sets = fpinfo_o->grouping_sets;
+	fpinfo->estimator = fpinfo_o->estimator;
+	fpinfo->dialect = fpinfo_o->dialect;
 
 	/* Merge the table level options from either side of the join. */
 	if (fpinfo_i)
@@ -4828,6 +8528,10 @@ merge_fdw_options(PgFdwRelationInfo *fpinfo,
 		fpinfo->use_remote_estimate = fpinfo_o->use_remote_estimate ||
 			fpinfo_i->use_remote_estimate;
 
+		/* The estimator is only set on relations using remote estimates */
+		if (!fpinfo_o->use_remote_estimate)
+			fpinfo->estimator = fpinfo_i->estimator;
+
 		/*
 		 * Set fetch size to maximum of the joining sides, since we are
 		 * expecting the rows returned by the join to be proportional to the
@@ -20,6 +20,9 @@
 #include "nodes/relation.h"
 #include "utils/relcache.h"
 
+#include <sql.h>
+#include <sqlext.h>
+
 #if PG_VERSION_NUM < 100000 && PG_VERSION_NUM >= 90600
 #define IS_SIMPLE_REL(rel) \
         ((rel)->reloptkind == RELOPT_BASEREL || \
@@ -32,6 +35,123 @@
 /* Is the given relation an upper relation? */
 #define IS_UPPER_REL(rel) ((rel)->reloptkind == RELOPT_UPPER_REL)
 #endif
+
+/*
+ * How a LIMIT pushed down to the remote server is expressed, set by the
+ * limit_syntax server option.  When the dialect is unknown the query is sent
+ * without a LIMIT and the driver is asked to stop after the rows needed.
+ */
+typedef enum OdbcLimitSyntax
+{
+	ODBC_LIMIT_MAX_ROWS,		/* SQL_ATTR_MAX_ROWS statement attribute */
+	ODBC_LIMIT_LIMIT,			/* LIMIT n OFFSET m */
+	ODBC_LIMIT_TOP,				/* SELECT TOP n */
+	ODBC_LIMIT_FETCH_FIRST		/* OFFSET m ROWS FETCH FIRST n ROWS ONLY */
+} OdbcLimitSyntax;
+
+/*
+ * How ANALYZE has the remote server sample a table, set by the
+ * analyze_sampling option.  Whatever the server returns is reduced to the
+ * sample size locally.
+ */
+typedef enum OdbcSampleMethod
+{
+	ODBC_SAMPLE_AUTO,			/* the one of the server's dialect */
+	ODBC_SAMPLE_OFF,			/* all rows are fetched */
+	ODBC_SAMPLE_TABLESAMPLE,	/* TABLESAMPLE BERNOULLI (p) */
+	ODBC_SAMPLE_SAMPLE,			/* SAMPLE (p) */
+	ODBC_SAMPLE_RANDOM			/* WHERE RAND() < f */
+} OdbcSampleMethod;
+
+/*
+ * How use_remote_estimate asks the remote server for estimates, set by the
+ * remote_estimator server option.
+ */
+typedef enum OdbcEstimator
+{
+	ODBC_ESTIMATOR_AUTO,		/* the one of the server's dialect */
+	ODBC_ESTIMATOR_POSTGRESQL,	/* EXPLAIN: rows, width and costs */
+	ODBC_ESTIMATOR_MYSQL,		/* EXPLAIN: rows */
+	ODBC_ESTIMATOR_SQLSERVER,	/* SET SHOWPLAN_ALL: rows and width */
+	ODBC_ESTIMATOR_STATISTICS	/* SQLStatistics: table cardinality */
+} OdbcEstimator;
+
+/*
+ * The SQL dialects the deparser can write, set by the dialect server option
+ * or detected from the DBMS name the driver reports.
+ */
+typedef enum OdbcDialectKind
+{
+	ODBC_DIALECT_AUTO,			/* detected from the server */
+	ODBC_DIALECT_POSTGRESQL,
+	ODBC_DIALECT_MYSQL,			/* MySQL and MariaDB */
+	ODBC_DIALECT_SQLSERVER,
+	ODBC_DIALECT_ORACLE,
+	ODBC_DIALECT_DB2,
+	ODBC_DIALECT_HIVE,			/* Hive and Spark SQL */
+	ODBC_DIALECT_GENERIC		/* ODBC escapes and plain SQL-92 */
+} OdbcDialectKind;
+
+/* How backslashes in string literals are read by the remote server */
+typedef enum OdbcStringEscape
+{
+	ODBC_ESCAPE_STANDARD,		/* literally */
+	ODBC_ESCAPE_BACKSLASH,		/* as escapes, so they are doubled */
+	ODBC_ESCAPE_POSTGRESQL		/* E'...' is used if there are any */
+} OdbcStringEscape;
+
+/* Which locking clauses the remote server takes */
+typedef enum OdbcLockSyntax
+{
+	ODBC_LOCK_NONE,				/* none; rows are not locked */
+	ODBC_LOCK_FOR_UPDATE,		/* FOR UPDATE, on all tables of the query */
+	ODBC_LOCK_POSTGRESQL		/* FOR UPDATE/SHARE [OF alias] */
+} OdbcLockSyntax;
+
+/*
+ * What the deparser needs to know about the SQL of a remote server.
+ * Parameters are always sent as ODBC "?" markers, so they need no entry.
+ */
+typedef struct OdbcDialect
+{
+	OdbcDialectKind kind;
+	const char *name;			/* value of the dialect option */
+	char		quote_open;		/* identifier quotes, '\0' for none */
+	char		quote_close;
+	char		name_separator;	/* between schema and table name */
+	OdbcStringEscape string_escape;
+	bool		postgres_syntax;	/* ::casts, arrays, ROW(), ON CONFLICT,
+									 * OPERATOR(), aggregate ORDER BY and
+									 * FILTER */
+	bool		has_boolean;	/* boolean values besides predicates */
+	bool		integer_division;	/* int / int truncates, as locally */
+	bool		datetime_escapes;	/* {d '...'}, {t '...'}, {ts '...'} */
+	bool		distinct_from;	/* IS DISTINCT FROM */
+	OdbcLockSyntax lock_syntax;
+	OdbcLimitSyntax limit_syntax;	/* used if the dialect is set */
+	OdbcSampleMethod sample_method; /* used for analyze_sampling auto */
+	OdbcEstimator estimator;	/* used for remote_estimator auto */
+
+	/* Functions the driver supports, as reported by SQLGetInfo() */
+	SQLUINTEGER string_functions;	/* SQL_FN_STR_* */
+	SQLUINTEGER numeric_functions;	/* SQL_FN_NUM_* */
+	SQLUINTEGER timedate_functions; /* SQL_FN_TD_* */
+	SQLUINTEGER convert_functions;	/* SQL_FN_CVT_* */
+	SQLUINTEGER aggregate_functions;	/* SQL_AF_* */
+} OdbcDialect;
+
+/*
+ * An estimate of a remote query.  Estimators that do not know the width or
+ * the costs leave them at 0 and -1 respectively.
+ */
+typedef struct OdbcRemoteEstimate
+{
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+} OdbcRemoteEstimate;
+
 /*
  * FDW-specific planner information kept in RelOptInfo.fdw_private for a
  * postgres_fdw foreign table.  For a baserel, this struct is created by
@@ -47,6 +167,9 @@ typedef struct PgFdwRelationInfo
 	 */
 	bool		pushdown_safe;
 
+	/* True means that the query_pathkeys is safe to push down */
+	bool		qp_is_pushdown_safe;
+
 	/*
 	 * Restriction clauses, divided into safe and unsafe to pushdown subsets.
 	 * All entries in these lists should have RestrictInfo wrappers; that
@@ -86,9 +209,16 @@ typedef struct PgFdwRelationInfo
 	/* Cached catalog information. */
 	ForeignTable *table;
 	ForeignServer *server;
-	UserMapping *user;			/* only set in use_remote_estimate mode */
+	UserMapping *user;			/* user mapping to connect with */
 
 	int			fetch_size;		/* fetch size for this remote table */
+	OdbcLimitSyntax limit_syntax;	/* how the server takes a LIMIT */
+	bool		grouping_sets;	/* server supports GROUPING SETS etc. */
+	OdbcEstimator estimator;	/* how use_remote_estimate asks the server */
+	OdbcDialect dialect;		/* SQL dialect of the server */
+	char	   *conn_str;		/* ODBC connection string; rels joined
+								 * remotely must share it */
+	Bitmapset  *indexed_attrs;	/* columns with the "indexed" option */
 
 	/*
 	 * Name of the relation while EXPLAINing ForeignScan. It is used for join
@@ -104,6 +234,9 @@ typedef struct PgFdwRelationInfo
 	/* joinclauses contains only JOIN/ON conditions for an outer join */
 	List	   *joinclauses;	/* List of RestrictInfo */
 
+	/* Upper relation information */
+	UpperRelationKind stage;
+
 	/* Grouping information */
 	List	   *grouped_tlist;
 
@@ -133,7 +266,7 @@ extern bool odbc_is_foreign_expr(PlannerInfo *root,
 				RelOptInfo *baserel,
 				Expr *expr);
 extern void odbc_deparseInsertSql(StringInfo buf, PlannerInfo *root,
-				 Index rtindex, Relation rel,
+				 Index rtindex, Relation rel, const OdbcDialect *dialect,
 				 List *targetAttrs, bool doNothing, List *returningList,
 				 List **retrieved_attrs);
 extern void odbc_deparseDirectUpdateSql(StringInfo buf, PlannerInfo *root,
@@ -145,7 +278,7 @@ extern void odbc_deparseDirectUpdateSql(StringInfo buf, PlannerInfo *root,
 					   List *returningList,
 					   List **retrieved_attrs);
 extern void odbc_deparseDeleteSql(StringInfo buf, PlannerInfo *root,
-				 Index rtindex, Relation rel,
+				 Index rtindex, Relation rel, const OdbcDialect *dialect,
 				 List *returningList,
 				 List **retrieved_attrs);
 extern void odbc_deparseDirectDeleteSql(StringInfo buf, PlannerInfo *root,
@@ -154,14 +287,26 @@ extern void odbc_deparseDirectDeleteSql(StringInfo buf, PlannerInfo *root,
 					   List **params_list,
 					   List *returningList,
 					   List **retrieved_attrs);
-extern void odbc_deparseStringLiteral(StringInfo buf, const char *val);
+extern void odbc_deparseAnalyzeSizeSql(StringInfo buf, Relation rel,
+						   const OdbcDialect *dialect);
+extern void odbc_deparseAnalyzeSql(StringInfo buf, Relation rel,
+					   const OdbcDialect *dialect,
+					   OdbcSampleMethod method, double sample_frac,
+					   List **retrieved_attrs);
+extern void odbc_deparseStringLiteral(StringInfo buf, const char *val,
+						  const OdbcDialect *dialect);
 extern Expr *odbc_find_em_expr_for_rel(EquivalenceClass *ec, RelOptInfo *rel);
+extern Expr *odbc_find_em_expr_for_input_target(PlannerInfo *root,
+								   EquivalenceClass *ec,
+								   PathTarget *target);
 extern List *odbc_build_tlist_to_deparse(RelOptInfo *foreignrel);
 extern void odbc_deparseSelectStmtForRel(StringInfo buf, PlannerInfo *root,
 						RelOptInfo *foreignrel, List *tlist,
-						List *remote_conds, List *pathkeys, bool is_subquery,
-						List **retrieved_attrs, List **params_list);
+						List *remote_conds, List *pathkeys, bool has_limit,
+						bool is_subquery, List **retrieved_attrs,
+						List **params_list);
 extern const char *odbc_get_jointype_name(JoinType jointype);
+extern bool odbc_get_limit_values(Query *query, int64 *count, int64 *offset);
 enum ShipObj            
 {               
 	AggObj,
@@ -170,13 +315,42 @@ enum ShipObj
 	OperatorObj,
 	UNKOWNOBJ               
 };
-#define SHIPAGGMIN 2100   
-#define SHIPAGGMAX 2803 
 /* in odbc_shippable.c */
 extern bool odbc_is_builtin(Oid objectId);
 extern bool odbc_is_shippable(Oid objectId, Oid classId, PgFdwRelationInfo *fpinfo, enum ShipObj ObjType);
+extern const char *odbc_remote_template(Oid objectId, Oid classId, List *args,
+					 PgFdwRelationInfo *fpinfo);
+
+/* in odbc_connection.c */
+extern SQLHDBC odbc_GetConnection(const char *conn_str, Oid serverid, Oid umid);
+extern void odbc_ReleaseConnection(SQLHDBC conn);
+extern SQLHSTMT odbc_AllocStatement(SQLHDBC conn);
+extern void odbc_FreeStatement(SQLHDBC conn, SQLHSTMT stmt);
+
+/* in odbc_stats.c */
+extern bool odbc_get_cached_stats(Oid relid, int ttl, double *rows,
+					  int32 *width, bool *stale);
+extern void odbc_request_stats_refresh(Oid relid, int ttl);
+
+/* in odbc_estimate.c */
+extern OdbcEstimator odbc_estimator(const char *name);
+extern bool odbc_get_remote_estimate(SQLHDBC dbc, Oid serverid,
+						 OdbcEstimator estimator, const char *sql,
+						 OdbcRemoteEstimate *est);
+extern double odbc_get_remote_cardinality(SQLHDBC dbc, Oid serverid,
+							const char *schema, const char *table);
+
+/* in odbc_dialect.c */
+extern const OdbcDialect *odbc_dialect(const char *name);
+extern bool odbc_cached_dialect(Oid serverid, OdbcDialect *dialect);
+extern void odbc_detect_dialect(SQLHDBC dbc, Oid serverid,
+					const OdbcDialect *profile, OdbcDialect *dialect);
+extern const char *odbc_quote_identifier(const char *ident,
+					  const OdbcDialect *dialect);
 
 /* in odbc_fdw.c */
+extern double odbc_remote_row_count(Relation relation);
+extern void check_return(SQLRETURN ret, char *msg, SQLHANDLE handle, SQLSMALLINT type);
 extern int odbc_set_transmission_modes(void);
 extern void odbc_reset_transmission_modes(int nestlevel);
 #endif							/* ODBC_FDW_H */
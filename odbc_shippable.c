@@ -6,8 +6,11 @@
  * We need to determine whether particular functions, operators, and indeed
  * data types are shippable to a remote server for execution --- that is,
  * do they exist and have the same behavior remotely as they do locally?
- * Built-in objects are generally considered shippable.  Other objects can
- * be shipped if they are white-listed by the user.
+ * Built-in objects are generally considered shippable to PostgreSQL.  Other
+ * servers only take the built-in functions, operators and aggregates that
+ * have an ODBC counterpart the driver reports it supports; those are written
+ * with the template of the catalog below.  Other objects can be shipped if
+ * they are white-listed by the user.
  *
  * Note: there are additional filter rules that prevent shipping mutable
  * functions or functions using nonportable collations.  Those considerations
@@ -25,8 +28,14 @@
 
 #include "odbc_fdw.h"
 
+#include "access/htup_details.h"
 #include "access/transam.h"
 #include "catalog/dependency.h"
+#include "catalog/pg_namespace.h"
+#include "catalog/pg_operator.h"
+#include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
+#include "utils/builtins.h"
 #include "utils/hsearch.h"
 #include "utils/inval.h"
 #include "utils/syscache.h"
@@ -52,14 +61,215 @@ typedef struct
 {
 	ShippableCacheKey key;		/* hash key - must be first */
 	bool		shippable;
+	int			mapping;		/* first usable entry of remote_functions,
+								 * or -1 */
 } ShippableCacheEntry;
 
+/*
+ * What a built-in function, operator or aggregate is on servers other than
+ * PostgreSQL.  An entry applies to the object of pg_catalog of its name and
+ * number of arguments; if argtype is set, the first argument of a function,
+ * or every operand of an operator, must be of that type, and if field is set
+ * the first argument must be a constant of that value.  The entry is only
+ * used if the driver sets all bits of mask in what SQLGetInfo() reports for
+ * info_type.  In the remote SQL, %n stands for the nth argument; aggregates
+ * keep their name.  Entries for the same object are kept together, the
+ * preferred one first.
+ */
+typedef struct RemoteFunction
+{
+	Oid			classid;		/* ProcedureRelationId or OperatorRelationId */
+	const char *name;
+	int			nargs;
+	Oid			argtype;
+	const char *field;
+	SQLUSMALLINT info_type;
+	SQLUINTEGER mask;
+	const char *remote;
+} RemoteFunction;
+
+#define FUNC	ProcedureRelationId
+#define OPER	OperatorRelationId
+
+static const RemoteFunction remote_functions[] =
+{
+	/* String functions */
+	{FUNC, "upper", 1, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_UCASE, "{fn UCASE(%1)}"},
+	{FUNC, "lower", 1, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_LCASE, "{fn LCASE(%1)}"},
+	{FUNC, "ltrim", 1, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_LTRIM, "{fn LTRIM(%1)}"},
+	{FUNC, "rtrim", 1, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_RTRIM, "{fn RTRIM(%1)}"},
+	{FUNC, "btrim", 1, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_LTRIM | SQL_FN_STR_RTRIM,
+	"{fn LTRIM({fn RTRIM(%1)})}"},
+	/* LENGTH does not count trailing blanks, which bpchar ignores too */
+	{FUNC, "length", 1, BPCHAROID, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_LENGTH, "{fn LENGTH(%1)}"},
+	{FUNC, "length", 1, TEXTOID, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_CHAR_LENGTH, "{fn CHAR_LENGTH(%1)}"},
+	{FUNC, "char_length", 1, BPCHAROID, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_LENGTH, "{fn LENGTH(%1)}"},
+	{FUNC, "char_length", 1, TEXTOID, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_CHAR_LENGTH, "{fn CHAR_LENGTH(%1)}"},
+	{FUNC, "character_length", 1, BPCHAROID, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_LENGTH, "{fn LENGTH(%1)}"},
+	{FUNC, "character_length", 1, TEXTOID, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_CHAR_LENGTH, "{fn CHAR_LENGTH(%1)}"},
+	{FUNC, "substr", 3, TEXTOID, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_SUBSTRING, "{fn SUBSTRING(%1, %2, %3)}"},
+	{FUNC, "substring", 3, TEXTOID, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_SUBSTRING, "{fn SUBSTRING(%1, %2, %3)}"},
+	{FUNC, "left", 2, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_LEFT, "{fn LEFT(%1, %2)}"},
+	{FUNC, "right", 2, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_RIGHT, "{fn RIGHT(%1, %2)}"},
+	{FUNC, "strpos", 2, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_LOCATE, "{fn LOCATE(%2, %1)}"},
+	{FUNC, "position", 2, TEXTOID, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_LOCATE, "{fn LOCATE(%2, %1)}"},
+	{FUNC, "repeat", 2, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_REPEAT, "{fn REPEAT(%1, %2)}"},
+	{FUNC, "replace", 3, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_REPLACE, "{fn REPLACE(%1, %2, %3)}"},
+	{FUNC, "ascii", 1, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_ASCII, "{fn ASCII(%1)}"},
+	{FUNC, "chr", 1, InvalidOid, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_CHAR, "{fn CHAR(%1)}"},
+	{OPER, "||", 2, TEXTOID, NULL,
+	SQL_STRING_FUNCTIONS, SQL_FN_STR_CONCAT, "{fn CONCAT(%1, %2)}"},
+
+	/* Numeric functions */
+	{FUNC, "abs", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_ABS, "{fn ABS(%1)}"},
+	{FUNC, "ceil", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_CEILING, "{fn CEILING(%1)}"},
+	{FUNC, "ceiling", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_CEILING, "{fn CEILING(%1)}"},
+	{FUNC, "floor", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_FLOOR, "{fn FLOOR(%1)}"},
+	/* round(float8) rounds halves to even, unlike ROUND */
+	{FUNC, "round", 1, NUMERICOID, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_ROUND, "{fn ROUND(%1, 0)}"},
+	{FUNC, "round", 2, NUMERICOID, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_ROUND, "{fn ROUND(%1, %2)}"},
+	{FUNC, "trunc", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_TRUNCATE, "{fn TRUNCATE(%1, 0)}"},
+	{FUNC, "trunc", 2, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_TRUNCATE, "{fn TRUNCATE(%1, %2)}"},
+	{FUNC, "mod", 2, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_MOD, "{fn MOD(%1, %2)}"},
+	{FUNC, "sign", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_SIGN, "{fn SIGN(%1)}"},
+	{FUNC, "sqrt", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_SQRT, "{fn SQRT(%1)}"},
+	{FUNC, "exp", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_EXP, "{fn EXP(%1)}"},
+	/* LOG is the natural logarithm */
+	{FUNC, "ln", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_LOG, "{fn LOG(%1)}"},
+	{FUNC, "log", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_LOG10, "{fn LOG10(%1)}"},
+	{FUNC, "power", 2, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_POWER, "{fn POWER(%1, %2)}"},
+	{FUNC, "pow", 2, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_POWER, "{fn POWER(%1, %2)}"},
+	{FUNC, "degrees", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_DEGREES, "{fn DEGREES(%1)}"},
+	{FUNC, "radians", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_RADIANS, "{fn RADIANS(%1)}"},
+	{FUNC, "pi", 0, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_PI, "{fn PI()}"},
+	{FUNC, "sin", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_SIN, "{fn SIN(%1)}"},
+	{FUNC, "cos", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_COS, "{fn COS(%1)}"},
+	{FUNC, "tan", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_TAN, "{fn TAN(%1)}"},
+	{FUNC, "cot", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_COT, "{fn COT(%1)}"},
+	{FUNC, "asin", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_ASIN, "{fn ASIN(%1)}"},
+	{FUNC, "acos", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_ACOS, "{fn ACOS(%1)}"},
+	{FUNC, "atan", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_ATAN, "{fn ATAN(%1)}"},
+	{OPER, "%", 2, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_MOD, "{fn MOD(%1, %2)}"},
+	{OPER, "^", 2, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_POWER, "{fn POWER(%1, %2)}"},
+	{OPER, "|/", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_SQRT, "{fn SQRT(%1)}"},
+	{OPER, "@", 1, InvalidOid, NULL,
+	SQL_NUMERIC_FUNCTIONS, SQL_FN_NUM_ABS, "{fn ABS(%1)}"},
+
+	/* Time and date functions: EXTRACT of the fields they stand for */
+	{FUNC, "date_part", 2, TEXTOID, "year",
+	SQL_TIMEDATE_FUNCTIONS, SQL_FN_TD_YEAR, "{fn YEAR(%2)}"},
+	{FUNC, "date_part", 2, TEXTOID, "quarter",
+	SQL_TIMEDATE_FUNCTIONS, SQL_FN_TD_QUARTER, "{fn QUARTER(%2)}"},
+	{FUNC, "date_part", 2, TEXTOID, "month",
+	SQL_TIMEDATE_FUNCTIONS, SQL_FN_TD_MONTH, "{fn MONTH(%2)}"},
+	{FUNC, "date_part", 2, TEXTOID, "day",
+	SQL_TIMEDATE_FUNCTIONS, SQL_FN_TD_DAYOFMONTH, "{fn DAYOFMONTH(%2)}"},
+	{FUNC, "date_part", 2, TEXTOID, "doy",
+	SQL_TIMEDATE_FUNCTIONS, SQL_FN_TD_DAYOFYEAR, "{fn DAYOFYEAR(%2)}"},
+	/* DAYOFWEEK counts from 1 for Sunday */
+	{FUNC, "date_part", 2, TEXTOID, "dow",
+	SQL_TIMEDATE_FUNCTIONS, SQL_FN_TD_DAYOFWEEK, "({fn DAYOFWEEK(%2)} - 1)"},
+	{FUNC, "date_part", 2, TEXTOID, "hour",
+	SQL_TIMEDATE_FUNCTIONS, SQL_FN_TD_HOUR, "{fn HOUR(%2)}"},
+	{FUNC, "date_part", 2, TEXTOID, "minute",
+	SQL_TIMEDATE_FUNCTIONS, SQL_FN_TD_MINUTE, "{fn MINUTE(%2)}"},
+
+	/* Conversion functions: only casts that lose nothing */
+	{FUNC, "int4", 1, INT2OID, NULL,
+	SQL_CONVERT_FUNCTIONS, SQL_FN_CVT_CONVERT, "{fn CONVERT(%1, SQL_INTEGER)}"},
+	{FUNC, "int8", 1, INT2OID, NULL,
+	SQL_CONVERT_FUNCTIONS, SQL_FN_CVT_CONVERT, "{fn CONVERT(%1, SQL_BIGINT)}"},
+	{FUNC, "int8", 1, INT4OID, NULL,
+	SQL_CONVERT_FUNCTIONS, SQL_FN_CVT_CONVERT, "{fn CONVERT(%1, SQL_BIGINT)}"},
+	{FUNC, "float8", 1, INT2OID, NULL,
+	SQL_CONVERT_FUNCTIONS, SQL_FN_CVT_CONVERT, "{fn CONVERT(%1, SQL_DOUBLE)}"},
+	{FUNC, "float8", 1, INT4OID, NULL,
+	SQL_CONVERT_FUNCTIONS, SQL_FN_CVT_CONVERT, "{fn CONVERT(%1, SQL_DOUBLE)}"},
+	{FUNC, "float8", 1, FLOAT4OID, NULL,
+	SQL_CONVERT_FUNCTIONS, SQL_FN_CVT_CONVERT, "{fn CONVERT(%1, SQL_DOUBLE)}"},
+	{FUNC, "date", 1, TIMESTAMPOID, NULL,
+	SQL_CONVERT_FUNCTIONS, SQL_FN_CVT_CONVERT, "{fn CONVERT(%1, SQL_DATE)}"},
+	{FUNC, "timestamp", 1, DATEOID, NULL,
+	SQL_CONVERT_FUNCTIONS, SQL_FN_CVT_CONVERT, "{fn CONVERT(%1, SQL_TIMESTAMP)}"},
+
+	/* Aggregates; the average of integers is not an integer here */
+	{FUNC, "count", 0, InvalidOid, NULL,
+	SQL_AGGREGATE_FUNCTIONS, SQL_AF_COUNT, NULL},
+	{FUNC, "count", 1, InvalidOid, NULL,
+	SQL_AGGREGATE_FUNCTIONS, SQL_AF_COUNT, NULL},
+	{FUNC, "sum", 1, InvalidOid, NULL,
+	SQL_AGGREGATE_FUNCTIONS, SQL_AF_SUM, NULL},
+	{FUNC, "avg", 1, FLOAT4OID, NULL,
+	SQL_AGGREGATE_FUNCTIONS, SQL_AF_AVG, NULL},
+	{FUNC, "avg", 1, FLOAT8OID, NULL,
+	SQL_AGGREGATE_FUNCTIONS, SQL_AF_AVG, NULL},
+	{FUNC, "avg", 1, NUMERICOID, NULL,
+	SQL_AGGREGATE_FUNCTIONS, SQL_AF_AVG, NULL},
+	{FUNC, "min", 1, InvalidOid, NULL,
+	SQL_AGGREGATE_FUNCTIONS, SQL_AF_MIN, NULL},
+	{FUNC, "max", 1, InvalidOid, NULL,
+	SQL_AGGREGATE_FUNCTIONS, SQL_AF_MAX, NULL},
+
+	{InvalidOid, NULL}
+};
+
 
 /*
  * Flush cache entries when pg_foreign_server is updated.
  *
  * We do this because of the possibility of ALTER SERVER being used to change
- * a server's extensions option.  We do not currently bother to check whether
+ * a server's extensions option, or to point it to another kind of server,
+ * which has other functions.  We do not currently bother to check whether
  * objects' extension membership changes once a shippability decision has been
  * made for them, however.
  */
@@ -158,67 +368,136 @@ odbc_is_builtin(Oid objectId)
 }
 
 /*
- * is_shippable
- *	   Is this object (function/operator/type) shippable to foreign server?
+ * Is the function of info_type and mask one the server has?
  */
-bool
-odbc_is_shippable(Oid objectId, Oid classId, PgFdwRelationInfo *fpinfo, enum ShipObj objType)
+static bool
+remote_function_supported(const RemoteFunction *rf, const OdbcDialect *dialect)
 {
-	ShippableCacheKey key;
-	ShippableCacheEntry *entry;
+	SQLUINTEGER supported;
 
-	/* Built-in objects are presumed shippable. */
-	//if (is_builtin(objectId))
-	//	return true;
+	switch (rf->info_type)
+	{
+		case SQL_STRING_FUNCTIONS:
+			supported = dialect->string_functions;
+			break;
+		case SQL_NUMERIC_FUNCTIONS:
+			supported = dialect->numeric_functions;
+			break;
+		case SQL_TIMEDATE_FUNCTIONS:
+			supported = dialect->timedate_functions;
+			break;
+		case SQL_CONVERT_FUNCTIONS:
+			supported = dialect->convert_functions;
+			break;
+		case SQL_AGGREGATE_FUNCTIONS:
+			supported = dialect->aggregate_functions;
+			break;
+		default:
+			elog(ERROR, "unrecognized info type: %d", (int) rf->info_type);
+			supported = 0;		/* keep compiler quiet */
+	}
 
-	if (objType == AggObj) {
-		if (objectId >= SHIPAGGMIN && objectId <= SHIPAGGMAX) {
-			return true;
-		} 
-	} else if (objType == DataTypeObj) {
-		if (objectId == 16 || objectId == 17 || objectId == 18 ||  objectId == 20 ||
-			objectId == 21 || objectId == 23 || objectId == 25 || objectId == 700 ||
-			objectId == 701 || objectId == 1042 ||objectId == 1043 ||objectId == 1082 ||
-			objectId == 1083 || objectId == 1114 ||objectId == 1700 ||objectId == 2950)
-			return true;
-	} else if (objType == OperatorObj) {
-			return true;
-	} else if (objType == ProcedureObj) {
-                if ((objectId >= 1242 && objectId <= 1245) ||(objectId >= 31 && objectId <= 39) ||
-                        (objectId == 42 || objectId == 43) ||(objectId == 46 || objectId == 47)||
-                        (objectId >= 56 && objectId <= 67) ||(objectId >= 70 && objectId <= 84) ||
-                        (objectId >= 1252 && objectId <= 1258) ||(objectId >= 141 && objectId <= 183) ||
-                        (objectId >= 200 && objectId <= 224) ||(objectId >= 235 && objectId <= 238) ||
-                        (objectId >= 1242 && objectId <= 1245) ||(objectId >= 240 && objectId <= 319) ||
-                        (objectId >= 350 && objectId <= 382) ||(objectId >= 3129 && objectId <= 3135) ||
-                        (objectId >= 438 && objectId <= 483) ||(objectId >= 652 && objectId <= 659) ||
-                        (objectId >= 740 && objectId <= 743) ||(objectId >= 766 && objectId <= 848) ||
-                        (objectId >= 852 && objectId <= 857) ||(objectId == 3399 || objectId == 3344 || objectId == 3345 ) ||
-                        (objectId >= 862 && objectId <= 946) ||(objectId >= 3822 || objectId <= 3824) ||
-                        (objectId == 3811 || objectId == 3812) || (objectId >= 1044 && objectId <= 1078) ||objectId == 3328 ||
-                        (objectId >= 1084 && objectId <= 1092) ||(objectId >= 1102 && objectId <= 1145) ||objectId == 3136 ||
-                        (objectId >= 1150 && objectId <= 1158) ||(objectId == 1195 ||
-                        objectId == 1196) || objectId == 1219 || objectId == 3546 ||
-                        (objectId >= 1236 && objectId <= 1253) ||(objectId >= 1274 && objectId <= 1281) ||
-                        (objectId >= 837 && objectId <= 848) ||(objectId == 1296 || objectId <= 1298) ||
-                        (objectId >= 1312 && objectId <= 1316) ||(objectId >= 1350 && objectId <= 1359) ||
-                        (objectId >= 1377 && objectId <= 1380) ||(objectId >= 1564 && objectId <= 1572) ||
-                        (objectId >= 1579 && objectId <= 1596) ||(objectId >= 1631 && objectId <= 1661) ||
-                        (objectId >= 1666 && objectId <= 1672) ||(objectId >= 1691 && objectId <= 1693) ||
-                        (objectId >= 1701 && objectId <= 1703) ||(objectId >= 1718 && objectId <= 1728) ||
-                        (objectId >= 1742 && objectId <= 1746) ||(objectId >= 1764 && objectId <= 1783) ||objectId == 3283 ||
-                        (objectId >= 1850 && objectId <= 1862) ||(objectId >= 1910 && objectId <= 1915) ||
-                        (objectId >= 1948 && objectId <= 1954) || objectId == 3331 || (objectId >= 2005 && objectId <=2008) ||
-                        (objectId >= 2052 && objectId <= 2057) ||(objectId >= 1910 && objectId <= 1915) ||objectId == 3137 ||
-                        (objectId >= 2160 && objectId <= 2195) ||(objectId == 3322 || objectId ==3333) ||
-                        (objectId >= 2338 && objectId <= 2383) ||(objectId >= 2520 && objectId <= 2533))
-
-                        return true;
-			return true;
+	return (supported & rf->mask) == rf->mask;
+}
+
+/*
+ * Do the two entries of remote_functions apply to the same objects?
+ */
+static bool
+same_remote_object(const RemoteFunction *a, const RemoteFunction *b)
+{
+	return a->classid == b->classid &&
+		strcmp(a->name, b->name) == 0 &&
+		a->nargs == b->nargs &&
+		a->argtype == b->argtype;
+}
+
+/*
+ * lookup_remote_function
+ *		Find the first entry of remote_functions that applies to the given
+ *		built-in function or operator and that the server supports.
+ *
+ * Returns its index, or -1 if there is none.
+ */
+static int
+lookup_remote_function(Oid objectId, Oid classId, const OdbcDialect *dialect)
+{
+	HeapTuple	tuple;
+	const char *name;
+	int			nargs;
+	Oid			argtypes[2];
+	int			result = -1;
+	int			i;
+
+	if (classId == ProcedureRelationId)
+	{
+		Form_pg_proc form;
+
+		tuple = SearchSysCache1(PROCOID, ObjectIdGetDatum(objectId));
+		if (!HeapTupleIsValid(tuple))
+			elog(ERROR, "cache lookup failed for function %u", objectId);
+		form = (Form_pg_proc) GETSTRUCT(tuple);
+		if (form->pronamespace != PG_CATALOG_NAMESPACE)
+		{
+			ReleaseSysCache(tuple);
+			return -1;
+		}
+		name = NameStr(form->proname);
+		nargs = form->pronargs;
+		argtypes[0] = argtypes[1] = (nargs > 0) ? form->proargtypes.values[0]
+			: InvalidOid;
 	}
-	/* Otherwise, give up if user hasn't specified any shippable extensions. */
-	if (fpinfo->shippable_extensions == NIL)
-		return false;
+	else if (classId == OperatorRelationId)
+	{
+		Form_pg_operator form;
+
+		tuple = SearchSysCache1(OPEROID, ObjectIdGetDatum(objectId));
+		if (!HeapTupleIsValid(tuple))
+			elog(ERROR, "cache lookup failed for operator %u", objectId);
+		form = (Form_pg_operator) GETSTRUCT(tuple);
+		if (form->oprnamespace != PG_CATALOG_NAMESPACE)
+		{
+			ReleaseSysCache(tuple);
+			return -1;
+		}
+		name = NameStr(form->oprname);
+		nargs = (form->oprkind == 'b') ? 2 : 1;
+		argtypes[0] = OidIsValid(form->oprleft) ? form->oprleft : form->oprright;
+		argtypes[1] = OidIsValid(form->oprright) ? form->oprright : form->oprleft;
+	}
+	else
+		return -1;
+
+	for (i = 0; remote_functions[i].name != NULL; i++)
+	{
+		const RemoteFunction *rf = &remote_functions[i];
+
+		if (rf->classid == classId &&
+			strcmp(rf->name, name) == 0 &&
+			rf->nargs == nargs &&
+			(!OidIsValid(rf->argtype) ||
+			 (rf->argtype == argtypes[0] && rf->argtype == argtypes[1])) &&
+			remote_function_supported(rf, dialect))
+		{
+			result = i;
+			break;
+		}
+	}
+
+	ReleaseSysCache(tuple);
+
+	return result;
+}
+
+/*
+ * get_shippable_entry
+ *		Look up, or work out and cache, what the server makes of an object.
+ */
+static ShippableCacheEntry *
+get_shippable_entry(Oid objectId, Oid classId, PgFdwRelationInfo *fpinfo)
+{
+	ShippableCacheKey key;
+	ShippableCacheEntry *entry;
 
 	/* Initialize cache if first time through. */
 	if (!ShippableCacheHash)
@@ -239,7 +518,17 @@ odbc_is_shippable(Oid objectId, Oid classId, PgFdwRelationInfo *fpinfo, enum Shi
 	if (!entry)
 	{
 		/* Not found in cache, so perform shippability lookup. */
-		bool		shippable = lookup_shippable(objectId, classId, fpinfo);
+		bool		shippable = false;
+		int			mapping = -1;
+
+		if (fpinfo->dialect.kind != ODBC_DIALECT_POSTGRESQL &&
+			odbc_is_builtin(objectId))
+			mapping = lookup_remote_function(objectId, classId,
+											 &fpinfo->dialect);
+		if (mapping >= 0)
+			shippable = true;
+		else if (fpinfo->shippable_extensions != NIL)
+			shippable = lookup_shippable(objectId, classId, fpinfo);
 
 		/*
 		 * Don't create a new hash entry until *after* we have the shippable
@@ -253,7 +542,108 @@ odbc_is_shippable(Oid objectId, Oid classId, PgFdwRelationInfo *fpinfo, enum Shi
 						NULL);
 
 		entry->shippable = shippable;
+		entry->mapping = mapping;
+	}
+
+	return entry;
+}
+
+/*
+ * is_shippable
+ *	   Is this object (function/operator/type) shippable to foreign server?
+ *
+ * Built-in operators are left for the deparser to sort out for servers
+ * other than PostgreSQL, as many of them are written the same everywhere.
+ */
+bool
+odbc_is_shippable(Oid objectId, Oid classId, PgFdwRelationInfo *fpinfo, enum ShipObj objType)
+{
+	if (objType == DataTypeObj)
+	{
+		switch (objectId)
+		{
+			case BOOLOID:
+			case BYTEAOID:
+			case CHAROID:
+			case INT8OID:
+			case INT2OID:
+			case INT4OID:
+			case TEXTOID:
+			case FLOAT4OID:
+			case FLOAT8OID:
+			case BPCHAROID:
+			case VARCHAROID:
+			case DATEOID:
+			case TIMEOID:
+			case TIMESTAMPOID:
+			case NUMERICOID:
+			case UUIDOID:
+				return true;
+			default:
+				break;
+		}
+	}
+	else if (odbc_is_builtin(objectId))
+	{
+		/* Built-in objects are presumed shippable to PostgreSQL. */
+		if (fpinfo->dialect.kind == ODBC_DIALECT_POSTGRESQL ||
+			objType == OperatorObj)
+			return true;
+
+		return get_shippable_entry(objectId, classId, fpinfo)->shippable;
+	}
+
+	/* Otherwise, give up if user hasn't specified any shippable extensions. */
+	if (fpinfo->shippable_extensions == NIL)
+		return false;
+
+	return get_shippable_entry(objectId, classId, fpinfo)->shippable;
+}
+
+/*
+ * odbc_remote_template
+ *		The SQL standing for a call of a built-in function or operator with
+ *		the given arguments on a server other than PostgreSQL.
+ *
+ * In it, %n stands for the nth argument.  Returns NULL if there is none,
+ * in which case the call can only be sent as it is.
+ */
+const char *
+odbc_remote_template(Oid objectId, Oid classId, List *args,
+					 PgFdwRelationInfo *fpinfo)
+{
+	ShippableCacheEntry *entry;
+	const RemoteFunction *first;
+	const RemoteFunction *rf;
+
+	if (fpinfo->dialect.kind == ODBC_DIALECT_POSTGRESQL ||
+		!odbc_is_builtin(objectId))
+		return NULL;
+
+	entry = get_shippable_entry(objectId, classId, fpinfo);
+	if (entry->mapping < 0)
+		return NULL;
+
+	first = &remote_functions[entry->mapping];
+	for (rf = first; rf->name != NULL && same_remote_object(rf, first); rf++)
+	{
+		if (rf->remote == NULL ||
+			!remote_function_supported(rf, &fpinfo->dialect))
+			continue;
+
+		if (rf->field != NULL)
+		{
+			Const	   *arg = (Const *) linitial(args);
+
+			if (!IsA(arg, Const) || arg->constisnull ||
+				arg->consttype != TEXTOID ||
+				pg_strcasecmp(TextDatumGetCString(arg->constvalue),
+							  rf->field) != 0)
+				continue;
+		}
+
+		return rf->remote;
 	}
 
-	return entry->shippable;
+	return NULL;
 }
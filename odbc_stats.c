@@ -0,0 +1,560 @@
+/*-------------------------------------------------------------------------
+ *
+ * odbc_stats.c
+ *		  Cached row counts of foreign tables
+ *
+ * Counting the rows of a remote table can take far too long to be done
+ * while planning.  Instead the count is kept in the extension's
+ * odbc_fdw_stats table, together with the average row width and the time it
+ * was taken, and odbcGetForeignRelSize plans with what is stored there.
+ *
+ * The count is taken by odbc_fdw_refresh_stats().  A table with the
+ * stats_ttl option is also refreshed once its count is older than that many
+ * seconds: the planner starts a background worker for it and carries on
+ * with the old count, so that no query waits for the remote server.
+ * Only one refresh of a table runs at a time in the whole cluster: it holds
+ * a lock on the table in a lock space of its own, and a worker that can't
+ * get the lock leaves the table alone.
+ *
+ * Each backend keeps the counts it has read in memory.  Storing a count
+ * invalidates the relcache entry of its table, which makes every backend
+ * read it again.
+ *
+ * Portions Copyright (c) 2012-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2017-2018, www.cstech.ltd
+ *
+ * IDENTIFICATION
+ *		  contrib/odbc_fdw/odbc_stats.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "odbc_fdw.h"
+
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "miscadmin.h"
+#include "optimizer/plancat.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "storage/ipc.h"
+#include "storage/lock.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/snapmgr.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+
+/* Name of the table holding the counts, in the schema of the extension */
+#define ODBC_STATS_TABLE "odbc_fdw_stats"
+
+/*
+ * First key of the lock held while refreshing the count of a table, whose
+ * OID is the second key.  The tag type is LOCKTAG_USERLOCK, which core
+ * reserves for add-on modules and no SQL function takes, so that no
+ * pg_advisory_lock() of a user can block or collide with a refresh.  It
+ * shows in pg_locks as a userlock.
+ */
+#define ODBC_STATS_LOCK_KEY 0x4F444243	/* "ODBC" */
+
+#define SET_LOCKTAG_STATS_REFRESH(tag, relid) \
+	((tag).locktag_field1 = MyDatabaseId, \
+	 (tag).locktag_field2 = ODBC_STATS_LOCK_KEY, \
+	 (tag).locktag_field3 = (relid), \
+	 (tag).locktag_field4 = 0, \
+	 (tag).locktag_type = LOCKTAG_USERLOCK, \
+	 (tag).locktag_lockmethodid = USER_LOCKMETHOD)
+
+/*
+ * What a refresh worker needs besides the table OID, which is passed as its
+ * main argument.  It is kept in bgw_extra.
+ */
+typedef struct OdbcStatsWorkerArgs
+{
+	Oid			dbid;			/* database to connect to */
+	Oid			userid;			/* user whose user mapping to count with */
+	int			ttl;			/* stats_ttl of the table */
+} OdbcStatsWorkerArgs;
+
+/*
+ * When this backend last started a refresh worker for a table.  Planning
+ * the same query over and over should not start a worker every time.
+ */
+typedef struct StatsLaunchEntry
+{
+	Oid			relid;			/* hash key - must be first */
+	TimestampTz launched;
+} StatsLaunchEntry;
+
+static HTAB *StatsLaunchHash = NULL;
+
+/*
+ * Backend-local copy of the stats table rows read so far, including the
+ * lack of a row.  Entries are dropped by relcache invalidations of their
+ * table; the whole cache is dropped when the stats table itself changes,
+ * as when the extension is updated or dropped.
+ */
+typedef struct StatsCacheEntry
+{
+	Oid			relid;			/* hash key - must be first */
+	bool		found;			/* does the table have a cached count? */
+	double		rows;
+	int32		width;
+	TimestampTz refreshed_at;
+} StatsCacheEntry;
+
+static HTAB *StatsCacheHash = NULL;
+
+/* OID of the stats table when StatsCacheHash was filled, if it exists */
+static Oid	StatsTableOid = InvalidOid;
+
+/* prototypes of private functions */
+static Oid	get_stats_table(char **nspname);
+static void stats_inval_callback(Datum arg, Oid relid);
+static bool lookup_stats(Oid relid, Oid *statsid, double *rows,
+			 int32 *width, TimestampTz *refreshed_at);
+static double refresh_stats(Oid relid);
+static void store_stats(Oid relid, double rows, int32 width);
+
+PG_FUNCTION_INFO_V1(odbc_fdw_refresh_stats);
+
+PGDLLEXPORT void odbc_fdw_stats_worker(Datum main_arg);
+
+/*
+ * Find the stats table of the extension; the caller must be connected to
+ * SPI.  *nspname is set to the name of its schema.
+ *
+ * Returns InvalidOid if the installed version of the extension has none.
+ */
+static Oid
+get_stats_table(char **nspname)
+{
+	Oid			nspid;
+	bool		isnull;
+	int			ret;
+
+	ret = SPI_execute("SELECT extnamespace FROM pg_catalog.pg_extension "
+					  "WHERE extname = 'odbc_fdw'", true, 1);
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "SPI_execute failed: %s", SPI_result_code_string(ret));
+	if (SPI_processed == 0)
+		return InvalidOid;
+
+	nspid = DatumGetObjectId(SPI_getbinval(SPI_tuptable->vals[0],
+										   SPI_tuptable->tupdesc, 1,
+										   &isnull));
+	*nspname = get_namespace_name(nspid);
+
+	return get_relname_relid(ODBC_STATS_TABLE, nspid);
+}
+
+/*
+ * odbc_get_cached_stats
+ *		Look up the cached row count and average row width of a foreign
+ *		table.
+ *
+ * *stale is set if the count is older than ttl seconds; a ttl of 0 never
+ * makes it stale.  Returns false if the table has no cached count.
+ */
+bool
+odbc_get_cached_stats(Oid relid, int ttl, double *rows, int32 *width,
+					  bool *stale)
+{
+	StatsCacheEntry *entry;
+	bool		found;
+
+	if (StatsCacheHash == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(StatsCacheEntry);
+		StatsCacheHash = hash_create("odbc_fdw stats cache", 64, &ctl,
+									 HASH_ELEM | HASH_BLOBS);
+		CacheRegisterRelcacheCallback(stats_inval_callback, (Datum) 0);
+	}
+
+	entry = (StatsCacheEntry *) hash_search(StatsCacheHash, &relid,
+											HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		double		cached_rows = 0;
+		int32		cached_width = 0;
+		TimestampTz refreshed_at = 0;
+
+		if (SPI_connect() != SPI_OK_CONNECT)
+			elog(ERROR, "SPI_connect failed");
+
+		found = lookup_stats(relid, &StatsTableOid, &cached_rows,
+							 &cached_width, &refreshed_at);
+
+		SPI_finish();
+
+		entry = (StatsCacheEntry *) hash_search(StatsCacheHash, &relid,
+												HASH_ENTER, NULL);
+		entry->found = found;
+		entry->rows = cached_rows;
+		entry->width = cached_width;
+		entry->refreshed_at = refreshed_at;
+	}
+
+	if (!entry->found)
+		return false;
+
+	*rows = entry->rows;
+	*width = entry->width;
+	*stale = (ttl > 0 &&
+			  TimestampDifferenceExceeds(entry->refreshed_at,
+										 GetCurrentTimestamp(),
+										 ttl * 1000));
+
+	return true;
+}
+
+/*
+ * Relcache invalidation callback of the stats cache
+ *
+ * While the stats table doesn't exist, any change could be its creation,
+ * so the whole cache goes.
+ */
+static void
+stats_inval_callback(Datum arg, Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	StatsCacheEntry *entry;
+
+	if (OidIsValid(relid) && OidIsValid(StatsTableOid) &&
+		relid != StatsTableOid)
+	{
+		(void) hash_search(StatsCacheHash, &relid, HASH_REMOVE, NULL);
+		return;
+	}
+
+	hash_seq_init(&status, StatsCacheHash);
+	while ((entry = (StatsCacheEntry *) hash_seq_search(&status)) != NULL)
+		(void) hash_search(StatsCacheHash, &entry->relid, HASH_REMOVE, NULL);
+	StatsTableOid = InvalidOid;
+}
+
+/*
+ * Read the row of a table from the stats table, for callers connected to
+ * SPI.  *statsid is set to the OID of the stats table, or InvalidOid if
+ * there is none.
+ */
+static bool
+lookup_stats(Oid relid, Oid *statsid, double *rows, int32 *width,
+			 TimestampTz *refreshed_at)
+{
+	StringInfoData sql;
+	char	   *nspname;
+	Oid			argtypes[1] = {OIDOID};
+	Datum		values[1];
+	HeapTuple	tuple;
+	TupleDesc	tupdesc;
+	bool		isnull;
+	int			ret;
+
+	*statsid = get_stats_table(&nspname);
+	if (!OidIsValid(*statsid))
+		return false;
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql,
+					 "SELECT row_count, avg_width, refreshed_at FROM %s.%s "
+					 "WHERE ftrelid = $1",
+					 quote_identifier(nspname),
+					 quote_identifier(ODBC_STATS_TABLE));
+	values[0] = ObjectIdGetDatum(relid);
+
+	ret = SPI_execute_with_args(sql.data, 1, argtypes, values, NULL, true, 1);
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "SPI_execute_with_args failed: %s",
+			 SPI_result_code_string(ret));
+	if (SPI_processed == 0)
+		return false;
+
+	tuple = SPI_tuptable->vals[0];
+	tupdesc = SPI_tuptable->tupdesc;
+	*rows = DatumGetFloat8(SPI_getbinval(tuple, tupdesc, 1, &isnull));
+	*width = DatumGetInt32(SPI_getbinval(tuple, tupdesc, 2, &isnull));
+	*refreshed_at = DatumGetTimestampTz(SPI_getbinval(tuple, tupdesc, 3,
+													  &isnull));
+
+	return true;
+}
+
+/*
+ * Count the rows of a foreign table on the remote server, and store the
+ * count in the stats table.  Returns the count.
+ */
+static double
+refresh_stats(Oid relid)
+{
+	Relation	rel;
+	double		rows;
+	int32		width;
+
+	rel = heap_open(relid, AccessShareLock);
+
+	if (rel->rd_rel->relkind != RELKIND_FOREIGN_TABLE)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not a foreign table",
+						RelationGetRelationName(rel))));
+
+	rows = odbc_remote_row_count(rel);
+	if (rows < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_FDW_ERROR),
+				 errmsg("could not count the rows of foreign table \"%s\"",
+						RelationGetRelationName(rel))));
+
+	/* Estimated from the column types, or from ANALYZE if it has been run */
+	width = get_relation_data_width(relid, NULL);
+
+	heap_close(rel, AccessShareLock);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+	store_stats(relid, rows, width);
+	SPI_finish();
+
+	return rows;
+}
+
+/*
+ * Insert or update the cached count of a foreign table.
+ *
+ * Everybody may read the stats table, but only its owner may write it;
+ * the row is written on the owner's behalf, as whoever counted the rows of
+ * the table is entitled to record the count.  With the owner's rights, the
+ * statement must not resolve any name through the caller's search_path,
+ * so everything in it is qualified and search_path is pinned around it.
+ */
+static void
+store_stats(Oid relid, double rows, int32 width)
+{
+	StringInfoData sql;
+	char	   *nspname;
+	Oid			statsid;
+	Oid			owner;
+	Oid			save_userid;
+	int			save_sec_context;
+	HeapTuple	tuple;
+	Oid			argtypes[3] = {OIDOID, FLOAT8OID, INT4OID};
+	Datum		values[3];
+	int			nestlevel;
+	int			ret;
+
+	statsid = get_stats_table(&nspname);
+	if (!OidIsValid(statsid))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_TABLE),
+				 errmsg("table \"%s\" of extension \"odbc_fdw\" does not exist",
+						ODBC_STATS_TABLE),
+				 errhint("Update the extension with ALTER EXTENSION odbc_fdw UPDATE.")));
+
+	tuple = SearchSysCache1(RELOID, ObjectIdGetDatum(statsid));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for relation %u", statsid);
+	owner = ((Form_pg_class) GETSTRUCT(tuple))->relowner;
+	ReleaseSysCache(tuple);
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql,
+					 "INSERT INTO %s.%s (ftrelid, row_count, avg_width, refreshed_at) "
+					 "VALUES ($1, $2, $3, pg_catalog.now()) "
+					 "ON CONFLICT (ftrelid) DO UPDATE SET "
+					 "row_count = EXCLUDED.row_count, "
+					 "avg_width = EXCLUDED.avg_width, "
+					 "refreshed_at = EXCLUDED.refreshed_at",
+					 quote_identifier(nspname),
+					 quote_identifier(ODBC_STATS_TABLE));
+	values[0] = ObjectIdGetDatum(relid);
+	values[1] = Float8GetDatum(rows);
+	values[2] = Int32GetDatum(width);
+
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(owner,
+						   save_sec_context | SECURITY_LOCAL_USERID_CHANGE |
+						   SECURITY_RESTRICTED_OPERATION);
+	nestlevel = NewGUCNestLevel();
+	(void) set_config_option("search_path", "pg_catalog, pg_temp",
+							 PGC_USERSET, PGC_S_SESSION,
+							 GUC_ACTION_SAVE, true, 0, false);
+
+	ret = SPI_execute_with_args(sql.data, 3, argtypes, values, NULL, false, 0);
+	if (ret != SPI_OK_INSERT)
+		elog(ERROR, "SPI_execute_with_args failed: %s",
+			 SPI_result_code_string(ret));
+
+	AtEOXact_GUC(true, nestlevel);
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	/* Have every backend read the new count, once this commits */
+	CacheInvalidateRelcacheByRelid(relid);
+}
+
+/*
+ * odbc_fdw_refresh_stats
+ *		Count the rows of a foreign table now, and cache the count for the
+ *		planner.  Returns the count.
+ */
+Datum
+odbc_fdw_refresh_stats(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+
+	/* Counting may be expensive; as with ANALYZE, only the owner may */
+	if (!pg_class_ownercheck(relid, GetUserId()))
+		aclcheck_error(ACLCHECK_NOT_OWNER, ACL_KIND_CLASS,
+					   get_rel_name(relid));
+
+	PG_RETURN_INT64((int64) refresh_stats(relid));
+}
+
+/*
+ * odbc_request_stats_refresh
+ *		Have a background worker refresh the cached count of a foreign
+ *		table, whose stats_ttl is ttl seconds.
+ *
+ * Nothing is started if this backend started a worker for the table less
+ * than ttl seconds ago, or if a refresh of the table is running anywhere.
+ * Failing to start one only means the old count is used a while longer.
+ */
+void
+odbc_request_stats_refresh(Oid relid, int ttl)
+{
+	BackgroundWorker worker;
+	BackgroundWorkerHandle *handle;
+	OdbcStatsWorkerArgs args;
+	StatsLaunchEntry *entry;
+	LOCKTAG		tag;
+	TimestampTz now = GetCurrentTimestamp();
+	bool		found;
+
+	/* The count could not be stored anyway */
+	if (RecoveryInProgress())
+		return;
+
+	if (StatsLaunchHash == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(StatsLaunchEntry);
+		StatsLaunchHash = hash_create("odbc_fdw stats refreshes", 64, &ctl,
+									  HASH_ELEM | HASH_BLOBS);
+	}
+
+	entry = (StatsLaunchEntry *) hash_search(StatsLaunchHash, &relid,
+											 HASH_ENTER, &found);
+	if (found &&
+		!TimestampDifferenceExceeds(entry->launched, now, ttl * 1000))
+		return;
+	entry->launched = now;
+
+	/* Is another backend's worker refreshing the table? */
+	SET_LOCKTAG_STATS_REFRESH(tag, relid);
+	if (LockAcquire(&tag, ExclusiveLock, false, true) == LOCKACQUIRE_NOT_AVAIL)
+		return;
+	LockRelease(&tag, ExclusiveLock, false);
+
+	MemSet(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS |
+		BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "odbc_fdw");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "odbc_fdw_stats_worker");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "odbc_fdw stats refresh for %u",
+			 relid);
+	worker.bgw_main_arg = ObjectIdGetDatum(relid);
+	worker.bgw_notify_pid = 0;
+
+	args.dbid = MyDatabaseId;
+	args.userid = GetUserId();
+	args.ttl = ttl;
+	memcpy(worker.bgw_extra, &args, sizeof(args));
+
+	if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+		elog(DEBUG1, "could not start odbc_fdw stats refresh for %u", relid);
+}
+
+/*
+ * odbc_fdw_stats_worker
+ *		Main function of a background worker refreshing the cached count of
+ *		the foreign table whose OID is main_arg.
+ */
+void
+odbc_fdw_stats_worker(Datum main_arg)
+{
+	Oid			relid = DatumGetObjectId(main_arg);
+	OdbcStatsWorkerArgs args;
+	LOCKTAG		tag;
+	Oid			statsid;
+	double		rows;
+	int32		width;
+	TimestampTz refreshed_at;
+
+	memcpy(&args, MyBgworkerEntry->bgw_extra, sizeof(args));
+
+	BackgroundWorkerUnblockSignals();
+	BackgroundWorkerInitializeConnectionByOid(args.dbid, args.userid);
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+
+	/*
+	 * Leave the table to the refresh that holds its lock.  The lock is
+	 * taken before the snapshot, so that a refresh that was committed
+	 * meanwhile is seen below.
+	 */
+	SET_LOCKTAG_STATS_REFRESH(tag, relid);
+	if (LockAcquire(&tag, ExclusiveLock, false, true) == LOCKACQUIRE_NOT_AVAIL)
+	{
+		CommitTransactionCommand();
+		proc_exit(0);
+	}
+
+	PushActiveSnapshot(GetTransactionSnapshot());
+	pgstat_report_activity(STATE_RUNNING, "odbc_fdw stats refresh");
+
+	/*
+	 * The table may have been dropped since, or refreshed by another worker
+	 * started for it.
+	 */
+	if (SearchSysCacheExists1(RELOID, ObjectIdGetDatum(relid)))
+	{
+		bool		found;
+
+		if (SPI_connect() != SPI_OK_CONNECT)
+			elog(ERROR, "SPI_connect failed");
+		found = lookup_stats(relid, &statsid, &rows, &width, &refreshed_at);
+		SPI_finish();
+
+		if (!found || (args.ttl > 0 &&
+					   TimestampDifferenceExceeds(refreshed_at,
+												  GetCurrentTimestamp(),
+												  args.ttl * 1000)))
+			(void) refresh_stats(relid);
+	}
+
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+	pgstat_report_activity(STATE_IDLE, NULL);
+
+	proc_exit(0);
+}
@@ -193,6 +193,10 @@ ALTER USER MAPPING FOR public SERVER testserver1
 ALTER FOREIGN TABLE ft1 OPTIONS (schema 'S 1', table 'T 1');
 ALTER FOREIGN TABLE ft2 OPTIONS (schema 'S 1', table 'T 1');
 \det+
+-- fetch_size and batch_size take positive integers only
+ALTER FOREIGN TABLE ft1 OPTIONS (ADD fetch_size '0');  -- ERROR
+ALTER FOREIGN TABLE ft1 OPTIONS (ADD fetch_size '100abc');  -- ERROR
+ALTER FOREIGN TABLE ft1 OPTIONS (ADD batch_size '-1');  -- ERROR
 
 -- Test that alteration of server options causes reconnection
 -- Remote's errors might be non-English, so hide them to ensure stable results
@@ -313,6 +317,15 @@ EXPLAIN (VERBOSE, COSTS OFF)
 -- have use_remote_estimate set.
 ANALYZE ft4;
 ANALYZE ft5;
+-- ANALYZE stores the statistics it gathers
+SELECT relname, reltuples FROM pg_class WHERE relname IN ('ft4', 'ft5') ORDER BY relname;
+SELECT tablename, attname FROM pg_stats WHERE tablename IN ('ft4', 'ft5') ORDER BY tablename, attname;
+-- analyze_sampling: rows fetched and sampled locally, or an invalid value
+ALTER FOREIGN TABLE ft5 OPTIONS (ADD analyze_sampling 'off');
+ANALYZE ft5;
+SELECT reltuples FROM pg_class WHERE relname = 'ft5';
+ALTER FOREIGN TABLE ft5 OPTIONS (SET analyze_sampling 'bogus');  -- ERROR
+ALTER FOREIGN TABLE ft5 OPTIONS (DROP analyze_sampling);
 
 -- join two tables
 EXPLAIN (VERBOSE, COSTS OFF)
@@ -441,6 +454,21 @@ SELECT t1c1, avg(t1c1 + t2c1) FROM (SELECT t1.c1, t2.c1 FROM ft1 t1 JOIN ft2 t2
 EXPLAIN (VERBOSE, COSTS OFF)
 SELECT t1.c1 FROM "S 1"."T 1" t1, LATERAL (SELECT DISTINCT t2.c1, t3.c1 FROM ft1 t2, ft2 t3 WHERE t2.c1 = t3.c1 AND t2.c2 = t1.c2) q ORDER BY t1.c1 OFFSET 10 LIMIT 10;
 SELECT t1.c1 FROM "S 1"."T 1" t1, LATERAL (SELECT DISTINCT t2.c1, t3.c1 FROM ft1 t2, ft2 t3 WHERE t2.c1 = t3.c1 AND t2.c2 = t1.c2) q ORDER BY t1.c1 OFFSET 10 LIMIT 10;
+-- initPlan output used as a remote parameter
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT t1.c1, t1.c3 FROM ft1 t1 WHERE t1.c3 = (SELECT c3 FROM "S 1"."T 1" WHERE c1 = 7);
+SELECT t1.c1, t1.c3 FROM ft1 t1 WHERE t1.c3 = (SELECT c3 FROM "S 1"."T 1" WHERE c1 = 7);
+-- nestloop parameter, re-sent on every rescan
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT t1.c1, q.c3 FROM "S 1"."T 1" t1, LATERAL (SELECT t2.c3 FROM ft2 t2 WHERE t2.c3 = t1.c3 OFFSET 0) q WHERE t1.c1 < 4 ORDER BY t1.c1;
+SELECT t1.c1, q.c3 FROM "S 1"."T 1" t1, LATERAL (SELECT t2.c3 FROM ft2 t2 WHERE t2.c3 = t1.c3 OFFSET 0) q WHERE t1.c1 < 4 ORDER BY t1.c1;
+-- join key marked indexed, looked up remotely for each outer row
+ALTER FOREIGN TABLE ft2 ALTER COLUMN c1 OPTIONS (ADD indexed 'true');
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT t1.c1, t2.c3 FROM "S 1"."T 1" t1 JOIN ft2 t2 ON (t2.c1 = t1.c1) WHERE t1.c1 < 4 ORDER BY t1.c1;
+SELECT t1.c1, t2.c3 FROM "S 1"."T 1" t1 JOIN ft2 t2 ON (t2.c1 = t1.c1) WHERE t1.c1 < 4 ORDER BY t1.c1;
+ALTER FOREIGN TABLE ft2 ALTER COLUMN c1 OPTIONS (SET indexed 'maybe');  -- ERROR
+ALTER FOREIGN TABLE ft2 ALTER COLUMN c1 OPTIONS (DROP indexed);
 
 -- non-Var items in targetlist of the nullable rel of a join preventing
 -- push-down in some cases